@@ -1,9 +1,68 @@
 #pragma once
 
 #include "DXRay/Common.h"
+#include "DXRay/Defragmentation.h"
 
 namespace DXR
 {
+    /// @brief How an acceleration structure is built.
+    enum class BuildMode
+    {
+        /// @brief A full build from scratch.
+        Build,
+        /// @brief A refit of the previous build, only possible with
+        /// D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE.
+        Update
+    };
+
+    /// @brief Decides whether an updatable acceleration structure is refit or rebuilt. Refitting is much cheaper than
+    /// building, but the trace performance degrades with every refit as the geometry moves away from the pose it was
+    /// built with, so a full build is forced after a number of refits or when the geometry deformed too much.
+    struct RefitPolicy
+    {
+    public: // Methods
+        /// @brief Decide how the next build should be done and advance the state.
+        /// @param deformation A caller defined measure of how much the geometry changed since the last full build,
+        /// e.g. the largest vertex displacement. Compared against MaxDeformation.
+        /// @return The mode to build with.
+        BuildMode Next(float deformation = 0.0f)
+        {
+            if (!mHasBeenBuilt || mRefitsSinceBuild >= MaxRefits || deformation > MaxDeformation)
+            {
+                mHasBeenBuilt = true;
+                mRefitsSinceBuild = 0;
+                return BuildMode::Build;
+            }
+
+            mRefitsSinceBuild++;
+            return BuildMode::Update;
+        }
+
+        /// @brief Force the next build to be a full build, e.g. when the topology has changed.
+        void Reset()
+        {
+            mHasBeenBuilt = false;
+            mRefitsSinceBuild = 0;
+        }
+
+        /// @brief Get the number of refits since the last full build.
+        UINT32 GetRefitsSinceBuild() const { return mRefitsSinceBuild; }
+
+    public: // Members
+        /// @brief The maximum number of refits in a row before a full build is forced.
+        UINT32 MaxRefits = 16;
+
+        /// @brief The deformation above which a full build is forced.
+        float MaxDeformation = FLT_MAX;
+
+    private: // Members
+        /// @brief Whether there is a previous build that can be refit.
+        bool mHasBeenBuilt = false;
+
+        /// @brief The number of refits since the last full build.
+        UINT32 mRefitsSinceBuild = 0;
+    };
+
     /// @brief A description of an acceleration structure. Top or bottom.
     struct AccelerationStructureDesc
     {
@@ -17,6 +76,16 @@ namespace DXR
         /// @brief Get the size of the scratch buffer needed to build the acceleration structure.
         UINT64 GetScratchBufferSize() const { return PrebuildInfo.ScratchDataSizeInBytes; }
 
+        /// @brief Get the size of the scratch buffer needed to update the acceleration structure. A scratch buffer of
+        /// GetScratchBufferSize() is always large enough for an update too.
+        UINT64 GetUpdateScratchBufferSize() const { return PrebuildInfo.UpdateScratchDataSizeInBytes; }
+
+        /// @brief Check if the acceleration structure can be updated instead of rebuilt.
+        bool AllowsUpdate() const
+        {
+            return (Flags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE) != 0;
+        }
+
         /// @brief Get the type of the acceleration structure.
         /// @return The type of the acceleration structure that will be built.
         D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE GetType() const { return BuildDesc.Inputs.Type; }
@@ -30,6 +99,36 @@ namespace DXR
         /// @brief Check if the acceleration structure has been allocated.
         bool HasBeenAllocated() const { return BuildDesc.DestAccelerationStructureData != 0; }
 
+        /// @brief Get the GPU virtual address of the acceleration structure.
+        D3D12_GPU_VIRTUAL_ADDRESS GetAddress() const { return BuildDesc.DestAccelerationStructureData; }
+
+        /// @brief Point the description at the copy of the acceleration structure, after it was moved, so later
+        /// builds and refits write there instead of to the freed original. Call it with
+        /// AccelStructRelocation::Destination after AccelStructArena::Defragment(...), or with
+        /// CompactionResult::NewAddress and CompactedSize after compaction.
+        /// @param address The new address.
+        /// @param size The size of the memory at the new address. A compacted acceleration structure is smaller than
+        /// ResultDataMaxSizeInBytes, so it can only be refit, not rebuilt.
+        void Relocate(D3D12_GPU_VIRTUAL_ADDRESS address, UINT64 size)
+        {
+            BuildDesc.DestAccelerationStructureData = address;
+            DestSize = size;
+        }
+
+        /// @brief Point the description at the copy of the acceleration structure if it was moved, see
+        /// Relocate(...). Moves of AccelStructArena::Defragment(...) keep at least the size.
+        /// @param remap The new addresses by the old ones, e.g. AccelStructDefragmentation::Remap.
+        /// @return True if the acceleration structure was moved.
+        bool Relocate(const AccelStructRemap& remap)
+        {
+            auto moved = remap.find(BuildDesc.DestAccelerationStructureData);
+            if (moved == remap.end())
+                return false;
+
+            BuildDesc.DestAccelerationStructureData = moved->second;
+            return true;
+        }
+
     public: // Members
         // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
         // @@@@@@@@@@@@@@@@@@ Common Acceleration Structure Info @@@@@@@@@@@@@@@@@@
@@ -41,6 +140,10 @@ namespace DXR
         D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS Flags =
             D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
 
+        /// @brief TLAS & BLAS; Decides between refitting and rebuilding in Device::UpdateAccelerationStructure(...).
+        /// Only used if Flags contains D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE.
+        RefitPolicy Policy = {};
+
         // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
         // @@@@@@@@@@@@@@@@@ Bottom Level Acceleration Structure @@@@@@@@@@@@@@@@@@
         // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
@@ -80,6 +183,9 @@ namespace DXR
         /// @brief The acceleration structure build information.
         D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC BuildDesc = {};
 
+        /// @brief The size of the memory at BuildDesc.DestAccelerationStructureData.
+        UINT64 DestSize = 0;
+
         friend class Device;
     };
 
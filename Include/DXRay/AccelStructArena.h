@@ -0,0 +1,186 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/Defragmentation.h"
+#include "DXRay/OffsetAllocator.h"
+
+#include <deque>
+#include <memory>
+
+namespace DXR
+{
+    class Device;
+
+    /// @brief An acceleration structure sub-allocated from an AccelStructArena.
+    struct AccelStructHandle
+    {
+        /// @brief Check if the handle refers to an allocation.
+        bool IsValid() const { return Allocation.IsValid(); }
+
+        /// @brief The index of the block of the arena the acceleration structure is in.
+        UINT32 Block = UINT32_MAX;
+
+        /// @brief The range of the acceleration structure in the block.
+        OffsetAllocation Allocation = {};
+
+        /// @brief The size of the range, at least the ResultDataMaxSizeInBytes of the acceleration structure.
+        UINT64 Size = 0;
+
+        /// @brief The GPU virtual address of the acceleration structure.
+        D3D12_GPU_VIRTUAL_ADDRESS Address = 0;
+
+        /// @brief The buffer the acceleration structure is in, for barriers. Owned by the arena.
+        ID3D12Resource* pResource = nullptr;
+    };
+
+    /// @brief An acceleration structure that was moved by AccelStructArena::Defragment(...).
+    struct AccelStructRelocation
+    {
+        /// @brief The handle before the move, stays allocated until the copy has finished on the GPU.
+        AccelStructHandle Source = {};
+
+        /// @brief The handle after the move, replaces the source handle.
+        AccelStructHandle Destination = {};
+    };
+
+    /// @brief The result of a defragmentation step.
+    struct AccelStructDefragmentation
+    {
+        /// @brief The acceleration structures that were moved.
+        std::vector<AccelStructRelocation> Relocations = {};
+
+        /// @brief The new addresses by the old ones, to patch instance descs with, e.g. with
+        /// InstanceManager::RemapAccelerationStructures(...).
+        AccelStructRemap Remap = {};
+
+        /// @brief The number of bytes that were copied.
+        UINT64 MovedBytes = 0;
+
+        /// @brief False if the step stopped at its budget and another step can free more memory.
+        bool IsComplete = true;
+    };
+
+    /// @brief Places many acceleration structures in a few large buffers, instead of a committed or placed resource
+    /// each. Small BLASes waste most of a 64KB resource otherwise, and fewer resources make residency and barriers
+    /// cheaper. Ranges are managed by an OffsetAllocator per buffer, so allocating and freeing are O(1).
+    /// @note Freeing a handle makes its range available right away, only free it once the GPU is done with it.
+    class AccelStructArena
+    {
+    public:
+        /// @brief Create an arena, buffers are allocated when they are needed.
+        /// @param device The device to allocate the buffers with, must outlive the arena.
+        /// @param blockSize The size of each buffer. Acceleration structures that are larger get a buffer of their
+        /// own size.
+        /// @param maxAllocationsPerBlock The maximum number of acceleration structures in a buffer.
+        AccelStructArena(Device& device, UINT64 blockSize = 64 * 1024 * 1024, UINT32 maxAllocationsPerBlock = 16384);
+
+        // Delete copy/move constructors and assignment operators
+
+        AccelStructArena(AccelStructArena const&) = delete;
+        AccelStructArena(AccelStructArena&&) = delete;
+        AccelStructArena& operator=(AccelStructArena const&) = delete;
+        AccelStructArena& operator=(AccelStructArena&&) = delete;
+
+    public: // Methods
+        /// @brief Allocate a range for an acceleration structure, in the first buffer that has room for it.
+        /// @param size The size of the acceleration structure, usually ResultDataMaxSizeInBytes or the compacted size.
+        /// @return The handle of the acceleration structure.
+        AccelStructHandle Allocate(UINT64 size);
+
+        /// @brief Free the range of an acceleration structure. The handle is reset.
+        void Free(AccelStructHandle& handle);
+
+        /// @brief Release the buffers that have no acceleration structures in them.
+        void TrimEmptyBlocks();
+
+        /// @brief Record the copies of a defragmentation step, which moves acceleration structures out of the
+        /// sparsest buffers so they can be released with TrimEmptyBlocks() once the step has retired. Acceleration
+        /// structures are moved with CLONE copies, surrounded by UAV barriers.
+        /// @param cmdList The command list to record the copies into, before the top level builds of the frame.
+        /// @param maxBytes The maximum number of bytes to copy, bounds the GPU time of the step.
+        /// @param maxMoves The maximum number of acceleration structures to move.
+        /// @return The moves. The handles and addresses of the moved acceleration structures must be replaced before
+        /// the next top level build, the old handles must not be freed. Descriptions of moved acceleration structures
+        /// that are built or refit again must be relocated, see AccelerationStructureDesc::Relocate(...).
+        AccelStructDefragmentation Defragment(ID3D12GraphicsCommandList4* cmdList, UINT64 maxBytes,
+                                              UINT32 maxMoves = UINT32_MAX);
+
+        /// @brief Tag the sources of all moves since the last call with a fence value, call after submitting the
+        /// command list of Defragment(...).
+        void Submit(UINT64 fenceValue);
+
+        /// @brief Free the sources of the moves whose fence value has completed.
+        void Retire(UINT64 completedFenceValue);
+
+        /// @brief Free the sources of the moves whose fence value has completed.
+        void Retire(ID3D12Fence* fence) { Retire(fence->GetCompletedValue()); }
+
+        /// @brief Get the number of bytes used by acceleration structures, including alignment.
+        UINT64 GetUsedSize() const { return mUsedSize; }
+
+        /// @brief Get the number of bytes of all buffers.
+        UINT64 GetReservedSize() const { return mReservedSize; }
+
+        /// @brief Get the number of buffers.
+        UINT32 GetBlockCount() const { return mBlockCount; }
+
+        /// @brief Get the number of acceleration structures.
+        UINT32 GetAllocationCount() const { return mAllocationCount; }
+
+        /// @brief Get the buffer of a block, null if the block was trimmed.
+        ComPtr<DMA::Allocation> GetBlockAllocation(UINT32 block) const { return mBlocks[block].Buffer; }
+
+    private: // Private Structs
+        struct Block
+        {
+            /// @brief The buffer, null if the block was trimmed and its index can be reused.
+            ComPtr<DMA::Allocation> Buffer = nullptr;
+
+            /// @brief The ranges of the buffer.
+            std::unique_ptr<OffsetAllocator> Allocator = nullptr;
+
+            /// @brief The GPU virtual address of the buffer.
+            D3D12_GPU_VIRTUAL_ADDRESS Address = 0;
+        };
+
+        struct PendingFree
+        {
+            /// @brief The fence value that frees the range.
+            UINT64 FenceValue = 0;
+
+            /// @brief The range that was moved away from.
+            AccelStructHandle Handle = {};
+        };
+
+    private: // Internal methods
+        /// @brief Allocate a buffer and return its index.
+        UINT32 InternalCreateBlock(UINT64 size);
+
+        /// @brief Free the range of a handle in its block, for freed acceleration structures and the sources of moves.
+        /// Doesn't change the number of acceleration structures, a moved one is still alive at its destination.
+        void InternalFreeRange(const AccelStructHandle& handle);
+
+    private: // Members
+        Device& mDevice;
+
+        UINT64 mBlockSize = 0;
+        UINT32 mMaxAllocationsPerBlock = 0;
+
+        std::vector<Block> mBlocks = {};
+
+        /// @brief The live acceleration structures by address, the ones that can be moved.
+        std::unordered_map<D3D12_GPU_VIRTUAL_ADDRESS, AccelStructHandle> mLive = {};
+
+        /// @brief The sources of moves that have not been submitted yet.
+        std::vector<AccelStructHandle> mUnsubmittedFrees = {};
+
+        /// @brief The sources of moves that are in flight, oldest first.
+        std::deque<PendingFree> mPendingFrees = {};
+
+        UINT64 mUsedSize = 0;
+        UINT64 mReservedSize = 0;
+        UINT32 mBlockCount = 0;
+        UINT32 mAllocationCount = 0;
+    };
+
+} // namespace DXR
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/MeshPreprocessing.h"
+#include "DXRay/TaskPool.h"
+
+namespace DXR
+{
+    /// @brief How AnalyzeGeometries(...) builds its BVHs and weighs their costs. The costs are relative, only their
+    /// ratios matter, calibrate them against GPU timings of the target hardware if the defaults don't fit.
+    struct BVHAnalysisOptions
+    {
+        /// @brief The number of bins per axis of the binned SAH builder, at most 64.
+        UINT32 BinCount = 16;
+
+        /// @brief The largest number of primitives in a leaf.
+        UINT32 MaxLeafSize = 4;
+
+        /// @brief The cost of visiting a node and of intersecting a triangle, in the SAH.
+        float TraversalCost = 1.0f;
+        float IntersectionCost = 1.0f;
+
+        /// @brief The cost of moving from the TLAS into a BLAS, when the geometries are kept as separate instances.
+        float InstanceCost = 2.0f;
+
+        /// @brief Nodes with at least this many primitives build their children on separate tasks.
+        UINT32 ParallelThreshold = 4096;
+
+        /// @brief Whether the acceleration structure is rebuilt regularly, like a skinned or procedural mesh. Static
+        /// acceleration structures are built once and always prefer fast trace.
+        bool Rebuilt = false;
+
+        /// @brief The number of rays traced against the acceleration structure between two rebuilds, if Rebuilt.
+        float RaysPerBuild = 1e6f;
+
+        /// @brief The cost of building a triangle, relative to the SAH cost of one ray, with PREFER_FAST_BUILD.
+        float BuildCostPerTriangle = 4.0f;
+
+        /// @brief How much slower PREFER_FAST_TRACE builds are than PREFER_FAST_BUILD builds.
+        float FastTraceBuildFactor = 2.5f;
+
+        /// @brief How much slower PREFER_FAST_BUILD acceleration structures trace than PREFER_FAST_TRACE ones.
+        float FastBuildTraceFactor = 1.3f;
+    };
+
+    /// @brief The quality of a BVH built by the analyzer.
+    struct BVHMetrics
+    {
+    public: // Methods
+        /// @brief Get the throughput of the CPU builder.
+        double GetTrianglesPerSecond() const { return BuildSeconds > 0.0 ? PrimitiveCount / BuildSeconds : 0.0; }
+
+    public: // Members
+        /// @brief The number of primitives, triangles or instances.
+        UINT64 PrimitiveCount = 0;
+
+        /// @brief The number of nodes, interior and leaves, and of leaves.
+        UINT64 NodeCount = 0;
+        UINT64 LeafCount = 0;
+
+        /// @brief The length of the longest path from the root to a leaf.
+        UINT32 MaxDepth = 0;
+
+        /// @brief The expected cost of tracing a ray that hits the root bounds, by the surface area heuristic.
+        float SAHCost = 0.0f;
+
+        /// @brief The surface area of the overlap of sibling nodes, relative to the surface area of their parents.
+        /// Rays in overlapping regions have to visit both siblings, 0 is no overlap.
+        float OverlapRatio = 0.0f;
+
+        /// @brief The surface area of the root bounds.
+        float RootArea = 0.0f;
+
+        /// @brief The time the CPU builder took, the proxy for the build time on the GPU.
+        double BuildSeconds = 0.0;
+    };
+
+    /// @brief The analysis of a set of geometries, and what to build them with.
+    struct BVHAnalysis
+    {
+    public: // Members
+        /// @brief The BVH of each geometry on its own.
+        std::vector<BVHMetrics> Geometries = {};
+
+        /// @brief The BVH of all geometries merged into one BLAS.
+        BVHMetrics Merged = {};
+
+        /// @brief The BVH over the bounds of the geometries, as a TLAS would build it if they were separate instances.
+        BVHMetrics Instances = {};
+
+        /// @brief The expected cost of a ray hitting the root bounds, with one merged BLAS and with one BLAS per
+        /// geometry under a TLAS.
+        float MergedCost = 0.0f;
+        float SeparateCost = 0.0f;
+
+        /// @brief Whether the geometries should be merged into one BLAS rather than kept as separate instances.
+        bool RecommendMerge = false;
+
+        /// @brief The recommended build flags for the BLAS or BLASes.
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS RecommendedFlags =
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
+
+        /// @brief The number of triangles built per second, the triangles of all builds of the analysis over its wall
+        /// clock time. The per-geometry builds run at the same time, so their BuildSeconds overlap and don't add up.
+        double TrianglesPerSecond = 0.0;
+    };
+
+    /// @brief Build a binned SAH BVH over a mesh on the CPU and measure it. The BVH is only measured, not kept.
+    /// @param pool The pool to build on.
+    /// @param mesh The mesh.
+    /// @param options How to build.
+    /// @return The metrics of the BVH.
+    BVHMetrics AnalyzeMesh(TaskPool& pool, const MeshInput& mesh, const BVHAnalysisOptions& options = {});
+
+    /// @brief Analyze a set of geometries to choose between PREFER_FAST_TRACE and PREFER_FAST_BUILD, and between
+    /// merging them into one BLAS and keeping them as separate instances. Builds a BVH per geometry, one over all of
+    /// them, and one over their bounds, in parallel.
+    /// @param pool The pool to build on.
+    /// @param geometries The geometries, in the same space.
+    /// @param options How to build and weigh the costs.
+    /// @return The analysis.
+    BVHAnalysis AnalyzeGeometries(TaskPool& pool, std::span<const MeshInput> geometries,
+                                  const BVHAnalysisOptions& options = {});
+
+} // namespace DXR
@@ -18,6 +18,9 @@
 using namespace DirectX;
 
 // STL Headers
+#include <algorithm>
+#include <cfloat>
+#include <span>
 #include <unordered_map>
 #include <vector>
 #include <stdexcept>
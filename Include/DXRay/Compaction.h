@@ -0,0 +1,104 @@
+#pragma once
+
+#include "DXRay/Common.h"
+
+namespace DXR
+{
+    /// @brief The outcome of compacting a single bottom level acceleration structure.
+    struct CompactionResult
+    {
+    public: // Methods
+        /// @brief Get the number of bytes freed by the compaction, once the original allocation is released.
+        UINT64 GetReclaimedSize() const { return OriginalSize - CompactedSize; }
+
+    public: // Members
+        /// @brief The compacted acceleration structure. Replace the original allocation with this one. It is the
+        /// original if the acceleration structure was not built with
+        /// D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION, then NewAddress equals OldAddress.
+        ComPtr<DMA::Allocation> Allocation = nullptr;
+
+        /// @brief The GPU virtual address of the original acceleration structure.
+        D3D12_GPU_VIRTUAL_ADDRESS OldAddress = 0;
+
+        /// @brief The GPU virtual address of the compacted acceleration structure, which should be written to
+        /// D3D12_RAYTRACING_INSTANCE_DESC::AccelerationStructure of all instances that used the old address. Pass it to
+        /// AccelerationStructureDesc::Relocate(...) if the acceleration structure is refit later.
+        D3D12_GPU_VIRTUAL_ADDRESS NewAddress = 0;
+
+        /// @brief The size of the original allocation, usually ResultDataMaxSizeInBytes.
+        UINT64 OriginalSize = 0;
+
+        /// @brief The size of the compacted allocation.
+        UINT64 CompactedSize = 0;
+    };
+
+    /// @brief A group of bottom level acceleration structures that are compacted together. Compaction takes two steps
+    /// that should be at least a frame apart, so the CPU doesn't wait on the GPU:
+    /// 1. Device::EmitCompactionQueries(...) after the builds, which queries the compacted sizes.
+    /// 2. Device::CompactAccelerationStructures(...) once the command list of step 1 has finished executing, which
+    /// allocates the compacted acceleration structures and records the copies.
+    /// The original allocations are kept alive by the batch until ReleaseRetired() is called, which should happen once
+    /// the command list of step 2 has finished executing.
+    struct CompactionBatch
+    {
+    public: // Methods
+        /// @brief Check if the compacted sizes have been queried, and the batch can be compacted.
+        bool IsQueried() const { return mPostbuildBuffer != nullptr && mResults.empty(); }
+
+        /// @brief Check if the batch has been compacted.
+        bool IsCompacted() const { return !mResults.empty(); }
+
+        /// @brief Get the results of the compaction, in the same order as the acceleration structures passed to
+        /// Device::EmitCompactionQueries(...). Empty until the batch has been compacted.
+        const std::vector<CompactionResult>& GetResults() const { return mResults; }
+
+        /// @brief Get the address of an acceleration structure after compaction.
+        /// @param oldAddress The address of the acceleration structure before compaction.
+        /// @return The address after compaction, or oldAddress if it isn't part of the batch.
+        D3D12_GPU_VIRTUAL_ADDRESS GetRemappedAddress(D3D12_GPU_VIRTUAL_ADDRESS oldAddress) const
+        {
+            for (auto& result : mResults)
+            {
+                if (result.OldAddress == oldAddress)
+                    return result.NewAddress;
+            }
+            return oldAddress;
+        }
+
+        /// @brief Get the total number of bytes freed by the compaction.
+        UINT64 GetReclaimedSize() const
+        {
+            UINT64 size = 0;
+            for (auto& result : mResults) { size += result.GetReclaimedSize(); }
+            return size;
+        }
+
+        /// @brief Release the original, uncompacted acceleration structures and the query buffers. Only call this
+        /// once the GPU has finished the compaction copies.
+        void ReleaseRetired()
+        {
+            mRetired.clear();
+            mPostbuildBuffer = nullptr;
+            mReadbackBuffer = nullptr;
+        }
+
+    private: // Members
+        /// @brief The acceleration structures that are being compacted.
+        std::vector<ComPtr<DMA::Allocation>> mSources = {};
+
+        /// @brief The original acceleration structures that have been replaced, but may still be used by the GPU.
+        std::vector<ComPtr<DMA::Allocation>> mRetired = {};
+
+        /// @brief The buffer the GPU writes the compacted sizes to.
+        ComPtr<DMA::Allocation> mPostbuildBuffer = nullptr;
+
+        /// @brief The buffer the compacted sizes are copied to, so the CPU can read them.
+        ComPtr<DMA::Allocation> mReadbackBuffer = nullptr;
+
+        /// @brief The results of the compaction.
+        std::vector<CompactionResult> mResults = {};
+
+        friend class Device;
+    };
+
+} // namespace DXR
@@ -9,7 +9,25 @@
 #include "DXRay/Common.h"
 #include "DXRay/Device.h"
 #include "DXRay/AccelStruct.h"
+#include "DXRay/AccelStructArena.h"
+#include "DXRay/OffsetAllocator.h"
 #include "DXRay/ShaderTable.h"
+#include "DXRay/HitGroupTableBuilder.h"
+#include "DXRay/ShaderIdentifierCache.h"
+#include "DXRay/StateObjectCache.h"
+#include "DXRay/PrebuildInfoCache.h"
+#include "DXRay/ResidencyManager.h"
+#include "DXRay/ScratchPlanner.h"
+#include "DXRay/Compaction.h"
+#include "DXRay/Defragmentation.h"
+#include "DXRay/InstanceManager.h"
+#include "DXRay/MeshPreprocessing.h"
+#include "DXRay/Quantization.h"
+#include "DXRay/BVHAnalyzer.h"
+#include "DXRay/StaticBatching.h"
+#include "DXRay/InstancePacking.h"
+#include "DXRay/TaskPool.h"
+#include "DXRay/UploadRing.h"
 
 // Check if want to use the Agility SDK Binary Version of D3D12
 #ifdef DXRAY_AGILITY_SDK_VERSION
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/OffsetAllocator.h"
+
+namespace DXR
+{
+    /// @brief The new address of each acceleration structure that was moved, by its old address.
+    using AccelStructRemap = std::unordered_map<D3D12_GPU_VIRTUAL_ADDRESS, D3D12_GPU_VIRTUAL_ADDRESS>;
+
+    /// @brief A live allocation that can be moved by PlanDefragmentation(...).
+    struct DefragmentationAllocation
+    {
+        /// @brief The index of the block the allocation is in.
+        UINT32 Block = 0;
+
+        /// @brief The range of the allocation in the block.
+        OffsetAllocation Allocation = {};
+
+        /// @brief The size of the range.
+        UINT64 Size = 0;
+    };
+
+    /// @brief A move of an allocation to another block.
+    struct DefragmentationMove
+    {
+        /// @brief The index of the allocation in the list that was planned.
+        UINT32 Allocation = 0;
+
+        /// @brief The block the allocation is moved to.
+        UINT32 DestBlock = 0;
+
+        /// @brief The range the allocation is moved to, already allocated in the destination block.
+        OffsetAllocation Destination = {};
+    };
+
+    /// @brief The moves of a defragmentation step.
+    struct DefragmentationPlan
+    {
+        /// @brief The moves, in the order they should be copied.
+        std::vector<DefragmentationMove> Moves = {};
+
+        /// @brief The blocks that are empty once all moves are done and their sources freed.
+        std::vector<UINT32> EvacuatedBlocks = {};
+
+        /// @brief The number of bytes that are moved.
+        UINT64 MovedBytes = 0;
+
+        /// @brief False if the step stopped at its budget and more moves are possible.
+        bool IsComplete = true;
+    };
+
+    /// @brief Plan which allocations to move so that whole blocks become empty and can be released. The sparsest
+    /// blocks are evacuated first, into the densest blocks that have room, largest allocations first. A block is
+    /// only evacuated if all of its allocations fit elsewhere, unless the budget runs out halfway, in which case the
+    /// next step continues with it. Only works on the bookkeeping, so it can be tested without a GPU.
+    /// @param blocks The allocators of the blocks, null for blocks that don't exist. The destinations of the moves are
+    /// allocated from them, the sources are left for the caller to free once they have been copied.
+    /// @param allocations The live allocations.
+    /// @param maxBytes The maximum number of bytes to move, at least one allocation is moved if any can be.
+    /// @param maxMoves The maximum number of moves.
+    /// @return The plan.
+    DefragmentationPlan PlanDefragmentation(std::span<OffsetAllocator* const> blocks,
+                                            std::span<const DefragmentationAllocation> allocations, UINT64 maxBytes,
+                                            UINT32 maxMoves = UINT32_MAX);
+
+} // namespace DXR
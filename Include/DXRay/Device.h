@@ -2,10 +2,23 @@
 
 #include "DXRay/Common.h"
 #include "DXRay/AccelStruct.h"
+#include "DXRay/AccelStructArena.h"
+#include "DXRay/Compaction.h"
+#include "DXRay/InstancePacking.h"
+#include "DXRay/PrebuildInfoCache.h"
+#include "DXRay/ResidencyManager.h"
+#include "DXRay/ScratchPlanner.h"
+#include "DXRay/ShaderIdentifierCache.h"
 #include "DXRay/ShaderTable.h"
+#include "DXRay/StateObjectCache.h"
 
 namespace DXR
 {
+    /// @brief A function that fills the description of a state object. Used by the asynchronous pipeline functions,
+    /// where it is called on the thread that compiles the state object, so everything it references has to outlive
+    /// the compilation.
+    using StateObjectBuilder = std::function<void(CD3DX12_STATE_OBJECT_DESC&)>;
+
     /// @brief A wrapper around the D3D12 to use DXR.
     class Device
     {
@@ -52,6 +65,19 @@ namespace DXR
         /// @param desc The description of the acceleration structure which will be assigned a region of the scratch.
         UINT64 GetRequiredScratchBufferSize(AccelerationStructureDesc& descs);
 
+        /// @brief Get the aligned size of a scratch buffer that is only used to refit an acceleration structure with
+        /// UpdateAccelerationStructure(...), which is usually much smaller than the size needed for a full build.
+        /// @param desc The description of the acceleration structure, must be allocated.
+        UINT64 GetRequiredUpdateScratchBufferSize(AccelerationStructureDesc& desc);
+
+        /// @brief Plan a scratch buffer for the acceleration structures, where builds of different batches reuse the
+        /// same memory. Allocate a scratch buffer of ScratchPlan::PeakSize and assign it with
+        /// AssignScratchBuffer(descs, plan, alloc).
+        /// @param descs The descriptions of the acceleration structures, must be allocated.
+        /// @param maxBatchSize The maximum number of builds in flight between two UAV barriers. 0 means no limit.
+        /// @return The plan, see PlanScratchMemory(...).
+        ScratchPlan PlanScratchBuffer(std::vector<AccelerationStructureDesc>& descs, UINT32 maxBatchSize);
+
         /// @brief Get the pool.
         /// @return The pool, or null if no pool is set.
         ComPtr<DMA::Pool> GetPool() const { return mPool; }
@@ -61,6 +87,28 @@ namespace DXR
         /// @note This will override the existing pool if one is already set.
         void SetPool(const ComPtr<DMA::Pool>& pool) { mPool = pool; }
 
+        /// @brief Get the cache of state objects used by CreatePipeline(...) and ExpandPipeline(...). It is disabled
+        /// until it is given a capacity.
+        StateObjectCache& GetStateObjectCache() { return mStateObjectCache; }
+
+        /// @brief Get the cache of shader identifiers used to build shader tables.
+        ShaderIdentifierCache& GetShaderIdentifierCache() { return mShaderIdentifierCache; }
+
+        /// @brief Get the cache of prebuild info used by QueryPrebuildInfo(...).
+        PrebuildInfoCache& GetPrebuildInfoCache() { return mPrebuildInfoCache; }
+
+        /// @brief Get the residency manager, which accounts all allocations of the device by category and evicts
+        /// bottom level acceleration structures that are tracked with it.
+        ResidencyManager& GetResidencyManager() { return mResidencyManager; }
+
+        /// @brief Get the task pool used for parallel CPU work. Created on first use if none was set.
+        /// @return The task pool.
+        std::shared_ptr<TaskPool> GetTaskPool();
+
+        /// @brief Set the task pool used for parallel CPU work, e.g. to share the threads of an existing pool.
+        /// @param pool The task pool to use.
+        void SetTaskPool(const std::shared_ptr<TaskPool>& pool);
+
         // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
         // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@ Utilities @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
         // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
@@ -77,6 +125,15 @@ namespace DXR
                                                  DMA::ALLOCATION_FLAGS allocFlags = DMA::ALLOCATION_FLAG_NONE,
                                                  D3D12_HEAP_FLAGS heapFlags = D3D12_HEAP_FLAG_NONE);
 
+        /// @brief Allocate a resource and account it to a category of the residency manager.
+        /// @param category What the resource is used for, see GetResidencyManager().
+        /// @return The new resource.
+        ComPtr<DMA::Allocation> AllocateResource(MemoryCategory category, const D3D12_RESOURCE_DESC& desc,
+                                                 D3D12_RESOURCE_STATES state,
+                                                 D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT,
+                                                 DMA::ALLOCATION_FLAGS allocFlags = DMA::ALLOCATION_FLAG_NONE,
+                                                 D3D12_HEAP_FLAGS heapFlags = D3D12_HEAP_FLAG_NONE);
+
         /// @brief Map a resource for only writing. It is always recommended to map persistently if the resource is
         /// located in CPU visible memory to avoid Map/Unmap overhead.
         /// @param resource The resource to map.
@@ -95,12 +152,56 @@ namespace DXR
         /// @return The new acceleration structure.
         ComPtr<DMA::Allocation> AllocateAccelerationStructure(AccelerationStructureDesc& desc);
 
+        /// @brief Allocate a new acceleration structure in a range of an arena, instead of a resource of its own.
+        /// @param desc The description of the acceleration structure. Will be modified and used when building the
+        /// acceleration structure.
+        /// @param arena The arena to allocate from.
+        /// @return The handle of the acceleration structure, free it with arena.Free(...) once the GPU is done with it.
+        AccelStructHandle AllocateAccelerationStructure(AccelerationStructureDesc& desc, AccelStructArena& arena);
+
+        /// @brief Fill the build inputs of an acceleration structure and query its prebuild info, without allocating
+        /// anything. Called by the allocate functions, useful to size an arena up front.
+        /// @param desc The description of the acceleration structure.
+        /// @return The prebuild info, also stored in desc.
+        /// @note Prebuild info is cached by the signature of the inputs, so acceleration structures with the same
+        /// counts, formats and flags need one driver call. See GetPrebuildInfoCache().
+        const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO& QueryPrebuildInfo(
+            AccelerationStructureDesc& desc);
+
         /// @brief Build an acceleration structure.
         /// @param desc The description of the acceleration structure to build.
         /// @param cmdList The command list to use for building.
         void BuildAccelerationStructure(const AccelerationStructureDesc& desc,
                                         ComPtr<ID3D12GraphicsCommandList4>& cmdList);
 
+        /// @brief Build or refit an acceleration structure that allows updates, as decided by its RefitPolicy.
+        /// A refit uses the acceleration structure as its own source and the geometry / instance addresses of the desc
+        /// at the time of recording. Use this function for every build of the acceleration structure, including the
+        /// first one, so the policy knows when there is something to refit.
+        /// @param desc The description of the acceleration structure, must be allocated with
+        /// D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE.
+        /// @param cmdList The command list to use for building.
+        /// @param deformation How much the geometry changed since the last full build, see RefitPolicy::Next(...).
+        /// @return The mode that was recorded. A full build needs a scratch buffer of GetScratchBufferSize(), a refit
+        /// only one of GetUpdateScratchBufferSize().
+        /// @note If NumInstanceDescs of a top level acceleration structure changed, it is rebuilt in its existing
+        /// allocation with its existing scratch buffer. When more instances don't fit them, reallocate it with
+        /// AllocateAccelerationStructure(...) and assign a new scratch buffer before calling this.
+        BuildMode UpdateAccelerationStructure(AccelerationStructureDesc& desc,
+                                              ComPtr<ID3D12GraphicsCommandList4>& cmdList, float deformation = 0.0f);
+
+        /// @brief Build many acceleration structures with a bounded amount of scratch memory. The builds are split
+        /// into batches that fit in the budget, largest first, and a single UAV barrier is recorded between batches.
+        /// @param descs The descriptions of the acceleration structures to build, must be allocated. Their scratch
+        /// buffer will be assigned by this function.
+        /// @param cmdList The command list to use for building.
+        /// @param scratchBudget The maximum amount of scratch memory used by one batch of builds.
+        /// @return The scratch buffer, which must be kept alive until the command list has finished executing.
+        /// @note No barrier is recorded after the last batch, so place a UAV barrier before using the results.
+        ComPtr<DMA::Allocation> BuildAccelerationStructures(std::span<AccelerationStructureDesc> descs,
+                                                            ComPtr<ID3D12GraphicsCommandList4>& cmdList,
+                                                            UINT64 scratchBudget);
+
         /// @brief Allocate a scratch buffer for building a bottom level acceleration structure. It will take into
         /// account the alignment requirements.
         /// @param descs The description of the acceleration structure which will be assigned a region of the scratch
@@ -118,6 +219,15 @@ namespace DXR
         /// @param offset The offset into the scratch buffer to use, will be automatically aligned.
         void AssignScratchBuffer(AccelerationStructureDesc& desc, ComPtr<DMA::Allocation>& alloc, UINT64 offset = 0);
 
+        /// @brief Assign regions of a scratch buffer to the acceleration structures as laid out by a plan.
+        /// @param descs The descriptions of the acceleration structures, the same that were used to create the plan.
+        /// @param plan The plan returned by PlanScratchBuffer(...).
+        /// @param alloc The scratch buffer to use, at least ScratchPlan::PeakSize in size.
+        /// @note Builds of different batches alias each other, so when recording the builds in ScratchPlan::Order, a
+        /// UAV barrier must be placed between every two batches.
+        void AssignScratchBuffer(std::vector<AccelerationStructureDesc>& descs, const ScratchPlan& plan,
+                                 ComPtr<DMA::Allocation>& alloc);
+
         /// @brief Allocate a big scratch buffer that will be used for all acceleration structures and assign regions
         /// to each acceleration structure. This is a convenience function that calls GetRequiredScratchBufferSize(...),
         /// AllocateScratchBuffer(...) and AssignScratchBuffer(...) in that order.
@@ -145,6 +255,37 @@ namespace DXR
         ComPtr<DMA::Allocation> AllocateInstanceBuffer(UINT64 numInstances,
                                                        D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_UPLOAD);
 
+        /// @brief Fill an instance buffer on all threads of the task pool, see PackInstanceDescsParallel(...).
+        /// @param pInstanceDescs The mapping of an instance buffer, e.g. from AllocateInstanceBuffer(...).
+        /// @param src The instance data.
+        /// @param count The number of instances to write.
+        void FillInstanceBuffer(D3D12_RAYTRACING_INSTANCE_DESC* pInstanceDescs, const InstancePackDesc& src,
+                                UINT64 count);
+
+        /// @brief Query the compacted sizes of bottom level acceleration structures, the first step of compaction.
+        /// Records a UAV barrier to wait for the builds, the postbuild info queries and a copy of the sizes into a
+        /// readback buffer owned by the batch.
+        /// @param batch An unused compaction batch, which will keep the acceleration structures alive.
+        /// @param accelStructs The acceleration structures to compact, they must have been built with
+        /// D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION in the same or an earlier command list.
+        /// @param cmdList The command list to record the queries into.
+        void EmitCompactionQueries(CompactionBatch& batch, std::vector<ComPtr<DMA::Allocation>>& accelStructs,
+                                   ComPtr<ID3D12GraphicsCommandList4>& cmdList);
+
+        /// @brief Compact the acceleration structures of a batch, the second step of compaction. Allocates tightly
+        /// sized acceleration structures and records the compacting copies. The originals are retired to the batch.
+        /// @param batch The batch that was passed to EmitCompactionQueries(...). The command list of that call must
+        /// have finished executing, so it is recommended to wait a frame or more.
+        /// @param cmdList The command list to record the copies into.
+        /// @return The results, with the new allocations and the remapped addresses for the instance descriptions.
+        /// @note The acceleration structures must have been built with
+        /// D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION. Others report no compacted size, they
+        /// are asserted on and kept as they are, their result holds the original.
+        /// @note The compacted acceleration structures can be used after a UAV barrier. Call
+        /// CompactionBatch::ReleaseRetired() once this command list has finished executing to free the memory.
+        const std::vector<CompactionResult>& CompactAccelerationStructures(CompactionBatch& batch,
+                                                                           ComPtr<ID3D12GraphicsCommandList4>& cmdList);
+
         // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
         // @@@@@@@@@@@@@@@@@@@@@@@@@ Ray Tracing Pipeline @@@@@@@@@@@@@@@@@@@@@@@@@
         // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
@@ -163,6 +304,9 @@ namespace DXR
         /// pipeline.
         /// @param desc The description of the pipeline.
         /// @return The new pipeline.
+        /// @note If the state object cache is enabled, pipelines are cached by the contents of their description, so
+        /// requesting the same pipeline twice, even from different threads at the same time, compiles it once. See
+        /// GetStateObjectCache().
         ComPtr<ID3D12StateObject> CreatePipeline(CD3DX12_STATE_OBJECT_DESC& desc);
 
         /// @brief Expand a pipeline by adding a collection type state object to it.
@@ -176,26 +320,81 @@ namespace DXR
         ComPtr<ID3D12StateObject> ExpandPipeline(CD3DX12_STATE_OBJECT_DESC& desc, ComPtr<ID3D12StateObject>& pipeline,
                                                  ComPtr<ID3D12StateObject>& collection);
 
+        /// @brief Create a ray tracing pipeline on the task pool, see GetTaskPool(). The number of pipelines that are
+        /// compiled at the same time is bounded by the number of threads of the pool.
+        /// @param builder Fills the description, which is already of type D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE.
+        /// @return A future to the new pipeline.
+        std::future<ComPtr<ID3D12StateObject>> CreatePipelineAsync(StateObjectBuilder builder);
+
+        /// @brief Create a collection on the task pool, see GetTaskPool(). Splitting a large pipeline into
+        /// collections, e.g. one per material, compiles it on all threads of the pool instead of one. Combine them
+        /// with LinkCollections(...).
+        /// @param builder Fills the description, which is already of type D3D12_STATE_OBJECT_TYPE_COLLECTION.
+        /// @return A future to the new collection.
+        std::future<ComPtr<ID3D12StateObject>> CreateCollectionAsync(StateObjectBuilder builder);
+
+        /// @brief Wait for collections to finish compiling and add all of them to a pipeline in one expansion. The
+        /// calling thread helps the task pool while it waits.
+        /// @param pipeline The pipeline to add the collections to, created with the
+        /// D3D12_STATE_OBJECT_FLAG_ALLOW_STATE_OBJECT_ADDITION flag.
+        /// @param collections The futures returned by CreateCollectionAsync(...).
+        /// @return The expanded pipeline, which allows further additions.
+        ComPtr<ID3D12StateObject> LinkCollections(ComPtr<ID3D12StateObject>& pipeline,
+                                                  std::span<std::future<ComPtr<ID3D12StateObject>>> collections);
+
         /// @brief Create a shader table
         /// @param table The shader table to create, filled with the shader names, etc.
-        /// @param heap The heap type to use for the shader table. This heap should be CPU accessible.
-        /// GPU_UPLOAD or UPLOAD are recommended, and if you really want to use DEFAULT, the table can act as a UPLOAD
-        /// buffer and copy the whole buffer via CopyBufferRegion(...) to a DEFAULT buffer.
+        /// @param heap The heap type to use for the shader table. GPU_UPLOAD or UPLOAD are written to directly. With
+        /// DEFAULT the records are written to a CPU copy and UploadShaderTable(...) copies the modified ones to video
+        /// memory, which is faster to read from during DispatchRays on discrete GPUs.
+        /// See ShaderTable::SetVersionCount(...) to modify records of a table in an UPLOAD or GPU_UPLOAD heap while the
+        /// GPU is reading it.
         /// @param pipeline The pipeline to use for the shader table.
         void CreateShaderTable(ShaderTable& table, D3D12_HEAP_TYPE heap, ComPtr<ID3D12StateObject>& pipeline);
 
-        /// @todo Add support for shader table expansion.
-        /// @todo Add support for copying shader tables to DEFAULT heap.
+        /// @brief Update a shader table after shaders were added to it, e.g. after ExpandPipeline(...). Only the
+        /// identifiers of the new shaders are written, into the reserved space if there is enough. Otherwise the
+        /// shader table grows geometrically and the existing records, including their local root arguments, are
+        /// copied over. Indices of existing shaders never change.
+        /// @param table The shader table to update. If it has not been built yet, it is created in an UPLOAD heap.
+        /// @param pipeline The pipeline to get the identifiers of the new shaders from, usually the expanded one.
+        /// @return The previous allocation if the shader table had to grow, otherwise null. It must be kept alive
+        /// until the GPU has finished all work that uses it.
+        ComPtr<DMA::Allocation> UpdateShaderTable(ShaderTable& table, ComPtr<ID3D12StateObject>& pipeline);
+
+        /// @brief Record the copies of the records that were modified since the last upload of a shader table in a
+        /// DEFAULT heap, with the barriers around them. Does nothing for shader tables in other heaps.
+        /// @param table The shader table to upload.
+        /// @param cmdList The command list to record the copies into, before the DispatchRays that use the table.
+        /// @param completedFenceValue The completed value of the fence passed to ShaderTable::SubmitUpload(...).
+        /// @note The modified ranges go through an upload buffer of the table that the GPU no longer reads, a new one
+        /// is added if all of them are in flight. Call ShaderTable::SubmitUpload(...) with the fence value signaled
+        /// after cmdList, until then the buffer counts as in flight.
+        void UploadShaderTable(ShaderTable& table, ComPtr<ID3D12GraphicsCommandList4>& cmdList,
+                               UINT64 completedFenceValue);
+
+        /// @brief Record the copies of the modified records of a shader table in a DEFAULT heap.
+        void UploadShaderTable(ShaderTable& table, ComPtr<ID3D12GraphicsCommandList4>& cmdList, ID3D12Fence* fence)
+        {
+            UploadShaderTable(table, cmdList, fence->GetCompletedValue());
+        }
+
         /// @todo Add support for writing to local root signatures.
 
     private: // Internal methods
-        /// @brief Allocate a bottom level acceleration structure, used by AllocateAccelerationStructure(...) if
+        /// @brief Fill the build inputs of a bottom level acceleration structure, used by QueryPrebuildInfo(...) if
         /// the type is bottom level.
-        ComPtr<DMA::Allocation> InternalAllocateBottomAccelerationStructure(AccelerationStructureDesc& desc);
+        void InternalFillBottomInputs(AccelerationStructureDesc& desc);
 
-        /// @brief Allocate a top level acceleration structure, used by AllocateAccelerationStructure(...) if the
+        /// @brief Fill the build inputs of a top level acceleration structure, used by QueryPrebuildInfo(...) if the
         /// type is top level.
-        ComPtr<DMA::Allocation> InternalAllocateTopAccelerationStructure(AccelerationStructureDesc& desc);
+        void InternalFillTopInputs(AccelerationStructureDesc& desc);
+
+        /// @brief Allocate the buffer of a shader table for the capacity of its sections and lay them out.
+        void InternalAllocateShaderTable(ShaderTable& table);
+
+        /// @brief Write the identifiers of the shaders that are not built yet and update the dispatch description.
+        void InternalWriteShaderIdentifiers(ShaderTable& table, ComPtr<ID3D12StateObject>& pipeline);
 
     private:
         /// @brief The D3D12 device.
@@ -209,5 +408,25 @@ namespace DXR
 
         /// @brief The pool to use for all allocations.
         ComPtr<DMA::Pool> mPool = nullptr;
+
+        /// @brief The task pool for parallel CPU work, created on first use.
+        std::shared_ptr<TaskPool> mTaskPool = nullptr;
+        std::mutex mTaskPoolMutex;
+
+        /// @brief The number of asynchronous tasks of this device that have not finished. They use the device, which
+        /// waits for them when it is destroyed, the pool may be shared and outlive it.
+        std::atomic<UINT32> mPendingAsyncTasks = 0;
+
+        /// @brief The identifiers of the shaders of all pipelines, shared by all shader tables.
+        ShaderIdentifierCache mShaderIdentifierCache;
+
+        /// @brief The state objects created by the device, by the hash of their description.
+        StateObjectCache mStateObjectCache;
+
+        /// @brief The prebuild info of acceleration structures, by the signature of their inputs.
+        PrebuildInfoCache mPrebuildInfoCache;
+
+        /// @brief The memory accounting and acceleration structure residency of the device.
+        ResidencyManager mResidencyManager;
     };
 } // namespace DXR
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/ShaderTable.h"
+
+#include <string_view>
+
+namespace DXR
+{
+    /// @brief A hit group record before deduplication.
+    struct HitGroupRecordDesc
+    {
+        /// @brief The name of the hit group in the pipeline.
+        std::wstring HitGroup = L"";
+
+        /// @brief The local root arguments of the record, can be null if the hit group has none.
+        const void* pData = nullptr;
+
+        /// @brief The size of the local root arguments.
+        UINT32 Size = 0;
+    };
+
+    /// @brief The size of a hit group table before and after deduplication.
+    struct HitGroupDedupStats
+    {
+    public: // Methods
+        /// @brief Get the number of bytes saved by deduplication.
+        UINT64 GetSavedSize() const { return OriginalSize - DeduplicatedSize; }
+
+    public: // Members
+        /// @brief The number of records that were added.
+        UINT32 NumRecords = 0;
+
+        /// @brief The number of records left after deduplication.
+        UINT32 NumUniqueRecords = 0;
+
+        /// @brief The size of the hit group section with one record per added record.
+        UINT64 OriginalSize = 0;
+
+        /// @brief The size of the hit group section after deduplication.
+        UINT64 DeduplicatedSize = 0;
+    };
+
+    /// @brief Builds a compact hit group section from records that are often byte-identical, like many
+    /// geometry/material pairs sharing a hit group and local root arguments. Records are added in groups, one group per
+    /// instance with one record per geometry of its BLAS, because an instance needs its records to be consecutive.
+    /// Groups with the same contents, shader identifiers included, are stored once.
+    ///
+    /// Usage:
+    /// 1. AddRecordGroup(...) for every instance.
+    /// 2. Build(...) with the pipeline the records are for.
+    /// 3. AddToShaderTable(...), set the hit group record size to GetRecordSize() and create the shader table.
+    /// 4. WriteShaderRecords(...) and use GetHitGroupIndex(...) as InstanceContributionToHitGroupIndex.
+    class HitGroupTableBuilder
+    {
+    public:
+        HitGroupTableBuilder() = default;
+
+        // Delete copy/move constructors and assignment operators
+
+        HitGroupTableBuilder(HitGroupTableBuilder const&) = delete;
+        HitGroupTableBuilder(HitGroupTableBuilder&&) = delete;
+        HitGroupTableBuilder& operator=(HitGroupTableBuilder const&) = delete;
+        HitGroupTableBuilder& operator=(HitGroupTableBuilder&&) = delete;
+
+    public: // Methods
+        /// @brief Add the records of an instance, one per geometry of its BLAS.
+        /// @param records The records, in geometry order.
+        /// @return The index of the group, used to look up where its records end up.
+        UINT32 AddRecordGroup(std::span<const HitGroupRecordDesc> records);
+
+        /// @brief Add a single record, for instances of a BLAS with one geometry.
+        UINT32 AddRecord(const HitGroupRecordDesc& record) { return AddRecordGroup({&record, 1}); }
+
+        /// @brief Hash the records, shader identifiers included, and collapse groups with the same contents.
+        /// @param pipeline The pipeline to get the shader identifiers from.
+        void Build(ComPtr<ID3D12StateObject>& pipeline);
+
+        /// @brief Add the deduplicated records to the hit group section of a shader table.
+        /// @param table The shader table to add the records to, after any hit groups that are already there.
+        void AddToShaderTable(ShaderTable& table);
+
+        /// @brief Write the local root arguments of the deduplicated records, once the shader table is built.
+        /// @param table The shader table passed to AddToShaderTable(...).
+        void WriteShaderRecords(ShaderTable& table) const;
+
+        /// @brief Get the index in the hit group section of the first record of a group.
+        /// @param group The index returned by AddRecordGroup(...).
+        /// @return The value for InstanceContributionToHitGroupIndex of the instance, the record of geometry i is at
+        /// this index + i.
+        UINT32 GetHitGroupIndex(UINT32 group) const { return mFirstHitGroupIndex + mGroupRemap[group]; }
+
+        /// @brief Get the index of the first record of each group in the deduplicated records, relative to the first
+        /// record added to the shader table.
+        const std::vector<UINT32>& GetRemap() const { return mGroupRemap; }
+
+        /// @brief Get the size of a record, including the shader identifier and aligned to
+        /// D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT.
+        UINT32 GetRecordSize() const { return mRecordSize; }
+
+        /// @brief Get the size reduction of the hit group section, valid after Build(...).
+        HitGroupDedupStats GetStats() const { return mStats; }
+
+    private: // Private Structs
+        struct PendingRecord
+        {
+            /// @brief The index of the hit group name in mHitGroups.
+            UINT32 HitGroup;
+
+            /// @brief The offset of the local root arguments in mPendingData.
+            UINT64 Offset;
+
+            /// @brief The size of the local root arguments.
+            UINT32 Size;
+        };
+
+    private: // Members
+        /// @brief The hit group names that are used, each once.
+        std::vector<std::wstring> mHitGroups = {};
+        std::unordered_map<std::wstring, UINT32> mHitGroupIndices = {};
+
+        /// @brief The records that were added, and the first record of each group.
+        std::vector<PendingRecord> mPendingRecords = {};
+        std::vector<BYTE> mPendingData = {};
+        std::vector<UINT32> mGroupStarts = {};
+
+        /// @brief The deduplicated records, with the shader identifier, with a stride of mRecordSize.
+        std::vector<BYTE> mRecords = {};
+        std::vector<UINT32> mRecordHitGroups = {};
+
+        /// @brief The index of the first deduplicated record of each group.
+        std::vector<UINT32> mGroupRemap = {};
+
+        /// @brief The size of a record, with the identifier, and the largest local root arguments.
+        UINT32 mRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+        UINT32 mMaxDataSize = 0;
+
+        /// @brief The first record in the hit group section of the shader table.
+        ShaderRecordHandle mFirstRecord = {};
+        UINT32 mFirstHitGroupIndex = 0;
+
+        HitGroupDedupStats mStats = {};
+    };
+
+} // namespace DXR
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/Device.h"
+
+namespace DXR
+{
+    /// @brief A stable reference to an instance of an InstanceManager. Stays valid until the instance is removed,
+    /// even when other instances are removed and the instances are moved around to stay densely packed.
+    struct InstanceHandle
+    {
+        /// @brief The identifier of the instance, UINT32_MAX if invalid.
+        UINT32 Id = UINT32_MAX;
+
+        /// @brief Check if the handle refers to an instance.
+        bool IsValid() const { return Id != UINT32_MAX; }
+    };
+
+    /// @brief Manages the instances of a top level acceleration structure. Instances are stored on the CPU as a
+    /// struct of arrays and every change marks the instance as dirty. Flushing only writes the dirty ranges into a
+    /// persistently mapped instance buffer, so when a small part of the scene moves, only that part is uploaded.
+    /// There is one instance buffer per frame in flight, each with its own dirty bits, so the buffer that is written
+    /// is never the one the GPU is reading.
+    class InstanceManager
+    {
+    public:
+        /// @brief Create an instance manager.
+        /// @param device The device to allocate the instance buffers with.
+        /// @param capacity The number of instances to allocate space for. Grows automatically if exceeded.
+        /// @param numBuffers The number of instance buffers, usually the number of frames in flight.
+        /// @param heapType The heap of the instance buffers, must be CPU accessible.
+        InstanceManager(Device& device, UINT32 capacity, UINT32 numBuffers = 2,
+                        D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_UPLOAD);
+
+        // Delete copy/move constructors and assignment operators
+
+        InstanceManager(InstanceManager const&) = delete;
+        InstanceManager(InstanceManager&&) = delete;
+        InstanceManager& operator=(InstanceManager const&) = delete;
+        InstanceManager& operator=(InstanceManager&&) = delete;
+
+    public:
+        /// @brief Add an instance.
+        /// @param accelStruct The GPU virtual address of the bottom level acceleration structure.
+        /// @param transform The transform of the instance, a 3x4 row-major matrix like
+        /// D3D12_RAYTRACING_INSTANCE_DESC::Transform.
+        /// @param instanceID The value of InstanceID() in shaders, 24 bits.
+        /// @param mask The instance mask.
+        /// @param hitGroupOffset The contribution to the hit group index, 24 bits.
+        /// @param flags The instance flags.
+        /// @return The handle of the new instance.
+        InstanceHandle AddInstance(D3D12_GPU_VIRTUAL_ADDRESS accelStruct, const XMFLOAT3X4& transform,
+                                   UINT32 instanceID = 0, UINT8 mask = 0xFF, UINT32 hitGroupOffset = 0,
+                                   D3D12_RAYTRACING_INSTANCE_FLAGS flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE);
+
+        /// @brief Remove an instance. The last instance is moved into its slot to keep the instances dense.
+        /// @param handle The handle of the instance, invalid afterwards.
+        void RemoveInstance(InstanceHandle handle);
+
+        /// @brief Set the transform of an instance, a 3x4 row-major matrix like D3D12_RAYTRACING_INSTANCE_DESC.
+        void SetTransform(InstanceHandle handle, const XMFLOAT3X4& transform);
+
+        /// @brief Set the transform of an instance from a DirectXMath matrix.
+        void SetTransform(InstanceHandle handle, FXMMATRIX transform);
+
+        /// @brief Set the bottom level acceleration structure of an instance.
+        void SetAccelerationStructure(InstanceHandle handle, D3D12_GPU_VIRTUAL_ADDRESS accelStruct);
+
+        /// @brief Point the instances of moved bottom level acceleration structures to their new address, e.g. after
+        /// AccelStructArena::Defragment(...). The next Flush(...) writes them.
+        /// @param remap The new addresses by the old ones.
+        /// @return The number of instances that were changed.
+        UINT32 RemapAccelerationStructures(const AccelStructRemap& remap);
+
+        /// @brief Set the value of InstanceID() in shaders, 24 bits.
+        void SetInstanceID(InstanceHandle handle, UINT32 instanceID);
+
+        /// @brief Set the instance mask.
+        void SetMask(InstanceHandle handle, UINT8 mask);
+
+        /// @brief Set the contribution to the hit group index, 24 bits.
+        void SetHitGroupOffset(InstanceHandle handle, UINT32 hitGroupOffset);
+
+        /// @brief Set the instance flags.
+        void SetFlags(InstanceHandle handle, D3D12_RAYTRACING_INSTANCE_FLAGS flags);
+
+        /// @brief Write the dirty instances into the instance buffer of a frame and point the top level acceleration
+        /// structure at it.
+        /// @param frameIndex The index of the frame, the buffer frameIndex % numBuffers is written. The GPU must have
+        /// finished the frame that last used that buffer.
+        /// @param tlas The top level acceleration structure, its vpInstanceDescs and NumInstanceDescs are set.
+        /// @return The number of instances that were written.
+        UINT32 Flush(UINT32 frameIndex, AccelerationStructureDesc& tlas);
+
+        /// @brief Get the number of instances, which is also the number of instances in the top level acceleration
+        /// structure since they are kept dense.
+        UINT32 GetInstanceCount() const { return static_cast<UINT32>(mAccelStructs.size()); }
+
+        /// @brief Get the bottom level acceleration structure of each instance, e.g. for
+        /// ResidencyManager::MarkReferenced(...).
+        std::span<const D3D12_GPU_VIRTUAL_ADDRESS> GetAccelerationStructures() const { return mAccelStructs; }
+
+        /// @brief Get the index of an instance in the instance buffer. Changes when other instances are removed.
+        UINT32 GetInstanceIndex(InstanceHandle handle) const { return mHandleToSlot[handle.Id]; }
+
+        /// @brief Get the number of dirty ranges written by the last Flush(...), to see how well changes coalesce.
+        UINT32 GetLastFlushRangeCount() const { return mLastFlushRangeCount; }
+
+    private: // Internal methods
+        /// @brief Get the slot of a valid handle.
+        UINT32 GetSlot(InstanceHandle handle) const;
+
+        /// @brief Mark a slot as dirty in the instance buffers of all frames.
+        void MarkDirty(UINT32 slot);
+
+    private: // Private Structs
+        struct InstanceBuffer
+        {
+            /// @brief The instance buffer resource.
+            ComPtr<DMA::Allocation> Allocation = nullptr;
+
+            /// @brief The persistently mapped instance descs.
+            D3D12_RAYTRACING_INSTANCE_DESC* pDescs = nullptr;
+
+            /// @brief The number of instances the buffer can hold.
+            UINT32 Capacity = 0;
+
+            /// @brief One bit per slot, set if the slot has changed since this buffer was last written.
+            std::vector<UINT64> DirtyBits = {};
+        };
+
+    private: // Members
+        /// @brief The device used to allocate the instance buffers.
+        Device& mDevice;
+
+        /// @brief The heap of the instance buffers.
+        D3D12_HEAP_TYPE mHeapType;
+
+        /// @brief The instance buffers, one per frame in flight.
+        std::vector<InstanceBuffer> mBuffers = {};
+
+        // The instance data, indexed by slot.
+
+        std::vector<XMFLOAT3X4> mTransforms = {};
+        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> mAccelStructs = {};
+        std::vector<UINT32> mInstanceIDs = {};
+        std::vector<UINT32> mHitGroupOffsets = {};
+        std::vector<UINT8> mMasks = {};
+        std::vector<UINT8> mFlags = {};
+
+        // Mapping between handles and slots, so handles stay valid when slots move.
+
+        std::vector<UINT32> mSlotToHandle = {};
+        std::vector<UINT32> mHandleToSlot = {};
+        std::vector<UINT32> mFreeHandles = {};
+
+        /// @brief The number of ranges written by the last flush.
+        UINT32 mLastFlushRangeCount = 0;
+    };
+
+} // namespace DXR
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/TaskPool.h"
+
+namespace DXR
+{
+    /// @brief The memory layout of the 4x4 matrices that are packed into instance descriptions.
+    enum class MatrixLayout
+    {
+        /// @brief The matrices transform column vectors and are stored row by row, the translation is in the last
+        /// column. The first three rows are D3D12_RAYTRACING_INSTANCE_DESC::Transform as is.
+        RowMajor,
+        /// @brief The matrices are stored column by column, the translation is in the last 4 floats. This is also the
+        /// layout of DirectXMath's XMMATRIX and XMFLOAT4X4, which use row vectors. Transposed while packing.
+        ColumnMajor
+    };
+
+    /// @brief The instance data to pack, as separate arrays. Optional arrays may be null, in which case the default
+    /// value is used for every instance.
+    struct InstancePackDesc
+    {
+        /// @brief The transforms of the instances. Required.
+        const XMFLOAT4X4* pTransforms = nullptr;
+
+        /// @brief The layout of pTransforms.
+        MatrixLayout Layout = MatrixLayout::ColumnMajor;
+
+        /// @brief The bottom level acceleration structure of the instances. Required.
+        const D3D12_GPU_VIRTUAL_ADDRESS* pAccelStructs = nullptr;
+
+        /// @brief The values of InstanceID() in shaders, 24 bits. Optional, defaults to the index of the instance.
+        const UINT32* pInstanceIDs = nullptr;
+
+        /// @brief The instance masks. Optional, defaults to 0xFF.
+        const UINT8* pMasks = nullptr;
+
+        /// @brief The contributions to the hit group index, 24 bits. Optional, defaults to 0.
+        const UINT32* pHitGroupOffsets = nullptr;
+
+        /// @brief The instance flags, D3D12_RAYTRACING_INSTANCE_FLAGS. Optional, defaults to none.
+        const UINT8* pFlags = nullptr;
+    };
+
+    /// @brief Pack instances into instance descriptions. Uses SSE transposes and streaming stores that bypass the
+    /// cache, which is the fastest way to write into write-combined upload memory, when available. Falls back to
+    /// PackInstanceDescsScalar(...) otherwise or if pDest isn't 16 byte aligned.
+    /// @param src The instance data.
+    /// @param first The index of the first instance to pack.
+    /// @param count The number of instances to pack.
+    /// @param pDest The instance descriptions, instance i is written to pDest[i]. Should be
+    /// D3D12_RAYTRACING_INSTANCE_DESCS_BYTE_ALIGNMENT aligned, like the mapping of Device::AllocateInstanceBuffer(...).
+    void PackInstanceDescs(const InstancePackDesc& src, UINT64 first, UINT64 count,
+                           D3D12_RAYTRACING_INSTANCE_DESC* pDest);
+
+    /// @brief Pack instances into instance descriptions without SIMD. Produces exactly the same bytes as
+    /// PackInstanceDescs(...), so it can be used as a reference.
+    /// @param src The instance data.
+    /// @param first The index of the first instance to pack.
+    /// @param count The number of instances to pack.
+    /// @param pDest The instance descriptions, instance i is written to pDest[i].
+    void PackInstanceDescsScalar(const InstancePackDesc& src, UINT64 first, UINT64 count,
+                                 D3D12_RAYTRACING_INSTANCE_DESC* pDest);
+
+    /// @brief Pack instances into instance descriptions on multiple threads with PackInstanceDescs(...). Every
+    /// instance description is exactly one 64 byte cache line, so as long as pDest is 64 byte aligned, no two threads
+    /// write to the same line of the write-combined mapping.
+    /// @param pool The pool to run on.
+    /// @param src The instance data.
+    /// @param count The number of instances to pack, starting at 0.
+    /// @param pDest The instance descriptions, should be 64 byte aligned.
+    /// @param grainSize The number of instances packed by one task.
+    void PackInstanceDescsParallel(TaskPool& pool, const InstancePackDesc& src, UINT64 count,
+                                   D3D12_RAYTRACING_INSTANCE_DESC* pDest, UINT64 grainSize = 4096);
+
+} // namespace DXR
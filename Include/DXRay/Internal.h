@@ -0,0 +1,81 @@
+#pragma once
+
+#include "DXRay/Common.h"
+
+//////////////////////////////////////////////////////////////////////////
+// INTERNAL HELPERS SHARED BY THE DXR SOURCES, NOT PART OF THE API      //
+//////////////////////////////////////////////////////////////////////////
+
+namespace DXR
+{
+    namespace Internal
+    {
+        /// @brief Combine a value into a hash, order dependent.
+        inline UINT64 HashCombine(UINT64 hash, UINT64 value)
+        {
+            return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+        }
+
+        /// @brief Spread the lower 10 bits of a value to every third bit.
+        inline UINT32 ExpandBits(UINT32 v)
+        {
+            v = (v * 0x00010001u) & 0xFF0000FFu;
+            v = (v * 0x00000101u) & 0x0F00F00Fu;
+            v = (v * 0x00000011u) & 0xC30C30C3u;
+            v = (v * 0x00000005u) & 0x49249249u;
+            return v;
+        }
+
+        /// @brief Get the 30-bit Morton code of a point.
+        /// @param x, y, z The coordinates normalized to [0, 1], values outside are clamped.
+        inline UINT32 MortonCode(float x, float y, float z)
+        {
+            auto quantize = [](float v) { return static_cast<UINT32>(std::clamp(v * 1023.0f, 0.0f, 1023.0f)); };
+            return (ExpandBits(quantize(x)) << 2) | (ExpandBits(quantize(y)) << 1) | ExpandBits(quantize(z));
+        }
+
+        /// @brief An axis-aligned bounding box, empty until grown.
+        struct Bounds
+        {
+            XMFLOAT3 Min = {FLT_MAX, FLT_MAX, FLT_MAX};
+            XMFLOAT3 Max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+            void Grow(const XMFLOAT3& p)
+            {
+                Min = {std::min(Min.x, p.x), std::min(Min.y, p.y), std::min(Min.z, p.z)};
+                Max = {std::max(Max.x, p.x), std::max(Max.y, p.y), std::max(Max.z, p.z)};
+            }
+
+            void Grow(const Bounds& other)
+            {
+                Min = {std::min(Min.x, other.Min.x), std::min(Min.y, other.Min.y), std::min(Min.z, other.Min.z)};
+                Max = {std::max(Max.x, other.Max.x), std::max(Max.y, other.Max.y), std::max(Max.z, other.Max.z)};
+            }
+
+            bool IsEmpty() const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+
+            /// @brief Get the surface area, the SAH only needs ratios so half of it is enough.
+            float GetArea() const
+            {
+                if (IsEmpty())
+                    return 0.0f;
+
+                float dx = Max.x - Min.x, dy = Max.y - Min.y, dz = Max.z - Min.z;
+                return dx * dy + dy * dz + dz * dx;
+            }
+
+            XMFLOAT3 GetCenter() const
+            {
+                return {(Min.x + Max.x) * 0.5f, (Min.y + Max.y) * 0.5f, (Min.z + Max.z) * 0.5f};
+            }
+
+            static Bounds Intersect(const Bounds& a, const Bounds& b)
+            {
+                Bounds result = {};
+                result.Min = {std::max(a.Min.x, b.Min.x), std::max(a.Min.y, b.Min.y), std::max(a.Min.z, b.Min.z)};
+                result.Max = {std::min(a.Max.x, b.Max.x), std::min(a.Max.y, b.Max.y), std::min(a.Max.z, b.Max.z)};
+                return result;
+            }
+        };
+    } // namespace Internal
+} // namespace DXR
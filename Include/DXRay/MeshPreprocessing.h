@@ -0,0 +1,128 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/TaskPool.h"
+
+namespace DXR
+{
+    /// @brief A triangle mesh to preprocess, as it comes from the asset.
+    struct MeshInput
+    {
+        /// @brief The positions of the vertices, 3 floats each. Required.
+        const void* pPositions = nullptr;
+
+        /// @brief The distance between two positions in bytes.
+        UINT32 PositionStride = sizeof(XMFLOAT3);
+
+        /// @brief The number of vertices.
+        UINT32 VertexCount = 0;
+
+        /// @brief The indices of the triangles. Optional, if null every 3 vertices are a triangle.
+        const UINT32* pIndices = nullptr;
+
+        /// @brief The number of indices, ignored if pIndices is null.
+        UINT32 IndexCount = 0;
+    };
+
+    /// @brief What PreprocessMesh(...) does.
+    struct MeshPreprocessOptions
+    {
+        /// @brief Merge vertices that are at most this far apart. 0 merges vertices with exactly the same position.
+        /// Welding is done with a hash grid with cells of this size, so it is linear in the number of vertices.
+        float WeldTolerance = 0.0f;
+
+        /// @brief Remove triangles with repeated vertices after welding, and triangles with at most MinTriangleArea.
+        bool RemoveDegenerates = true;
+
+        /// @brief Triangles with this area or less are removed, if RemoveDegenerates is set.
+        float MinTriangleArea = 0.0f;
+
+        /// @brief Sort the triangles along a Morton curve of their centroids, and the vertices by their first use,
+        /// so triangles that are close in space are close in memory. Builders read the mesh in order, and their
+        /// initial clusters are better with spatially coherent input.
+        bool ReorderTriangles = true;
+    };
+
+    /// @brief The before and after statistics of preprocessing.
+    struct MeshPreprocessStats
+    {
+    public: // Methods
+        /// @brief Add the statistics of another mesh.
+        MeshPreprocessStats& operator+=(const MeshPreprocessStats& other)
+        {
+            InputVertices += other.InputVertices;
+            OutputVertices += other.OutputVertices;
+            InputTriangles += other.InputTriangles;
+            OutputTriangles += other.OutputTriangles;
+            DegenerateTriangles += other.DegenerateTriangles;
+            ZeroAreaTriangles += other.ZeroAreaTriangles;
+            return *this;
+        }
+
+    public: // Members
+        /// @brief The number of vertices before and after welding.
+        UINT64 InputVertices = 0;
+        UINT64 OutputVertices = 0;
+
+        /// @brief The number of triangles before and after removing degenerates.
+        UINT64 InputTriangles = 0;
+        UINT64 OutputTriangles = 0;
+
+        /// @brief The triangles that were removed for repeated vertices.
+        UINT64 DegenerateTriangles = 0;
+
+        /// @brief The triangles that were removed for their area.
+        UINT64 ZeroAreaTriangles = 0;
+    };
+
+    /// @brief A preprocessed mesh, ready to be copied into GPU buffers.
+    struct PreprocessedMesh
+    {
+    public: // Methods
+        /// @brief Get the geometry description of the mesh, once its streams have been uploaded.
+        /// @param vertexBuffer The address of Vertices on the GPU.
+        /// @param indexBuffer The address of Indices on the GPU.
+        /// @param flags The flags of the geometry.
+        D3D12_RAYTRACING_GEOMETRY_DESC GetGeometryDesc(
+            D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer, D3D12_GPU_VIRTUAL_ADDRESS indexBuffer,
+            D3D12_RAYTRACING_GEOMETRY_FLAGS flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE) const;
+
+        /// @brief Get the size of the vertex stream in bytes.
+        UINT64 GetVertexDataSize() const { return Vertices.size() * sizeof(XMFLOAT3); }
+
+        /// @brief Get the size of the index stream in bytes.
+        UINT64 GetIndexDataSize() const { return Indices.size() * sizeof(UINT32); }
+
+    public: // Members
+        /// @brief The vertex stream, DXGI_FORMAT_R32G32B32_FLOAT.
+        std::vector<XMFLOAT3> Vertices = {};
+
+        /// @brief The index stream, DXGI_FORMAT_R32_UINT.
+        std::vector<UINT32> Indices = {};
+
+        /// @brief The index of the input vertex each output vertex came from, to carry other attributes over.
+        std::vector<UINT32> SourceVertices = {};
+
+        /// @brief The index of the input triangle each output triangle came from. Triangles are dropped and reordered,
+        /// so PrimitiveIndex() in a hit shader indexes this array, not the per-triangle attributes of the input.
+        std::vector<UINT32> SourceTriangles = {};
+
+        /// @brief The statistics of the mesh.
+        MeshPreprocessStats Stats = {};
+    };
+
+    /// @brief Weld the vertices of a mesh, remove its degenerate triangles and sort it for spatial locality.
+    /// @param mesh The mesh.
+    /// @param options What to do.
+    /// @return The preprocessed mesh.
+    PreprocessedMesh PreprocessMesh(const MeshInput& mesh, const MeshPreprocessOptions& options = {});
+
+    /// @brief Preprocess meshes on multiple threads, one task per mesh.
+    /// @param pool The pool to run on.
+    /// @param meshes The meshes.
+    /// @param options What to do.
+    /// @return The preprocessed meshes, in the order of the input.
+    std::vector<PreprocessedMesh> PreprocessMeshes(TaskPool& pool, std::span<const MeshInput> meshes,
+                                                   const MeshPreprocessOptions& options = {});
+
+} // namespace DXR
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "DXRay/Common.h"
+
+namespace DXR
+{
+    /// @brief A range allocated from an OffsetAllocator.
+    struct OffsetAllocation
+    {
+        /// @brief The offset of the range in bytes, UINT64_MAX if the allocation failed.
+        UINT64 Offset = UINT64_MAX;
+
+        /// @brief The node of the range in the allocator, needed to free it.
+        UINT32 Node = UINT32_MAX;
+
+        /// @brief Check if the allocation succeeded.
+        bool IsValid() const { return Offset != UINT64_MAX; }
+    };
+
+    /// @brief A two-level segregated fit (TLSF) allocator of ranges of a buffer. It only does bookkeeping, so it
+    /// works on any memory or none at all. Allocating and freeing are O(1): free ranges are kept in 256 bins by a
+    /// small floating point encoding of their size, and two levels of bit masks find the first non-empty bin that is
+    /// large enough. Freed ranges are merged with free neighbours right away.
+    class OffsetAllocator
+    {
+    public:
+        /// @brief Create an offset allocator.
+        /// @param size The size of the range to allocate from, in bytes.
+        /// @param granularity The alignment of all offsets and sizes, a power of two.
+        /// @param maxAllocations The maximum number of allocations and free ranges at the same time.
+        OffsetAllocator(UINT64 size, UINT64 granularity = 1, UINT32 maxAllocations = 65536);
+
+    public: // Methods
+        /// @brief Allocate a range.
+        /// @param size The size of the range in bytes, rounded up to the granularity.
+        /// @return The allocation, invalid if there is no free range that is large enough.
+        OffsetAllocation Allocate(UINT64 size);
+
+        /// @brief Free a range.
+        /// @param allocation The allocation returned by Allocate(...).
+        void Free(OffsetAllocation allocation);
+
+        /// @brief Free all ranges.
+        void Reset();
+
+        /// @brief Get the size of an allocation, rounded up to the granularity.
+        UINT64 GetAllocationSize(OffsetAllocation allocation) const;
+
+        /// @brief Get the size of the range that is allocated from.
+        UINT64 GetSize() const { return UINT64(mSize) * mGranularity; }
+
+        /// @brief Get the number of free bytes.
+        UINT64 GetFreeSize() const { return UINT64(mFreeStorage) * mGranularity; }
+
+        /// @brief Get the size of the largest allocation that is guaranteed to succeed. Ranges are binned by size, so
+        /// this can be up to 1/8 smaller than the largest free range.
+        UINT64 GetLargestFreeRange() const;
+
+        /// @brief Get the number of allocations.
+        UINT32 GetAllocationCount() const { return mNumAllocations; }
+
+    private: // Private Structs
+        struct Node
+        {
+            static constexpr UINT32 Unused = UINT32_MAX;
+
+            /// @brief The offset and size of the range, in units of the granularity.
+            UINT32 DataOffset = 0;
+            UINT32 DataSize = 0;
+
+            /// @brief The list of free nodes of the same bin.
+            UINT32 BinListPrev = Unused;
+            UINT32 BinListNext = Unused;
+
+            /// @brief The nodes of the ranges right before and after this one.
+            UINT32 NeighborPrev = Unused;
+            UINT32 NeighborNext = Unused;
+
+            bool Used = false;
+        };
+
+    private: // Internal methods
+        UINT32 InternalInsertNodeIntoBin(UINT32 size, UINT32 offset);
+        void InternalRemoveNodeFromBin(UINT32 nodeIndex);
+
+    private: // Members
+        static constexpr UINT32 NumTopBins = 32;
+        static constexpr UINT32 BinsPerLeaf = 8;
+        static constexpr UINT32 TopBinsIndexShift = 3;
+        static constexpr UINT32 LeafBinsIndexMask = 0x7;
+        static constexpr UINT32 NumLeafBins = NumTopBins * BinsPerLeaf;
+
+        UINT64 mGranularity = 1;
+        UINT32 mSize = 0;
+        UINT32 mMaxAllocations = 0;
+        UINT32 mFreeStorage = 0;
+        UINT32 mNumAllocations = 0;
+
+        /// @brief A bit per top bin that has a non-empty leaf bin, and a bit per non-empty leaf bin.
+        UINT32 mUsedBinsTop = 0;
+        UINT8 mUsedBins[NumTopBins] = {};
+
+        /// @brief The first free node of each bin.
+        UINT32 mBinIndices[NumLeafBins] = {};
+
+        std::vector<Node> mNodes = {};
+
+        /// @brief A stack of unused node indices.
+        std::vector<UINT32> mFreeNodes = {};
+    };
+
+} // namespace DXR
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "DXRay/Common.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+namespace DXR
+{
+    /// @brief Hash the fields of build inputs that decide the sizes of an acceleration structure: the type, build
+    /// flags, and per geometry its type, flags, formats and counts. GPU addresses are ignored, so acceleration
+    /// structures of different meshes with the same signature get the same hash.
+    /// @param inputs The build inputs to hash.
+    /// @return The hash, or 0 if the inputs have geometry types that can't be hashed.
+    UINT64 HashPrebuildInputs(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs);
+
+    /// @brief The statistics of a PrebuildInfoCache.
+    struct PrebuildInfoCacheStats
+    {
+    public: // Methods
+        /// @brief Get the fraction of requests that didn't need a driver call.
+        float GetHitRate() const
+        {
+            UINT64 total = Hits + Misses;
+            return total == 0 ? 0.0f : static_cast<float>(Hits) / static_cast<float>(total);
+        }
+
+    public: // Members
+        /// @brief The number of requests that were served from the cache.
+        UINT64 Hits = 0;
+
+        /// @brief The number of requests that were queried from the driver and cached.
+        UINT64 Misses = 0;
+
+        /// @brief The number of requests that couldn't be hashed and were queried without the cache.
+        UINT64 Uncacheable = 0;
+    };
+
+    /// @brief A thread-safe cache of acceleration structure prebuild info by the signature of the build inputs, see
+    /// HashPrebuildInputs(...). Scenes often have thousands of BLASes with the same vertex and index counts, which
+    /// then need one driver call instead of one each. The fields of the signature are stored with the hash, so
+    /// signatures with the same hash never share prebuild info.
+    class PrebuildInfoCache
+    {
+    public:
+        PrebuildInfoCache() = default;
+
+        // Delete copy/move constructors and assignment operators
+
+        PrebuildInfoCache(PrebuildInfoCache const&) = delete;
+        PrebuildInfoCache(PrebuildInfoCache&&) = delete;
+        PrebuildInfoCache& operator=(PrebuildInfoCache const&) = delete;
+        PrebuildInfoCache& operator=(PrebuildInfoCache&&) = delete;
+
+    public: // Methods
+        /// @brief Get the prebuild info of build inputs from the cache, or query it if there is none for their
+        /// signature.
+        /// @param inputs The build inputs.
+        /// @param query Queries the prebuild info from the driver, called if the signature is not cached.
+        /// @return The prebuild info.
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO GetOrQuery(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs,
+            const std::function<void(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO&)>& query);
+
+        /// @brief Remove all cached prebuild info.
+        void Clear();
+
+        /// @brief Get the number of cached signatures.
+        size_t GetSize();
+
+        /// @brief Get the statistics of the cache.
+        PrebuildInfoCacheStats GetStats() const { return {mHits.load(), mMisses.load(), mUncacheable.load()}; }
+
+    private: // Private Structs
+        struct Entry
+        {
+            /// @brief The sizing-relevant fields of the build inputs, compared on lookup.
+            std::vector<UINT64> Signature = {};
+
+            /// @brief The prebuild info queried for the signature.
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO PrebuildInfo = {};
+        };
+
+    private: // Members
+        std::mutex mMutex;
+        std::unordered_multimap<UINT64, Entry> mEntries = {};
+
+        std::atomic<UINT64> mHits = 0;
+        std::atomic<UINT64> mMisses = 0;
+        std::atomic<UINT64> mUncacheable = 0;
+    };
+
+} // namespace DXR
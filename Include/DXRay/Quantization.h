@@ -0,0 +1,117 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/MeshPreprocessing.h"
+
+namespace DXR
+{
+    /// @brief What QuantizeMesh(...) is allowed to do.
+    struct QuantizationOptions
+    {
+        /// @brief The largest distance in mesh units a quantized vertex may be from its original position. Meshes
+        /// that would exceed it keep 32-bit float vertices.
+        float MaxPositionError = 1e-3f;
+
+        /// @brief Allow DXGI_FORMAT_R16G16B16A16_SNORM vertices, dequantized with the transform of the geometry.
+        bool AllowVertex16 = true;
+
+        /// @brief Allow DXGI_FORMAT_R16_UINT indices when every vertex can be addressed with 16 bits.
+        bool AllowIndex16 = true;
+    };
+
+    /// @brief The statistics of quantization.
+    struct QuantizationStats
+    {
+    public: // Methods
+        /// @brief Add the statistics of another mesh.
+        QuantizationStats& operator+=(const QuantizationStats& other)
+        {
+            Meshes += other.Meshes;
+            Vertex16Meshes += other.Vertex16Meshes;
+            Index16Meshes += other.Index16Meshes;
+            OriginalSize += other.OriginalSize;
+            QuantizedSize += other.QuantizedSize;
+            MaxPositionError = std::max(MaxPositionError, other.MaxPositionError);
+            return *this;
+        }
+
+        /// @brief Get the number of bytes saved by quantization.
+        UINT64 GetSavedSize() const { return OriginalSize - QuantizedSize; }
+
+    public: // Members
+        /// @brief The number of meshes, and how many of them got 16-bit vertices and 16-bit indices.
+        UINT64 Meshes = 0;
+        UINT64 Vertex16Meshes = 0;
+        UINT64 Index16Meshes = 0;
+
+        /// @brief The size of the vertex and index streams before and after quantization, in bytes. The quantized
+        /// size includes the transforms.
+        UINT64 OriginalSize = 0;
+        UINT64 QuantizedSize = 0;
+
+        /// @brief The largest distance between an original and a dequantized vertex.
+        float MaxPositionError = 0.0f;
+    };
+
+    /// @brief A mesh with quantized vertex and index streams, ready to be copied into GPU buffers.
+    struct QuantizedMesh
+    {
+    public: // Methods
+        /// @brief Get the geometry description of the mesh, once its streams and transform have been uploaded.
+        /// @param vertexBuffer The address of VertexData on the GPU.
+        /// @param indexBuffer The address of IndexData on the GPU.
+        /// @param transform The address of Transform on the GPU, D3D12_RAYTRACING_TRANSFORM3X4_BYTE_ALIGNMENT aligned.
+        /// Ignored if the mesh has no transform.
+        /// @param flags The flags of the geometry.
+        D3D12_RAYTRACING_GEOMETRY_DESC GetGeometryDesc(
+            D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer, D3D12_GPU_VIRTUAL_ADDRESS indexBuffer,
+            D3D12_GPU_VIRTUAL_ADDRESS transform,
+            D3D12_RAYTRACING_GEOMETRY_FLAGS flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE) const;
+
+        /// @brief Get a vertex the way the builder sees it, after dequantization.
+        /// @param index The index of the vertex.
+        XMFLOAT3 GetPosition(UINT32 index) const;
+
+        /// @brief Check if the vertices must be dequantized with Transform.
+        bool HasTransform() const { return VertexFormat != DXGI_FORMAT_R32G32B32_FLOAT; }
+
+    public: // Members
+        /// @brief The vertex stream, DXGI_FORMAT_R16G16B16A16_SNORM or DXGI_FORMAT_R32G32B32_FLOAT.
+        std::vector<BYTE> VertexData = {};
+        DXGI_FORMAT VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+        UINT32 VertexStride = sizeof(XMFLOAT3);
+        UINT32 VertexCount = 0;
+
+        /// @brief The index stream, DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT.
+        std::vector<BYTE> IndexData = {};
+        DXGI_FORMAT IndexFormat = DXGI_FORMAT_R32_UINT;
+        UINT32 IndexCount = 0;
+
+        /// @brief The row-major 3x4 transform that maps the quantized vertices back to mesh space, as
+        /// D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC::Transform3x4 expects it. Only used if HasTransform().
+        XMFLOAT3X4 Transform = {};
+
+        /// @brief The statistics of the mesh.
+        QuantizationStats Stats = {};
+    };
+
+    /// @brief Quantize the vertices of a mesh to 16-bit SNORM in its bounding box, if the error stays within the
+    /// bound, and its indices to 16 bits, if the vertex count allows it. This halves the memory the builder reads.
+    /// The error is measured by dequantizing every vertex on the CPU the way the builder does.
+    /// @param vertices The vertices.
+    /// @param indices The indices.
+    /// @param options What to do.
+    /// @return The quantized mesh.
+    QuantizedMesh QuantizeMesh(std::span<const XMFLOAT3> vertices, std::span<const UINT32> indices,
+                               const QuantizationOptions& options = {});
+
+    /// @brief Quantize a preprocessed mesh, see QuantizeMesh(...).
+    /// @param mesh The mesh.
+    /// @param options What to do.
+    /// @return The quantized mesh.
+    inline QuantizedMesh QuantizeMesh(const PreprocessedMesh& mesh, const QuantizationOptions& options = {})
+    {
+        return QuantizeMesh(mesh.Vertices, mesh.Indices, options);
+    }
+
+} // namespace DXR
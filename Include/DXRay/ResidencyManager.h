@@ -0,0 +1,232 @@
+#pragma once
+
+#include "DXRay/Common.h"
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+
+namespace DXR
+{
+    /// @brief What a resource allocated by Device::AllocateResource(...) is used for, for memory accounting.
+    enum class MemoryCategory : UINT32
+    {
+        /// @brief Acceleration structures and arena blocks.
+        AccelerationStructure,
+        /// @brief Scratch buffers of acceleration structure builds.
+        Scratch,
+        /// @brief Shader tables and their upload buffers.
+        ShaderTable,
+        /// @brief Instance buffers of top level acceleration structures.
+        Instances,
+        /// @brief Upload rings.
+        Upload,
+        /// @brief Everything else, including resources allocated without a category.
+        Other,
+
+        Count
+    };
+
+    /// @brief When the ResidencyManager evicts acceleration structures.
+    struct ResidencyPolicy
+    {
+        /// @brief Eviction starts when the usage goes above this fraction of the budget.
+        float HighWatermark = 0.95f;
+
+        /// @brief Eviction stops when the usage is below this fraction of the budget. The gap to HighWatermark
+        /// keeps the manager from evicting and restoring the same acceleration structures every frame.
+        float LowWatermark = 0.85f;
+
+        /// @brief The number of frames an acceleration structure must not have been referenced before it can be
+        /// evicted, at least the number of frames in flight.
+        UINT64 MinIdleFrames = 3;
+    };
+
+    /// @brief What ResidencyManager::Update(...) did.
+    struct ResidencyUpdate
+    {
+        /// @brief The acceleration structures that were evicted, least recently used first.
+        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> Evicted = {};
+
+        /// @brief The evicted acceleration structures that were referenced again and made resident.
+        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> MadeResident = {};
+
+        /// @brief The number of pageables that were evicted and made resident, fewer than the acceleration structures
+        /// when they share pageables. Counted in simulation mode too.
+        UINT32 EvictedPageables = 0;
+        UINT32 MadeResidentPageables = 0;
+
+        /// @brief The budget of local video memory.
+        UINT64 Budget = 0;
+
+        /// @brief The usage of local video memory before the update.
+        UINT64 Usage = 0;
+    };
+
+    /// @brief Accounts the memory a Device allocates by category, and keeps bottom level acceleration structures
+    /// within the video memory budget of the adapter. Acceleration structures are kept in LRU order of the last frame
+    /// a top level acceleration structure referenced them. When the usage goes over the budget, the least recently
+    /// used ones are evicted in one batch, and evicted ones are made resident again in one batch when they are
+    /// referenced. Acceleration structures may share a pageable, e.g. the block of an AccelStructArena, which is only
+    /// evicted once none of them is resident.
+    ///
+    /// SetSimulatedBudget(...) switches to simulation mode: a fake budget replaces the DXGI one and nothing is made
+    /// resident or evicted on the device, so eviction order and hysteresis can be tested without a GPU.
+    class ResidencyManager
+    {
+    public:
+        /// @brief Create a residency manager.
+        /// @param device The device to evict with, may be null in simulation mode.
+        /// @param adapter The adapter to query the budget from, must support IDXGIAdapter3. Without one, nothing is
+        /// evicted outside of simulation mode.
+        ResidencyManager(IDXRDevice* device = nullptr, IDXRAdapter* adapter = nullptr);
+        ~ResidencyManager();
+
+        // Delete copy/move constructors and assignment operators
+
+        ResidencyManager(ResidencyManager const&) = delete;
+        ResidencyManager(ResidencyManager&&) = delete;
+        ResidencyManager& operator=(ResidencyManager const&) = delete;
+        ResidencyManager& operator=(ResidencyManager&&) = delete;
+
+    public: // Methods
+        /// @brief Account an allocation to a category until its resource is destroyed.
+        void TrackAllocation(MemoryCategory category, DMA::Allocation* allocation);
+
+        /// @brief Get the number of bytes allocated for a category.
+        UINT64 GetCategoryUsage(MemoryCategory category) const
+        {
+            return mCategoryUsage[static_cast<UINT32>(category)];
+        }
+
+        /// @brief Track a bottom level acceleration structure for eviction. Untrack it before releasing it.
+        /// @param address The GPU virtual address of the acceleration structure, as used by instance descs.
+        /// @param allocation The allocation the acceleration structure is in, e.g. an AccelStructArena block. A placed
+        /// resource is made resident and evicted with its heap, a committed one with its resource, as a whole once no
+        /// resident acceleration structure is in it. Must be resident.
+        /// @param size The number of bytes of the acceleration structure. Evicting all acceleration structures in a
+        /// pageable should free the sum of their sizes.
+        /// @note Evicting a heap evicts every resource placed in it. Acceleration structures that may be evicted
+        /// should be allocated with DMA::ALLOCATION_FLAG_COMMITTED, or in a pool of their own.
+        void TrackAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address, DMA::Allocation* allocation, UINT64 size);
+
+        /// @brief Track a bottom level acceleration structure in a pageable that is made resident and evicted as is.
+        /// @param address The GPU virtual address of the acceleration structure, as used by instance descs.
+        /// @param pageable A heap or a committed resource, not a placed resource. Must be resident.
+        /// @param size The number of bytes of the acceleration structure.
+        void TrackAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address, ID3D12Pageable* pageable, UINT64 size);
+
+        /// @brief Stop tracking an acceleration structure.
+        void UntrackAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address);
+
+        /// @brief Mark acceleration structures as referenced by a top level acceleration structure in a frame, e.g.
+        /// with InstanceManager::GetAccelerationStructures(). Addresses that are not tracked are ignored.
+        void MarkReferenced(std::span<const D3D12_GPU_VIRTUAL_ADDRESS> addresses, UINT64 frame);
+
+        /// @brief Make the referenced acceleration structures resident and evict the least recently used ones if the
+        /// usage is over the budget. Call once per frame, before building the top level acceleration structures.
+        /// @param frame The current frame, the same as passed to MarkReferenced(...).
+        /// @return What was done.
+        ResidencyUpdate Update(UINT64 frame);
+
+        /// @brief Set a function that is called for each acceleration structure right before it is evicted, e.g. to
+        /// drop its instances from the top level acceleration structure.
+        void SetEvictionCallback(std::function<void(D3D12_GPU_VIRTUAL_ADDRESS)> callback);
+
+        /// @brief Set when acceleration structures are evicted.
+        void SetPolicy(const ResidencyPolicy& policy);
+
+        /// @brief Replace the DXGI budget with a fake one.
+        /// @param budget The budget of local video memory.
+        /// @param baseUsage The usage besides the resident tracked acceleration structures.
+        void SetSimulatedBudget(UINT64 budget, UINT64 baseUsage = 0);
+
+        /// @brief Get the number of bytes of tracked acceleration structures that are resident.
+        UINT64 GetResidentSize();
+
+        /// @brief Check if a tracked acceleration structure is resident.
+        bool IsResident(D3D12_GPU_VIRTUAL_ADDRESS address);
+
+    private: // Private Structs
+        struct AccelStructEntry
+        {
+            D3D12_GPU_VIRTUAL_ADDRESS Address = 0;
+            ComPtr<ID3D12Pageable> Pageable = nullptr;
+            UINT64 Size = 0;
+
+            /// @brief The last frame a top level acceleration structure referenced it.
+            UINT64 LastFrame = 0;
+
+            bool Resident = true;
+        };
+
+        struct PageableState
+        {
+            /// @brief The number of tracked acceleration structures in the pageable.
+            UINT32 Entries = 0;
+
+            /// @brief The number of those that are resident, the pageable is evicted when it drops to 0.
+            UINT32 ResidentEntries = 0;
+        };
+
+        struct DestructionContext
+        {
+            ResidencyManager* pManager;
+            ID3D12Resource* pResource;
+        };
+
+        struct TrackedAllocation
+        {
+            MemoryCategory Category = MemoryCategory::Other;
+            UINT64 Size = 0;
+
+            std::unique_ptr<DestructionContext> Context = nullptr;
+            UINT CallbackId = 0;
+        };
+
+    private: // Internal methods
+        /// @brief Get the budget and usage of local video memory, mMutex must be held.
+        void InternalQueryBudget(UINT64& budget, UINT64& usage);
+
+        static void __stdcall OnResourceDestroyed(void* pData);
+
+    private: // Members
+        IDXRDevice* mDevice = nullptr;
+        ComPtr<IDXGIAdapter3> mAdapter = nullptr;
+
+        std::atomic<UINT64> mCategoryUsage[static_cast<UINT32>(MemoryCategory::Count)] = {};
+
+        std::mutex mMutex;
+
+        /// @brief The allocations that are accounted, by resource.
+        std::unordered_map<ID3D12Resource*, TrackedAllocation> mAllocations = {};
+
+        /// @brief The tracked acceleration structures, least recently referenced first.
+        std::list<AccelStructEntry> mLRU = {};
+        std::unordered_map<D3D12_GPU_VIRTUAL_ADDRESS, std::list<AccelStructEntry>::iterator> mEntries = {};
+
+        /// @brief The pageables of the tracked acceleration structures.
+        std::unordered_map<ID3D12Pageable*, PageableState> mPageables = {};
+
+        /// @brief The evicted acceleration structures that were referenced since the last update.
+        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> mPendingResident = {};
+
+        /// @brief The pageables whose last resident acceleration structure was untracked since the last update.
+        std::vector<ComPtr<ID3D12Pageable>> mPendingEvict = {};
+
+        UINT64 mResidentSize = 0;
+
+        /// @brief The latest frame that was passed in, the last frame of newly tracked acceleration structures.
+        UINT64 mCurrentFrame = 0;
+
+        ResidencyPolicy mPolicy = {};
+        std::function<void(D3D12_GPU_VIRTUAL_ADDRESS)> mEvictionCallback = nullptr;
+
+        bool mSimulated = false;
+        UINT64 mSimulatedBudget = 0;
+        UINT64 mSimulatedBaseUsage = 0;
+    };
+
+} // namespace DXR
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/AccelStruct.h"
+
+namespace DXR
+{
+    /// @brief A group of acceleration structure builds that are recorded back-to-back and may overlap on the GPU.
+    /// Consecutive batches are separated by a UAV barrier, so every batch can reuse the scratch memory of the previous
+    /// one.
+    struct ScratchBatch
+    {
+        /// @brief The index of the first build of this batch in ScratchPlan::Order.
+        UINT32 First = 0;
+
+        /// @brief The number of builds in this batch.
+        UINT32 Count = 0;
+
+        /// @brief The scratch memory this batch occupies, starting at offset 0 of the scratch buffer.
+        UINT64 Size = 0;
+    };
+
+    /// @brief The result of planning scratch memory for a list of acceleration structure builds.
+    struct ScratchPlan
+    {
+    public: // Methods
+        /// @brief Get the number of bytes saved compared to giving every build its own scratch region.
+        UINT64 GetSavedSize() const { return UnplannedSize - PeakSize; }
+
+    public: // Members
+        /// @brief The offset into the scratch buffer of every build, in the same order as the builds that were
+        /// planned. Offsets are aligned to D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT.
+        std::vector<UINT64> Offsets = {};
+
+        /// @brief The indices of the builds in the order they should be recorded. Batches index into this vector.
+        std::vector<UINT32> Order = {};
+
+        /// @brief The batches of the plan, in recording order. A UAV barrier must be placed between two batches.
+        std::vector<ScratchBatch> Batches = {};
+
+        /// @brief The size of the scratch buffer required by the plan, which is the size of the largest batch.
+        UINT64 PeakSize = 0;
+
+        /// @brief The size of the scratch buffer if every build got its own region, the same as
+        /// Device::GetRequiredScratchBufferSize(...).
+        UINT64 UnplannedSize = 0;
+    };
+
+    /// @brief Plan the scratch memory for a list of acceleration structure builds. Builds are grouped in recording
+    /// order into batches of at most maxBatchSize builds. Builds inside a batch get disjoint regions, while builds of
+    /// different batches share memory, because the UAV barrier between batches ends the lifetime of the previous
+    /// batch's scratch memory.
+    /// @param scratchSizes The scratch sizes of the builds, as reported by the prebuild info.
+    /// @param maxBatchSize The maximum number of builds that are in flight at the same time. 0 means no limit, which
+    /// results in the same layout as summing up all scratch sizes.
+    /// @return The plan, which only depends on the sizes so it can be computed without a device.
+    ScratchPlan PlanScratchMemory(const std::vector<UINT64>& scratchSizes, UINT32 maxBatchSize);
+
+    /// @brief Schedule a list of acceleration structure builds into batches that each fit in a scratch budget.
+    /// Builds are ordered largest-first and packed into the first batch that still has room, so the first batches are
+    /// as full as possible and the GPU has many builds to overlap.
+    /// @param scratchSizes The scratch sizes of the builds, as reported by the prebuild info.
+    /// @param scratchBudget The maximum scratch memory a batch may use. A build that is larger than the budget on its
+    /// own gets a batch of its own, in which case ScratchPlan::PeakSize exceeds the budget.
+    /// @param maxBatchSize The maximum number of builds in a batch. 0 means no limit.
+    /// @return The plan, which only depends on the sizes so it can be computed without a device.
+    ScratchPlan ScheduleScratchBatches(const std::vector<UINT64>& scratchSizes, UINT64 scratchBudget,
+                                       UINT32 maxBatchSize = 0);
+
+    /// @brief Record the builds of a plan into a command list, emitting exactly one UAV barrier on the scratch buffer
+    /// between two batches. No barrier is recorded after the last batch, the caller has to place one before the
+    /// results are used, e.g. by a top level build.
+    /// @tparam CommandList ID3D12GraphicsCommandList4 or any type with the same BuildRaytracingAccelerationStructure
+    /// and ResourceBarrier methods, which allows recording into a fake command list.
+    /// @param plan The plan the scratch buffer has been assigned with.
+    /// @param descs The descriptions of the acceleration structures, the same that were used to create the plan.
+    /// @param cmdList The command list to record into.
+    /// @param scratch The scratch buffer resource shared by all builds.
+    template <typename CommandList>
+    void RecordScratchBatches(const ScratchPlan& plan, std::span<const AccelerationStructureDesc> descs,
+                              CommandList& cmdList, ID3D12Resource* scratch)
+    {
+        DXR_ASSERT(plan.Order.size() == descs.size(), "Scratch plan was made for a different list of builds");
+
+        for (size_t b = 0; b < plan.Batches.size(); b++)
+        {
+            const ScratchBatch& batch = plan.Batches[b];
+
+            // Wait for the previous batch to stop using the scratch memory before overwriting it
+            if (b > 0)
+            {
+                D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::UAV(scratch);
+                cmdList.ResourceBarrier(1, &barrier);
+            }
+
+            for (UINT32 i = batch.First; i < batch.First + batch.Count; i++)
+            {
+                cmdList.BuildRaytracingAccelerationStructure(&descs[plan.Order[i]].GetBuildDesc(), 0, nullptr);
+            }
+        }
+    }
+
+} // namespace DXR
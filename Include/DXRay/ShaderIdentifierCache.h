@@ -0,0 +1,107 @@
+#pragma once
+
+#include "DXRay/Common.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace DXR
+{
+    /// @brief A cache of shader identifiers, shared by all shader tables of a device. Identifiers are cached per
+    /// pipeline and export name. Exports keep their identifier when a pipeline is expanded with
+    /// Device::ExpandPipeline(...), so a lookup walks from the pipeline up the pipelines it was expanded from. Exports
+    /// that an expansion added are only visible to it and its own expansions, not to its siblings. Each identifier
+    /// is queried from the driver once, after that building a shader table is a lookup and a memcpy per record.
+    ///
+    /// Pipelines are forgotten when they are destroyed, through ID3DDestructionNotifier, so a new pipeline that gets
+    /// the address of a released one never sees its identifiers.
+    class ShaderIdentifierCache
+    {
+    public:
+        ShaderIdentifierCache() = default;
+        ~ShaderIdentifierCache();
+
+        // Delete copy/move constructors and assignment operators
+
+        ShaderIdentifierCache(ShaderIdentifierCache const&) = delete;
+        ShaderIdentifierCache(ShaderIdentifierCache&&) = delete;
+        ShaderIdentifierCache& operator=(ShaderIdentifierCache const&) = delete;
+        ShaderIdentifierCache& operator=(ShaderIdentifierCache&&) = delete;
+
+    public: // Methods
+        /// @brief Register a pipeline that was expanded from another one, so it sees the identifiers of its parent.
+        /// Pipelines that are not registered are tracked on their own on first use.
+        /// @param pipeline The expanded pipeline.
+        /// @param parent The pipeline it was expanded from.
+        void RegisterExpandedPipeline(ID3D12StateObject* pipeline, ID3D12StateObject* parent);
+
+        /// @brief Copy the identifiers of shaders to a buffer, querying the pipeline for the ones that are not cached.
+        /// @param pipeline The pipeline the shaders are in.
+        /// @param names The export names of the shaders, or the hit group names.
+        /// @param pDest The buffer to copy to, with room for D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES per name.
+        void GetShaderIdentifiers(ID3D12StateObject* pipeline, std::span<const std::wstring> names, BYTE* pDest);
+
+        /// @brief Forget a pipeline, its identifiers are kept as long as pipelines expanded from it are tracked.
+        /// Happens automatically when the pipeline is destroyed.
+        void InvalidatePipeline(ID3D12StateObject* pipeline);
+
+        /// @brief Get the number of identifiers that were found in the cache.
+        UINT64 GetHitCount() const { return mHitCount; }
+
+        /// @brief Get the number of identifiers that had to be queried from a pipeline.
+        UINT64 GetMissCount() const { return mMissCount; }
+
+    private: // Private Structs
+        using Identifier = std::array<BYTE, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES>;
+
+        struct PipelineScope
+        {
+            /// @brief The identifiers that were queried from the pipeline, because none of its parents had them.
+            std::unordered_map<std::wstring, Identifier> Identifiers = {};
+
+            /// @brief The scope of the pipeline this one was expanded from, or null.
+            std::shared_ptr<PipelineScope> Parent = nullptr;
+        };
+
+        struct DestructionContext
+        {
+            ShaderIdentifierCache* pCache;
+            ID3D12StateObject* pPipeline;
+        };
+
+        struct TrackedPipeline
+        {
+            /// @brief The identifiers of the pipeline, shared with the pipelines expanded from it.
+            std::shared_ptr<PipelineScope> Scope = nullptr;
+
+            /// @brief The destruction callback, null if the pipeline doesn't support destruction notifications.
+            std::unique_ptr<DestructionContext> Context = nullptr;
+            UINT CallbackId = 0;
+        };
+
+    private: // Internal methods
+        /// @brief Track a pipeline, mMutex must be held.
+        /// @param pipeline The pipeline.
+        /// @param parent The scope of the pipeline it was expanded from, or null.
+        TrackedPipeline& InternalTrackPipeline(ID3D12StateObject* pipeline, std::shared_ptr<PipelineScope> parent);
+
+        /// @brief Get a tracked pipeline, tracking it on its own if it is not, mMutex must be held.
+        TrackedPipeline& InternalGetPipeline(ID3D12StateObject* pipeline);
+
+        /// @brief Forget a pipeline, mMutex must be held.
+        void InternalUntrackPipeline(ID3D12StateObject* pipeline, bool unregisterCallback);
+
+        static void __stdcall OnPipelineDestroyed(void* pData);
+
+    private: // Members
+        std::mutex mMutex;
+
+        std::unordered_map<ID3D12StateObject*, TrackedPipeline> mPipelines = {};
+
+        std::atomic<UINT64> mHitCount = 0;
+        std::atomic<UINT64> mMissCount = 0;
+    };
+
+} // namespace DXR
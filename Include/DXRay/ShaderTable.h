@@ -2,6 +2,8 @@
 
 #include "DXRay/Common.h"
 
+#include <functional>
+
 namespace DXR
 {
     /// @brief The type of shader in the shader table.
@@ -17,27 +19,178 @@ namespace DXR
         Callable
     };
 
+    /// @brief The number of shader types, which is also the number of sections in a shader table.
+    constexpr UINT32 ShaderTypeCount = 4;
+
+    /// @brief A compact reference to a shader record in a shader table, which encodes the type of the shader in the
+    /// upper 2 bits and its index in the section of that type in the lower 30 bits. Resolving a handle to a record is
+    /// a multiply-add, unlike a lookup by name which hashes a wide string.
+    struct ShaderRecordHandle
+    {
+    public: // Methods
+        /// @brief Create a handle from a type and an index.
+        static ShaderRecordHandle Create(ShaderType type, UINT32 index)
+        {
+            DXR_ASSERT(index <= IndexMask, "Shader index does not fit in a shader record handle.");
+            return ShaderRecordHandle {(static_cast<UINT32>(type) << TypeShift) | index};
+        }
+
+        /// @brief Get the type of the shader.
+        ShaderType GetType() const { return static_cast<ShaderType>(Value >> TypeShift); }
+
+        /// @brief Get the index of the shader in the section of its type.
+        UINT32 GetIndex() const { return Value & IndexMask; }
+
+        /// @brief Check if the handle refers to a shader.
+        bool IsValid() const { return Value != UINT32_MAX; }
+
+    public: // Members
+        /// @brief The encoded type and index.
+        UINT32 Value = UINT32_MAX;
+
+        static constexpr UINT32 TypeShift = 30;
+        static constexpr UINT32 IndexMask = (1u << TypeShift) - 1;
+    };
+
+    /// @brief The versions of a buffer that is written through a CPU copy and read by the GPU from one of several
+    /// copies, laid out one after the other. A version is only overwritten once the fence value it was submitted with
+    /// has completed. ShaderTable::SetVersionCount(...) uses it, it doesn't need a device on its own.
+    class ShaderTableVersions
+    {
+    public: // Structs
+        /// @brief A range of bytes of the buffer that was modified.
+        struct Range
+        {
+            UINT64 Begin;
+            UINT64 End;
+        };
+
+    public: // Methods
+        /// @brief Set the number of versions, 0 if the buffer isn't versioned. Their storage has to be set again.
+        void Reset(UINT32 numVersions)
+        {
+            mVersions.assign(numVersions, {});
+            mCurrent = 0;
+            mData = nullptr;
+            mVersionSize = 0;
+        }
+
+        /// @brief Set the memory of the versions, e.g. after the buffer was allocated. No version is in use anymore
+        /// and all of them are filled on their next commit.
+        /// @param pData The first version, the others follow every versionSize bytes.
+        /// @param versionSize The size of the buffer and of each version.
+        void SetStorage(CHAR* pData, UINT64 versionSize)
+        {
+            for (auto& version : mVersions) { version = {}; }
+            mCurrent = 0;
+            mData = pData;
+            mVersionSize = versionSize;
+        }
+
+        /// @brief Copy the modified ranges of the CPU copy to the version of a frame, which becomes the current one.
+        /// Ranges that were modified since the version was last committed are copied too, the rest of it is already
+        /// up to date.
+        /// @param frameIndex The index of the frame, the version used is frameIndex % GetCount().
+        /// @param completedFenceValue The completed value of the fence passed to Submit(...).
+        /// @param pSource The CPU copy of the buffer.
+        /// @param dirtyRanges The ranges modified since the last commit, cleared if the version is committed.
+        /// @return False if the GPU may still be reading the version, in which case nothing is committed.
+        bool Commit(UINT64 frameIndex, UINT64 completedFenceValue, const CHAR* pSource,
+                    std::vector<Range>& dirtyRanges);
+
+        /// @brief Tag the current version with a fence value, it is not modified until the fence has completed it.
+        void Submit(UINT64 fenceValue)
+        {
+            DXR_ASSERT(!mVersions.empty(), "Buffer is not versioned.");
+            mVersions[mCurrent].FenceValue = fenceValue;
+        }
+
+        /// @brief Get the number of versions, 0 if the buffer isn't versioned.
+        UINT32 GetCount() const { return static_cast<UINT32>(mVersions.size()); }
+
+        /// @brief Get the version that was committed last.
+        UINT32 GetCurrent() const { return mCurrent; }
+
+        /// @brief Get the offset of the current version from the first one.
+        UINT64 GetCurrentOffset() const { return mCurrent * mVersionSize; }
+
+    private: // Private Structs
+        struct Version
+        {
+            /// @brief The fence value after which the GPU no longer reads the version.
+            UINT64 FenceValue = 0;
+
+            /// @brief The ranges that were modified since the version was last committed.
+            std::vector<Range> PendingRanges = {};
+            UINT64 PendingSize = 0;
+
+            /// @brief Whether the whole version has to be copied, e.g. after the buffer was allocated.
+            bool NeedsFullCopy = true;
+        };
+
+    private: // Members
+        std::vector<Version> mVersions = {};
+        UINT32 mCurrent = 0;
+        CHAR* mData = nullptr;
+        UINT64 mVersionSize = 0;
+    };
+
     struct ShaderTable
     {
     public: // Methods
-        /// @brief Add a shader to the shader table.
+        /// @brief Add a shader to the shader table. The shader gets the next index of its type, so shaders of a type
+        /// are laid out in the order they are added. Shaders added after the table is built are written by
+        /// Device::UpdateShaderTable(...), into the reserved space if there is any.
         /// @param name The unique name of the shader. In case it is a HitGroup shader, the name should be the name of
         /// the hit group. When building the shader table, this name will be used to get the shader identifier from the
         /// pipeline.
-        void AddShader(const std::wstring& name, ShaderType type)
+        /// @return The handle of the shader record, which can be used to set the record data without a name lookup.
+        ShaderRecordHandle AddShader(const std::wstring& name, ShaderType type)
         {
             DXR_ASSERT(mShaders.find(name) == mShaders.end(), "Shader already exists in shader table.");
-            // Shader will have a entry assigned when the shader table is built.
-            mShaders.emplace(name, ShaderTableEntry {0, type});
 
-            switch (type)
+            mShaders.emplace(name, ShaderTableEntry {GetSection(type).NumShaders, type});
+
+            return AddShaderRecord(name, type);
+        }
+
+        /// @brief Add a record for a shader without registering its name, so the same shader can have many records
+        /// with different local root arguments, e.g. one hit group record per material. The record can only be
+        /// addressed with the returned handle.
+        /// @param name The name of the shader or hit group in the pipeline, which doesn't have to be unique.
+        /// @return The handle of the shader record.
+        ShaderRecordHandle AddShaderRecord(const std::wstring& name, ShaderType type)
+        {
+            auto& section = GetSection(type);
+
+            // Shader gets the next slot of its section, its identifier is written when the shader table is built.
+            section.Names.push_back(name);
+            section.NumShaders++;
+
+            // Use up reserved space first, so the shader table doesn't need to grow
+            if (section.NumReserved > 0)
+                section.NumReserved--;
+
+            if (mBuilt)
             {
-            case ShaderType::RayGen: mNumRayGenShaders++; break;
-            case ShaderType::Miss: mNumMissShaders++; break;
-            case ShaderType::HitGroup: mNumHitGroupShaders++; break;
-            case ShaderType::Callable: mNumCallableShaders++; break;
-            default: DXR_ASSERT(false, "Invalid shader type."); break;
+                mNewShadersAdded = true;
+                mNeedsReallocation |= section.NumShaders > section.Capacity;
             }
+
+            return ShaderRecordHandle::Create(type, section.NumShaders - 1);
+        }
+
+        /// @brief Get the handle of a shader by its name. Meant for setup code, keep the handle around instead of
+        /// looking it up every frame.
+        /// @param name The name of the shader.
+        /// @return The handle of the shader, invalid if there is no shader with that name.
+        ShaderRecordHandle GetShaderRecordHandle(const std::wstring& name) const
+        {
+            auto shader = mShaders.find(name);
+            if (shader == mShaders.end())
+                return ShaderRecordHandle {};
+
+            return ShaderRecordHandle::Create(shader->second.Type, shader->second.Index);
         }
 
         /// @brief Reserves space for new shaders so that new allocations arent made in the hash map when adding new
@@ -51,14 +204,11 @@ namespace DXR
         /// @note If called multiple times, it will increment the number of shaders to reserve space for.
         void ReserveSpaceForShaders(UINT32 num, ShaderType type)
         {
-            switch (type)
-            {
-            case ShaderType::RayGen: mNumRayGenShaders += num; break;
-            case ShaderType::Miss: mNumMissShaders += num; break;
-            case ShaderType::HitGroup: mNumHitGroupShaders += num; break;
-            case ShaderType::Callable: mNumCallableShaders += num; break;
-            default: DXR_ASSERT(false, "Invalid shader type."); break;
-            }
+            auto& section = GetSection(type);
+            section.NumReserved += num;
+
+            if (mBuilt)
+                mNeedsReallocation |= section.NumShaders + section.NumReserved > section.Capacity;
         }
 
         /// @brief Get the D3D12_DISPATCH_RAYS_DESC for the shader table.
@@ -74,21 +224,100 @@ namespace DXR
             mDispatchDesc.Depth = depth;
 
             mDispatchDesc.RayGenerationShaderRecord.StartAddress =
-                mShaderTableGPUAddress + (rgen * mRayGenShaderRecordSize);
+                mShaderTableGPUAddress + (rgen * GetSection(ShaderType::RayGen).RecordSize);
 
             return mDispatchDesc;
         }
 
+        /// @brief Get the number of bytes the shader table needs for its shaders and the reserved space, which is the
+        /// size of a buffer Device::CreateShaderTable(...) allocates.
+        UINT64 GetRequiredSize() const;
+
+        /// @brief Build the shader table in CPU-visible memory the caller manages, e.g. a range of an upload buffer it
+        /// already has, instead of a buffer allocated by Device::CreateShaderTable(...). Records are written to the
+        /// memory directly, like to an UPLOAD heap.
+        /// @param pData The mapped memory, GetRequiredSize() bytes aligned to
+        /// D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT.
+        /// @param address The GPU virtual address of the memory.
+        /// @param getIdentifiers Writes the identifiers of the named shaders one after the other, e.g. with
+        /// ShaderIdentifierCache::GetShaderIdentifiers(...).
+        /// @note The table can't be versioned. Shaders added later need another BuildInPlace(...), with memory of the
+        /// new size, Device::UpdateShaderTable(...) doesn't know about the memory.
+        void BuildInPlace(CHAR* pData, D3D12_GPU_VIRTUAL_ADDRESS address,
+                          const std::function<void(std::span<const std::wstring>, BYTE*)>& getIdentifiers);
+
         /// @brief Get the allocation for the shader table.
         /// @return The allocation for the shader table.
         ComPtr<DMA::Allocation> GetShaderTableAllocation() const { return mShaderTable; }
 
+        /// @brief Check if shaders have been added since the shader table was last built or updated.
+        bool HasNewShaders() const { return mNewShadersAdded; }
+
+        /// @brief Check if updating the shader table needs a larger buffer.
+        bool NeedsReallocation() const { return mNeedsReallocation; }
+
+        /// @brief Check if the shader table lives in a DEFAULT heap, in which case records are written to a CPU copy
+        /// and Device::UploadShaderTable(...) has to be called before dispatching rays.
+        bool IsInDefaultHeap() const { return mHeapType == D3D12_HEAP_TYPE_DEFAULT; }
+
+        /// @brief Check if records have been modified since the last Device::UploadShaderTable(...) or
+        /// CommitVersion(...).
+        bool HasPendingUploads() const { return !mDirtyRanges.empty(); }
+
+        /// @brief Keep multiple versions of a shader table in an UPLOAD or GPU_UPLOAD heap, so records can be modified
+        /// while the GPU is still reading an older version. Records are written to a CPU copy and become visible to
+        /// the GPU with CommitVersion(...). Must be called before the shader table is built.
+        /// @param numVersions The number of versions, usually the number of frames in flight.
+        void SetVersionCount(UINT32 numVersions)
+        {
+            DXR_ASSERT(!mBuilt, "Shader table is already built. Cannot modify version count.");
+            DXR_ASSERT(numVersions > 0, "Shader table needs at least one version.");
+
+            mVersions.Reset(numVersions == 1 ? 0 : numVersions);
+        }
+
+        /// @brief Get the number of versions of the shader table, 1 if it isn't versioned.
+        UINT32 GetVersionCount() const { return std::max<UINT32>(mVersions.GetCount(), 1); }
+
+        /// @brief Make the records written since the last commit visible in the version of a frame, which becomes the
+        /// version used by GetRaysDesc(...). Ranges that were modified since the version was last committed are
+        /// copied from the CPU copy, the rest of it is already up to date.
+        /// @param frameIndex The index of the frame, the version used is frameIndex % GetVersionCount().
+        /// @param completedFenceValue The completed value of the fence passed to SubmitVersion(...).
+        /// @return False if the GPU may still be reading the version, in which case nothing is committed.
+        bool CommitVersion(UINT64 frameIndex, UINT64 completedFenceValue);
+
+        /// @brief Make the records written since the last commit visible in the version of a frame.
+        bool CommitVersion(UINT64 frameIndex, ID3D12Fence* fence)
+        {
+            return CommitVersion(frameIndex, fence->GetCompletedValue());
+        }
+
+        /// @brief Tag the current version with a fence value, it is not modified until the fence has completed it.
+        /// @param fenceValue The value the fence will be signaled with after the dispatches that use the version.
+        void SubmitVersion(UINT64 fenceValue) { mVersions.Submit(fenceValue); }
+
+        /// @brief Tag the upload buffers used by Device::UploadShaderTable(...) since the last call with a fence value,
+        /// they are not reused until the fence has completed it.
+        /// @param fenceValue The value the fence will be signaled with after the command lists of the uploads.
+        void SubmitUpload(UINT64 fenceValue)
+        {
+            for (auto& slot : mUploadSlots)
+            {
+                if (slot.FenceValue == UnsubmittedFenceValue)
+                    slot.FenceValue = fenceValue;
+            }
+        }
+
+        /// @brief Get the version used by GetRaysDesc(...).
+        UINT32 GetCurrentVersion() const { return mVersions.GetCurrent(); }
+
         /// @brief Set the size of the shader records, including the shader identifier, which is
         /// D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES.
         /// @param size The size of the shader records.
         void SetShaderRecordSize(UINT64 size, ShaderType type)
         {
-            DXR_ASSERT(mShaderTable != nullptr, "Shader table is already built. Cannot modify shader record size.");
+            DXR_ASSERT(!mBuilt, "Shader table is already built. Cannot modify shader record size.");
             DXR_ASSERT(size <= D3D12_RAYTRACING_MAX_SHADER_RECORD_STRIDE, "Shader record size is too large.");
 
             switch (type)
@@ -97,16 +326,12 @@ namespace DXR
                 // Ray gen shaders are aligned to D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT, because there are only
                 // one per
                 // shader table.
-                mRayGenShaderRecordSize = DXR_ALIGN(size, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+                GetSection(type).RecordSize = DXR_ALIGN(size, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
                 break;
             case ShaderType::Miss:
-                mMissShaderRecordSize = DXR_ALIGN(size, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
-                break;
             case ShaderType::HitGroup:
-                mHitGroupRecordSize = DXR_ALIGN(size, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
-                break;
             case ShaderType::Callable:
-                mCallableRecordSize = DXR_ALIGN(size, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
+                GetSection(type).RecordSize = DXR_ALIGN(size, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
                 break;
 
             default: DXR_ASSERT(false, "Invalid shader type."); break;
@@ -118,48 +343,51 @@ namespace DXR
         /// @param data The data to set for the local root arguments.
         /// @param size The size of the data to set.
         /// @param offset The offset to set the data at.
+        /// @note This looks up the shader by name, prefer the overload that takes a ShaderRecordHandle when updating
+        /// many records every frame.
         void SetShaderRecordData(const std::wstring& name, const void* data, UINT32 size, UINT32 offset = 0)
         {
-            DXR_ASSERT(mShaderTable != nullptr, "Shader table must be built before setting shader record data.");
-
             auto shader = mShaders.find(name);
 
             DXR_ASSERT(shader != mShaders.end(), "Shader does not exist in shader table.");
 
-            auto& entry = shader->second;
+            SetShaderRecordData(ShaderRecordHandle::Create(shader->second.Type, shader->second.Index), data, size,
+                                offset);
+        }
 
-            CHAR* ptr = nullptr;
+        /// @brief Set the data for local root arguments for a shader in the shader table.
+        /// @param handle The handle of the shader returned by AddShader(...).
+        /// @param data The data to set for the local root arguments.
+        /// @param size The size of the data to set.
+        /// @param offset The offset to set the data at.
+        void SetShaderRecordData(ShaderRecordHandle handle, const void* data, UINT32 size, UINT32 offset = 0)
+        {
+            DXR_ASSERT(mBuilt, "Shader table must be built before setting shader record data.");
 
-            switch (entry.Type)
-            {
-            case ShaderType::RayGen:
-            {
-                ptr = mRayGenStartPtr + (entry.Index * mRayGenShaderRecordSize);
-                break;
-            }
-            case ShaderType::Miss:
-            {
-                ptr = mMissStartPtr + (entry.Index * mMissShaderRecordSize);
-                break;
-            }
-            case ShaderType::HitGroup:
-            {
-                ptr = mHitGroupStartPtr + (entry.Index * mHitGroupRecordSize);
-                break;
-            }
-            case ShaderType::Callable:
-            {
-                ptr = mCallableStartPtr + (entry.Index * mCallableRecordSize);
-                break;
-            }
-            default: DXR_ASSERT(false, "Invalid shader type."); break;
-            }
+            auto& section = mSections[handle.Value >> ShaderRecordHandle::TypeShift];
+            UINT32 index = handle.GetIndex();
+
+            DXR_ASSERT(index < section.NumBuilt, "Shader has been added but the shader table was not updated.");
+
+            UINT64 recordOffset = (index * section.RecordSize) + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + offset;
 
             // Add the shader identifier to the start of the shader record, because that should always be there.
-            ptr += D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + offset;
-            memcpy(ptr, data, size);
+            memcpy(section.StartPtr + recordOffset, data, size);
+            MarkDirty(section.Offset + recordOffset, size);
         }
 
+        /// @brief Write a range of consecutive shader records of one type in a single pass. Every record is written
+        /// whole, shader identifier included, in ascending address order, so the write-combined memory of UPLOAD and
+        /// GPU_UPLOAD heaps only sees full cache lines instead of scattered partial writes.
+        /// @param first The handle of the first shader of the range.
+        /// @param count The number of shaders in the range, all of the same type as the first one.
+        /// @param data The local root arguments of the shaders, one block per shader.
+        /// @param size The size of the local root arguments of one shader.
+        /// @param stride The distance between the blocks in data, 0 if they are tightly packed.
+        /// @note Bytes of a record past the local root arguments are zeroed.
+        void WriteShaderRecords(ShaderRecordHandle first, UINT32 count, const void* data, UINT32 size,
+                                UINT32 stride = 0);
+
     private: // Private Structs
         struct ShaderTableEntry
         {
@@ -170,46 +398,126 @@ namespace DXR
             ShaderType Type;
         };
 
+        /// @brief The records of one shader type, which are laid out next to each other in the shader table.
+        struct ShaderSection
+        {
+            /// @brief The pointer to the first record.
+            CHAR* StartPtr = nullptr;
+
+            /// @brief The offset of the first record in the shader table.
+            UINT64 Offset = 0;
+
+            /// @brief The size of the records, including the shader identifier.
+            UINT64 RecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+
+            /// @brief The number of shaders that have been added.
+            UINT32 NumShaders = 0;
+
+            /// @brief The number of records reserved for shaders that are not added yet.
+            UINT32 NumReserved = 0;
+
+            /// @brief The number of shaders whose identifier has been written.
+            UINT32 NumBuilt = 0;
+
+            /// @brief The number of records the shader table has space for.
+            UINT32 Capacity = 0;
+
+            /// @brief The names of the shaders, indexed by their index in the section.
+            std::vector<std::wstring> Names = {};
+
+            /// @brief A CPU copy of the shader identifiers, so whole records can be written without reading back
+            /// from the shader table.
+            std::vector<BYTE> Identifiers = {};
+        };
+
+        /// @brief A range of bytes of the shader table that has to be copied to the DEFAULT heap or to a version.
+        using DirtyRange = ShaderTableVersions::Range;
+
+        /// @brief An upload buffer of a shader table in a DEFAULT heap.
+        struct UploadSlot
+        {
+            ComPtr<DMA::Allocation> Buffer = nullptr;
+            CHAR* pData = nullptr;
+
+            /// @brief The fence value after which the GPU no longer reads the buffer, UnsubmittedFenceValue from the
+            /// upload until SubmitUpload(...).
+            UINT64 FenceValue = 0;
+        };
+
+    private: // Internal methods
+        /// @brief Fill the dispatch description with the sections at mShaderTableGPUAddress.
+        void UpdateDispatchDesc();
+
+        /// @brief Lay the sections out one after the other with their capacity.
+        /// @return The size of the shader table.
+        UINT64 InternalLayoutSections();
+
+        /// @brief Point the sections at the memory of the shader table.
+        void InternalSetMemory(CHAR* pData, D3D12_GPU_VIRTUAL_ADDRESS address, UINT64 size);
+
+        /// @brief Write the identifiers of the shaders that were added since the last build.
+        void InternalWriteShaderIdentifiers(
+            const std::function<void(std::span<const std::wstring>, BYTE*)>& getIdentifiers);
+
+        ShaderSection& GetSection(ShaderType type) { return mSections[static_cast<UINT32>(type)]; }
+        const ShaderSection& GetSection(ShaderType type) const { return mSections[static_cast<UINT32>(type)]; }
+
+        /// @brief Check if records are written to a CPU copy instead of the shader table itself.
+        bool UsesStaging() const { return mHeapType == D3D12_HEAP_TYPE_DEFAULT || mVersions.GetCount() > 0; }
+
+        /// @brief Remember a modified range of the shader table, only needed when records are written to a CPU copy.
+        void MarkDirty(UINT64 offset, UINT64 size)
+        {
+            if (!UsesStaging() || size == 0)
+                return;
+
+            // Records are usually written in order, so extending the last range keeps the list short
+            if (!mDirtyRanges.empty() && mDirtyRanges.back().End == offset)
+                mDirtyRanges.back().End = offset + size;
+            else
+                mDirtyRanges.push_back({offset, offset + size});
+        }
+
     private: // Members
+        /// @brief The fence value of an upload slot that is used by an upload that has not been submitted yet.
+        static constexpr UINT64 UnsubmittedFenceValue = UINT64_MAX;
+
         // The buffer resource for the shader table.
         ComPtr<DMA::Allocation> mShaderTable;
         UINT64 mShaderTableGPUAddress = 0;
+        UINT64 mShaderTableSize = 0;
+
+        // When the shader table is in a DEFAULT heap, records are written to a CPU copy and modified ranges are
+        // copied through upload buffers. A buffer is only reused once the fence it was tagged with has completed, when
+        // all of them are in flight another one is added, so writing never waits on a copy the GPU is doing.
+        std::vector<CHAR> mStaging = {};
+        std::vector<DirtyRange> mDirtyRanges = {};
+        std::vector<UploadSlot> mUploadSlots = {};
+        D3D12_RESOURCE_STATES mShaderTableState = D3D12_RESOURCE_STATE_COMMON;
 
-        // The pointer to the start of each shader table.
-        CHAR* mRayGenStartPtr = nullptr;
-        CHAR* mMissStartPtr = nullptr;
-        CHAR* mHitGroupStartPtr = nullptr;
-        CHAR* mCallableStartPtr = nullptr;
+        // The versions of a versioned shader table, which are laid out one after the other in mShaderTable.
+        // mShaderTableGPUAddress points to the current version.
+        ShaderTableVersions mVersions = {};
+        D3D12_GPU_VIRTUAL_ADDRESS mShaderTableBaseAddress = 0;
 
-        // The size of the records for each shader type.
-        UINT64 mRayGenShaderRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
-        UINT64 mMissShaderRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
-        UINT64 mHitGroupRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
-        UINT64 mCallableRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+        // The heap the shader table was created in, used when it has to grow.
+        D3D12_HEAP_TYPE mHeapType = D3D12_HEAP_TYPE_UPLOAD;
+
+        // The sections of the shader table, indexed by ShaderType, in the order they are laid out.
+        ShaderSection mSections[ShaderTypeCount] = {};
 
         // The names of the shaders in the shader table.
         // Map 1-1 with the shader table.
 
         std::unordered_map<std::wstring, ShaderTableEntry> mShaders;
 
+        // Whether the shader table has memory, allocated by the device or given to BuildInPlace(...).
+        bool mBuilt = false;
+
         // Whether or not the shader table needs to be rebuilt.
         bool mNeedsReallocation = true;
         bool mNewShadersAdded = false;
 
-        // How many shaders have been built into the shader table.
-
-        UINT32 mRayGenShadersBuilt = 0;
-        UINT32 mMissShadersBuilt = 0;
-        UINT32 mHitGroupShadersBuilt = 0;
-        UINT32 mCallableShadersBuilt = 0;
-
-        // How much shaders are in the shader table.
-
-        UINT32 mNumRayGenShaders = 0;
-        UINT32 mNumMissShaders = 0;
-        UINT32 mNumHitGroupShaders = 0;
-        UINT32 mNumCallableShaders = 0;
-
         D3D12_DISPATCH_RAYS_DESC mDispatchDesc = {};
 
         friend class Device;
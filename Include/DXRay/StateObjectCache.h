@@ -0,0 +1,156 @@
+#pragma once
+
+#include "DXRay/Common.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+
+namespace DXR
+{
+    /// @brief Serialize the contents of a state object description into a canonical form, so that descriptions which
+    /// create the same state object get the same signature. The order of subobjects and of exports doesn't matter.
+    /// DXIL libraries are described by the digest of their container, or by their bytes if it has none. Root
+    /// signatures and existing collections are described by their address.
+    /// @param desc The description to serialize.
+    /// @param signature Receives the signature.
+    /// @param pReferences If not null, receives the objects the description refers to by address. Keep them alive as
+    /// long as the signature is used, so their address can't be reused by another object.
+    /// @return False if the description has subobjects that can't be serialized.
+    bool GetStateObjectSignature(const D3D12_STATE_OBJECT_DESC& desc, std::vector<BYTE>& signature,
+                                 std::vector<ComPtr<IUnknown>>* pReferences = nullptr);
+
+    /// @brief Hash the contents of a state object description, which is the hash of its GetStateObjectSignature(...).
+    /// Different descriptions can have the same hash, compare their signatures to tell them apart.
+    /// @param desc The description to hash.
+    /// @param pReferences If not null, receives the objects the description refers to by address. Keep them alive as
+    /// long as the hash is used, so their address can't be reused by another object.
+    /// @return The hash, or 0 if the description has subobjects that can't be hashed.
+    UINT64 HashStateObjectDesc(const D3D12_STATE_OBJECT_DESC& desc,
+                               std::vector<ComPtr<IUnknown>>* pReferences = nullptr);
+
+    /// @brief The statistics of a StateObjectCache.
+    struct StateObjectCacheStats
+    {
+    public: // Methods
+        /// @brief Get the fraction of requests that didn't have to be compiled.
+        float GetHitRate() const
+        {
+            UINT64 total = Hits + Misses;
+            return total == 0 ? 0.0f : static_cast<float>(Hits) / static_cast<float>(total);
+        }
+
+    public: // Members
+        /// @brief The number of requests that were served from the cache, including the ones that waited.
+        UINT64 Hits = 0;
+
+        /// @brief The number of hits that waited for another thread to finish compiling the state object.
+        UINT64 InFlightHits = 0;
+
+        /// @brief The number of requests that were compiled.
+        UINT64 Misses = 0;
+
+        /// @brief The number of requests that couldn't be hashed and were compiled without the cache.
+        UINT64 Uncacheable = 0;
+
+        /// @brief The number of state objects that were evicted to make room for new ones.
+        UINT64 Evictions = 0;
+    };
+
+    /// @brief A thread-safe cache of state objects by the signature of their description, so identical pipelines
+    /// requested by different parts of an application are compiled once. When multiple threads request the same state
+    /// object while it is being compiled, they all wait for the one compilation instead of starting their own.
+    ///
+    /// The cache is disabled until it is given a capacity, see SetCapacity(...). A cached state object and the
+    /// objects its description refers to stay alive until the entry is evicted or the cache is cleared, even if the
+    /// application released them.
+    class StateObjectCache
+    {
+    public:
+        StateObjectCache() = default;
+
+        // Delete copy/move constructors and assignment operators
+
+        StateObjectCache(StateObjectCache const&) = delete;
+        StateObjectCache(StateObjectCache&&) = delete;
+        StateObjectCache& operator=(StateObjectCache const&) = delete;
+        StateObjectCache& operator=(StateObjectCache&&) = delete;
+
+    public: // Methods
+        /// @brief Get a state object from the cache, or create it if there is none for the description.
+        /// @param desc The description of the state object.
+        /// @param parent The state object that is expanded by the description, or null if it creates a new one.
+        /// @param create Creates the state object, called at most once per description while it is cached.
+        /// @return The state object.
+        ComPtr<ID3D12StateObject> GetOrCreate(const D3D12_STATE_OBJECT_DESC& desc, ID3D12StateObject* parent,
+                                              const std::function<ComPtr<ID3D12StateObject>()>& create);
+
+        /// @brief Set the largest number of cached state objects. When a new one doesn't fit, the least recently
+        /// used state object that has finished compiling is evicted.
+        /// @param capacity The number of state objects, 0 disables the cache and releases all cached state objects.
+        void SetCapacity(size_t capacity);
+
+        /// @brief Get the largest number of cached state objects, 0 if the cache is disabled.
+        size_t GetCapacity() const { return mCapacity.load(); }
+
+        /// @brief Release all cached state objects. State objects that are being compiled are still returned to the
+        /// threads that wait for them.
+        void Clear();
+
+        /// @brief Get the number of cached state objects.
+        size_t GetSize();
+
+        /// @brief Get the statistics of the cache.
+        StateObjectCacheStats GetStats() const
+        {
+            return {mHits.load(), mInFlightHits.load(), mMisses.load(), mUncacheable.load(), mEvictions.load()};
+        }
+
+    private: // Private Structs
+        struct Entry
+        {
+            /// @brief The state object, ready once the compilation has finished.
+            std::shared_future<ComPtr<ID3D12StateObject>> StateObject = {};
+
+            /// @brief The signature of the description and the expanded state object, compared on lookup since
+            /// different descriptions can have the same hash.
+            std::vector<BYTE> Signature = {};
+
+            /// @brief The objects the description refers to by address, kept alive so the signature stays unique.
+            std::vector<ComPtr<IUnknown>> References = {};
+
+            /// @brief Identifies the entry, so the thread compiling it only erases its own entry.
+            UINT64 Id = 0;
+
+            /// @brief When the entry was last requested, to evict the least recently used one.
+            UINT64 LastUse = 0;
+        };
+
+    private: // Internal methods
+        /// @brief Erase an entry if it is still cached. Called with the mutex held.
+        /// @param hash The hash of the entry.
+        /// @param id The id of the entry.
+        /// @param erased Receives the erased entry, so it is released after the mutex is unlocked.
+        void Erase(UINT64 hash, UINT64 id, Entry& erased);
+
+        /// @brief Evict the least recently used entries that are ready until there are at most capacity entries.
+        /// Called with the mutex held.
+        /// @param capacity The number of entries to keep.
+        /// @param evicted Receives the evicted entries, so they are released after the mutex is unlocked.
+        void Evict(size_t capacity, std::vector<Entry>& evicted);
+
+    private: // Members
+        std::mutex mMutex;
+        std::unordered_multimap<UINT64, Entry> mEntries = {};
+        std::atomic<size_t> mCapacity = 0;
+        UINT64 mUseCounter = 0;
+
+        std::atomic<UINT64> mHits = 0;
+        std::atomic<UINT64> mInFlightHits = 0;
+        std::atomic<UINT64> mMisses = 0;
+        std::atomic<UINT64> mUncacheable = 0;
+        std::atomic<UINT64> mEvictions = 0;
+    };
+
+} // namespace DXR
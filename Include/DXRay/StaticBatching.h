@@ -0,0 +1,152 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/AccelStruct.h"
+#include "DXRay/HitGroupTableBuilder.h"
+
+namespace DXR
+{
+    /// @brief A static mesh that would otherwise get its own BLAS and instance.
+    struct StaticMeshDesc
+    {
+        /// @brief The triangle geometry of the mesh, in object space.
+        D3D12_RAYTRACING_GEOMETRY_DESC Geometry = {};
+
+        /// @brief The CPU copy of Geometry.Triangles.Transform3x4, if the geometry has one, like
+        /// QuantizedMesh::Transform. Merged meshes fold it into their pre-transform. A geometry with a transform but
+        /// without this copy is never merged.
+        const XMFLOAT3X4* pGeometryTransform = nullptr;
+
+        /// @brief The object to world transform of the instance, a 3x4 row-major matrix like
+        /// D3D12_RAYTRACING_INSTANCE_DESC::Transform.
+        XMFLOAT3X4 Transform = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+
+        /// @brief The bounds of the mesh in object space, after the geometry transform.
+        XMFLOAT3 BoundsMin = {};
+        XMFLOAT3 BoundsMax = {};
+
+        /// @brief The instance mask and flags. Only meshes with the same mask and flags, whose transforms are either
+        /// all mirroring or all not, are merged.
+        UINT8 InstanceMask = 0xFF;
+        D3D12_RAYTRACING_INSTANCE_FLAGS InstanceFlags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+    };
+
+    /// @brief Which meshes BatchStaticMeshes(...) merges.
+    struct StaticBatchingOptions
+    {
+        /// @brief Meshes with more triangles keep their own BLAS, they don't have a build overhead worth saving.
+        UINT32 MaxMeshTriangles = 4096;
+
+        /// @brief The largest number of triangles and geometries of a merged BLAS.
+        UINT32 MaxBatchTriangles = 262144;
+        UINT32 MaxBatchGeometries = 256;
+
+        /// @brief The largest surface area of the bounds of a batch, relative to the summed surface area of the
+        /// bounds of its meshes. Rays that enter the batch bounds but miss every mesh are wasted traversal, so sparse
+        /// batches trace slower than separate instances would.
+        float MaxAreaRatio = 4.0f;
+    };
+
+    /// @brief The meshes of one BLAS and its instance.
+    struct StaticBatch
+    {
+    public: // Methods
+        /// @brief Check if the batch merges multiple meshes, otherwise it is a mesh kept as is.
+        bool IsMerged() const { return Meshes.size() > 1; }
+
+    public: // Members
+        /// @brief The input meshes, in geometry order. GeometryIndex() in shaders indexes this, InstanceID() and
+        /// InstanceIndex() are the same for all of them.
+        std::vector<UINT32> Meshes = {};
+
+        /// @brief The index of the pre-transform of the first mesh in StaticBatchingResult::GeometryTransforms, the
+        /// other meshes follow. UINT32_MAX if the batch is not merged.
+        UINT32 FirstTransform = UINT32_MAX;
+
+        /// @brief The transform of the instance. Merged batches are centered on their bounds, so their vertices stay
+        /// small and precise.
+        XMFLOAT3X4 Transform = {};
+
+        /// @brief The instance mask and flags of the meshes. Merged batches of meshes with mirroring transforms have
+        /// D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE toggled, the mirroring moved into their
+        /// pre-transforms, which flips the winding of their triangles.
+        UINT8 InstanceMask = 0xFF;
+        D3D12_RAYTRACING_INSTANCE_FLAGS InstanceFlags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+
+        /// @brief The number of triangles of the BLAS.
+        UINT64 TriangleCount = 0;
+    };
+
+    /// @brief How much batching saved.
+    struct StaticBatchingStats
+    {
+    public: // Methods
+        /// @brief Get the size the TLAS instance descriptions shrank by.
+        UINT64 GetSavedInstanceSize() const
+        {
+            return (InputInstances - OutputInstances) * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
+        }
+
+    public: // Members
+        /// @brief The number of instances before and after batching.
+        UINT64 InputInstances = 0;
+        UINT64 OutputInstances = 0;
+
+        /// @brief The number of BLAS builds before and after batching.
+        UINT64 InputBuildCalls = 0;
+        UINT64 OutputBuildCalls = 0;
+
+        /// @brief The number of meshes that were merged into shared BLASes, and the number of those BLASes.
+        UINT64 MergedMeshes = 0;
+        UINT64 MergedBatches = 0;
+    };
+
+    /// @brief The batches of a scene and what is needed to build them.
+    ///
+    /// Usage:
+    /// 1. Upload GeometryTransforms to a buffer, aligned to D3D12_RAYTRACING_TRANSFORM3X4_BYTE_ALIGNMENT.
+    /// 2. FillAccelerationStructureDesc(...) and build a BLAS per batch.
+    /// 3. AddHitGroupRecords(...) to get the hit group index of every batch.
+    /// 4. Add an instance per batch with its Transform, InstanceMask, InstanceFlags and hit group index.
+    struct StaticBatchingResult
+    {
+    public: // Methods
+        /// @brief Fill the geometries of the BLAS of a batch. Merged meshes get their pre-transform, the other fields
+        /// of the description are left as they are.
+        /// @param batch The index of the batch.
+        /// @param meshes The meshes passed to BatchStaticMeshes(...).
+        /// @param transforms The address of GeometryTransforms on the GPU.
+        /// @param desc The description to fill.
+        void FillAccelerationStructureDesc(UINT32 batch, std::span<const StaticMeshDesc> meshes,
+                                           D3D12_GPU_VIRTUAL_ADDRESS transforms,
+                                           AccelerationStructureDesc& desc) const;
+
+        /// @brief Add a record group per batch, with the records of its meshes in geometry order, so every mesh keeps
+        /// its shading. Shaders must trace with a MultiplierForGeometryContributionToHitGroupIndex of 1.
+        /// @param builder The builder to add the records to.
+        /// @param records The record of each mesh passed to BatchStaticMeshes(...).
+        /// @return The group of each batch, for HitGroupTableBuilder::GetHitGroupIndex(...) once built.
+        std::vector<UINT32> AddHitGroupRecords(HitGroupTableBuilder& builder,
+                                               std::span<const HitGroupRecordDesc> records) const;
+
+    public: // Members
+        /// @brief The batches, one BLAS and one instance each.
+        std::vector<StaticBatch> Batches = {};
+
+        /// @brief The pre-transforms of the meshes of merged batches, from object space to batch space.
+        std::vector<XMFLOAT3X4> GeometryTransforms = {};
+
+        /// @brief How much batching saved.
+        StaticBatchingStats Stats = {};
+    };
+
+    /// @brief Merge small static meshes into shared multi-geometry BLASes. Meshes are sorted along a Morton curve of
+    /// their world bounds and grown into batches greedily, a batch is closed when it would get too many triangles or
+    /// geometries, or its bounds would get too sparse, see StaticBatchingOptions.
+    /// @param meshes The meshes, each with one triangle geometry.
+    /// @param options Which meshes to merge.
+    /// @return The batches. Every mesh is in exactly one batch.
+    StaticBatchingResult BatchStaticMeshes(std::span<const StaticMeshDesc> meshes,
+                                           const StaticBatchingOptions& options = {});
+
+} // namespace DXR
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "DXRay/Common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace DXR
+{
+    /// @brief A small work-stealing thread pool. Every worker has its own queue and takes work from the queues of the
+    /// other workers when its own queue is empty, so uneven tasks still keep all workers busy. Threads that wait for
+    /// work, like the caller of ParallelFor(...), run queued tasks while waiting, so the pool can be used recursively.
+    class TaskPool
+    {
+    public:
+        /// @brief Create a task pool.
+        /// @param numThreads The number of worker threads. 0 uses one less than the number of hardware threads, since
+        /// the thread calling ParallelFor(...) works too.
+        explicit TaskPool(UINT32 numThreads = 0);
+        ~TaskPool();
+
+        // Delete copy/move constructors and assignment operators
+
+        TaskPool(TaskPool const&) = delete;
+        TaskPool(TaskPool&&) = delete;
+        TaskPool& operator=(TaskPool const&) = delete;
+        TaskPool& operator=(TaskPool&&) = delete;
+
+    public:
+        /// @brief Get the number of worker threads.
+        UINT32 GetThreadCount() const { return static_cast<UINT32>(mThreads.size()); }
+
+        /// @brief Run a function over a range in parallel and wait for it to finish.
+        /// @param count The size of the range [0, count).
+        /// @param grainSize The number of elements of one task. Chunks start at multiples of grainSize.
+        /// @param func The function to run, called with the [begin, end) range of a chunk.
+        /// @note If func throws, the chunks that haven't started are skipped and the first exception is rethrown on the
+        /// calling thread once all chunks are done.
+        void ParallelFor(UINT64 count, UINT64 grainSize, const std::function<void(UINT64, UINT64)>& func);
+
+        /// @brief Run a function on the pool.
+        /// @param func The function to run.
+        /// @return A future to the result of the function.
+        template <typename Func>
+        auto Submit(Func&& func) -> std::future<std::invoke_result_t<Func>>
+        {
+            using Result = std::invoke_result_t<Func>;
+
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+            std::future<Result> future = task->get_future();
+
+            Push([task]() { (*task)(); });
+
+            return future;
+        }
+
+        /// @brief Wait for a future, running queued tasks on the calling thread until it is ready.
+        /// @param future A future returned by Submit(...).
+        /// @return The result of the function.
+        template <typename Result>
+        Result Wait(std::future<Result>& future)
+        {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                if (!RunPendingTask())
+                    future.wait();
+            }
+            return future.get();
+        }
+
+        /// @brief Run a queued task on the calling thread, if there is one. Useful to help while waiting on a future.
+        /// @return Whether a task was run.
+        bool RunPendingTask() { return TryRunTask(mNextQueue.fetch_add(1, std::memory_order_relaxed)); }
+
+    private: // Internal methods
+        /// @brief Add a task to one of the worker queues.
+        void Push(std::function<void()> task);
+
+        /// @brief Run a task from the queue of a worker, or steal one from another worker.
+        /// @param home The queue to look at first.
+        /// @return Whether a task was run.
+        bool TryRunTask(UINT32 home);
+
+        /// @brief The main function of the worker threads.
+        void WorkerLoop(UINT32 index);
+
+    private: // Private Structs
+        struct WorkQueue
+        {
+            std::mutex Mutex;
+            std::deque<std::function<void()>> Tasks;
+        };
+
+    private: // Members
+        /// @brief One queue per worker, or a single queue if there are no workers.
+        std::vector<std::unique_ptr<WorkQueue>> mQueues = {};
+
+        /// @brief The worker threads.
+        std::vector<std::thread> mThreads = {};
+
+        /// @brief The number of queued tasks, used to put idle workers to sleep.
+        std::atomic<UINT64> mPendingTasks = 0;
+
+        /// @brief The queue the next task is pushed to.
+        std::atomic<UINT32> mNextQueue = 0;
+
+        /// @brief Wakes up idle workers.
+        std::mutex mWakeMutex;
+        std::condition_variable mWakeCondition;
+
+        /// @brief Tells the workers to exit.
+        bool mStop = false;
+    };
+
+} // namespace DXR
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "DXRay/Common.h"
+#include "DXRay/Device.h"
+
+#include <deque>
+
+namespace DXR
+{
+    /// @brief The bookkeeping of a ring buffer, without any memory attached. Allocations are made at the head and
+    /// freed at the tail once the GPU is done with them, which is tracked with fence values. Only works with offsets,
+    /// so it can be driven by a fake fence.
+    class RingAllocator
+    {
+    public:
+        /// @brief Create a ring allocator.
+        /// @param size The size of the ring in bytes.
+        explicit RingAllocator(UINT64 size) : mSize(size) {}
+
+    public:
+        /// @brief Allocate a chunk of the ring. Chunks never wrap around the end, the rest of the ring is skipped
+        /// instead.
+        /// @param size The size of the chunk.
+        /// @param alignment The alignment of the offset, must be a power of two.
+        /// @return The offset of the chunk, or UINT64_MAX if the ring is too full.
+        UINT64 Allocate(UINT64 size, UINT64 alignment);
+
+        /// @brief Tag all chunks allocated since the last call with a fence value. They are freed once the fence
+        /// has completed that value.
+        /// @param fenceValue The value the fence will be signaled with after the GPU is done with the chunks.
+        void Submit(UINT64 fenceValue);
+
+        /// @brief Free the chunks of all submissions whose fence value has completed.
+        /// @param completedFenceValue The completed value of the fence.
+        void Retire(UINT64 completedFenceValue);
+
+        /// @brief Get the size of the ring.
+        UINT64 GetSize() const { return mSize; }
+
+        /// @brief Get the number of bytes in use, including padding and skipped space at the end of the ring.
+        UINT64 GetUsedSize() const { return mUsed; }
+
+    private: // Private Structs
+        struct Submission
+        {
+            /// @brief The fence value that frees the submission.
+            UINT64 FenceValue;
+
+            /// @brief The number of bytes used by the submission.
+            UINT64 Size;
+        };
+
+    private: // Members
+        /// @brief The size of the ring.
+        UINT64 mSize = 0;
+
+        /// @brief The offset of the next allocation.
+        UINT64 mHead = 0;
+
+        /// @brief The number of bytes between tail and head.
+        UINT64 mUsed = 0;
+
+        /// @brief The number of bytes allocated since the last submission.
+        UINT64 mPendingSize = 0;
+
+        /// @brief The submissions that are in flight, oldest first.
+        std::deque<Submission> mSubmissions = {};
+    };
+
+    /// @brief A chunk of an upload ring.
+    struct UploadAllocation
+    {
+        /// @brief The CPU pointer to write to, null if the allocation failed.
+        void* pData = nullptr;
+
+        /// @brief The GPU virtual address of the chunk.
+        D3D12_GPU_VIRTUAL_ADDRESS GPUAddress = 0;
+
+        /// @brief The resource the chunk is part of, for copies.
+        ID3D12Resource* pResource = nullptr;
+
+        /// @brief The offset of the chunk in the resource.
+        UINT64 Offset = 0;
+
+        /// @brief The size of the chunk.
+        UINT64 Size = 0;
+    };
+
+    /// @brief A persistently mapped upload buffer that is sub-allocated as a ring, for data that is written every
+    /// frame like instance descriptions, AABBs and shader records. Memory is reused as soon as the GPU is done with
+    /// it, so there is no need for a buffer per frame in flight and no resource is created after construction.
+    class UploadRing
+    {
+    public:
+        /// @brief Create an upload ring.
+        /// @param device The device to allocate the buffer with.
+        /// @param size The size of the buffer, should fit the data of all frames in flight.
+        /// @param heapType The heap of the buffer, must be CPU accessible.
+        UploadRing(Device& device, UINT64 size, D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_UPLOAD);
+
+        // Delete copy/move constructors and assignment operators
+
+        UploadRing(UploadRing const&) = delete;
+        UploadRing(UploadRing&&) = delete;
+        UploadRing& operator=(UploadRing const&) = delete;
+        UploadRing& operator=(UploadRing&&) = delete;
+
+    public:
+        /// @brief Allocate a chunk of the ring.
+        /// @param size The size of the chunk.
+        /// @param alignment The alignment of the chunk, must be a power of two.
+        /// @return The chunk, with pData set to null if the ring is full.
+        UploadAllocation Allocate(UINT64 size, UINT64 alignment);
+
+        /// @brief Allocate space for instance descriptions of a top level acceleration structure.
+        UploadAllocation AllocateInstanceDescs(UINT32 numInstances)
+        {
+            return Allocate(numInstances * sizeof(D3D12_RAYTRACING_INSTANCE_DESC),
+                            D3D12_RAYTRACING_INSTANCE_DESCS_BYTE_ALIGNMENT);
+        }
+
+        /// @brief Allocate space for AABBs of procedural geometry.
+        UploadAllocation AllocateAABBs(UINT64 numAABBs)
+        {
+            return Allocate(numAABBs * sizeof(D3D12_RAYTRACING_AABB), D3D12_RAYTRACING_AABB_BYTE_ALIGNMENT);
+        }
+
+        /// @brief Allocate space for shader records, aligned so it can be used as a shader table.
+        UploadAllocation AllocateShaderRecords(UINT64 size)
+        {
+            return Allocate(size, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+        }
+
+        /// @brief Tag all chunks allocated since the last call with a fence value, call once per frame after
+        /// submitting the command lists that use them.
+        void Submit(UINT64 fenceValue) { mRing.Submit(fenceValue); }
+
+        /// @brief Free the chunks whose fence value has completed.
+        void Retire(UINT64 completedFenceValue) { mRing.Retire(completedFenceValue); }
+
+        /// @brief Free the chunks whose fence value has completed.
+        void Retire(ID3D12Fence* fence) { mRing.Retire(fence->GetCompletedValue()); }
+
+        /// @brief Get the number of bytes in use.
+        UINT64 GetUsedSize() const { return mRing.GetUsedSize(); }
+
+        /// @brief Get the buffer of the ring.
+        ComPtr<DMA::Allocation> GetAllocation() const { return mBuffer; }
+
+    private: // Members
+        /// @brief The bookkeeping of the ring.
+        RingAllocator mRing;
+
+        /// @brief The buffer of the ring.
+        ComPtr<DMA::Allocation> mBuffer = nullptr;
+
+        /// @brief The persistent mapping of the buffer.
+        CHAR* mData = nullptr;
+
+        /// @brief The GPU virtual address of the buffer.
+        D3D12_GPU_VIRTUAL_ADDRESS mGPUAddress = 0;
+    };
+
+} // namespace DXR
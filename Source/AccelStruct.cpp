@@ -16,24 +16,76 @@ namespace DXR
         return DXR_ALIGN(descs.GetScratchBufferSize(), D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
     }
 
-    ComPtr<DMA::Allocation> Device::AllocateAccelerationStructure(AccelerationStructureDesc& desc)
+    UINT64 Device::GetRequiredUpdateScratchBufferSize(AccelerationStructureDesc& desc)
+    {
+        return DXR_ALIGN(desc.GetUpdateScratchBufferSize(), D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+    }
+
+    ScratchPlan Device::PlanScratchBuffer(std::vector<AccelerationStructureDesc>& descs, UINT32 maxBatchSize)
+    {
+        std::vector<UINT64> sizes;
+        sizes.reserve(descs.size());
+
+        for (auto& desc : descs) { sizes.push_back(desc.GetScratchBufferSize()); }
+
+        return PlanScratchMemory(sizes, maxBatchSize);
+    }
+
+    const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO& Device::QueryPrebuildInfo(
+        AccelerationStructureDesc& desc)
     {
         if (desc.Geometries.size() > 0 || desc.pGeometries.size() > 0)
-            return InternalAllocateBottomAccelerationStructure(desc);
+            InternalFillBottomInputs(desc);
         else if (desc.vpInstanceDescs != 0)
-            return InternalAllocateTopAccelerationStructure(desc);
+            InternalFillTopInputs(desc);
         else
             DXR_THROW_FAILED(E_INVALIDARG);
 
-        return nullptr;
+        desc.PrebuildInfo = mPrebuildInfoCache.GetOrQuery(desc.BuildDesc.Inputs, [&](auto& info) {
+            mDevice->GetRaytracingAccelerationStructurePrebuildInfo(&desc.BuildDesc.Inputs, &info);
+        });
+
+        return desc.PrebuildInfo;
     }
 
-    ComPtr<DMA::Allocation> Device::InternalAllocateBottomAccelerationStructure(AccelerationStructureDesc& desc)
+    ComPtr<DMA::Allocation> Device::AllocateAccelerationStructure(AccelerationStructureDesc& desc)
     {
-        // Check if we have all required data for the function
-        DXR_ASSERT(desc.pGeometries.size() > 0 || desc.Geometries.size() > 0,
-                   "No geometries provided for bottom level acceleration structure");
+        QueryPrebuildInfo(desc);
+
+        // Allocate the buffer
+        D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(
+            desc.PrebuildInfo.ResultDataMaxSizeInBytes,
+            D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS | D3D12_RESOURCE_FLAG_RAYTRACING_ACCELERATION_STRUCTURE);
+
+        auto outAccel = AllocateResource(MemoryCategory::AccelerationStructure, resDesc,
+                                         D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+
+        desc.BuildDesc.DestAccelerationStructureData = outAccel->GetResource()->GetGPUVirtualAddress();
+        desc.DestSize = desc.PrebuildInfo.ResultDataMaxSizeInBytes;
+
+        // The new allocation has nothing to refit yet
+        desc.Policy.Reset();
+
+        return outAccel;
+    }
 
+    AccelStructHandle Device::AllocateAccelerationStructure(AccelerationStructureDesc& desc, AccelStructArena& arena)
+    {
+        QueryPrebuildInfo(desc);
+
+        AccelStructHandle handle = arena.Allocate(desc.PrebuildInfo.ResultDataMaxSizeInBytes);
+
+        desc.BuildDesc.DestAccelerationStructureData = handle.Address;
+        desc.DestSize = handle.Size;
+
+        // The new allocation has nothing to refit yet
+        desc.Policy.Reset();
+
+        return handle;
+    }
+
+    void Device::InternalFillBottomInputs(AccelerationStructureDesc& desc)
+    {
         // Check what kind of geometry we have
         bool ppGeoms = desc.pGeometries.size() > 0;
 
@@ -51,23 +103,9 @@ namespace DXR
             inputs.pGeometryDescs = desc.Geometries.data();
 
         inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
-
-        // Query the prebuild info
-        mDevice->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &desc.PrebuildInfo);
-
-        // Allocate the buffer
-        D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(
-            desc.PrebuildInfo.ResultDataMaxSizeInBytes,
-            D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS | D3D12_RESOURCE_FLAG_RAYTRACING_ACCELERATION_STRUCTURE);
-
-        auto outAccel = AllocateResource(resDesc, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
-
-        desc.BuildDesc.DestAccelerationStructureData = outAccel->GetResource()->GetGPUVirtualAddress();
-
-        return outAccel;
     }
 
-    ComPtr<DMA::Allocation> Device::InternalAllocateTopAccelerationStructure(AccelerationStructureDesc& desc)
+    void Device::InternalFillTopInputs(AccelerationStructureDesc& desc)
     {
         // desc.vpInstanceDescs can be set at a later stage, but for now we require it to be set, to avoid unwanted
         // errors
@@ -83,30 +121,101 @@ namespace DXR
         inputs.InstanceDescs = desc.vpInstanceDescs;
         inputs.NumDescs = desc.NumInstanceDescs;
         inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+    }
 
-        // Query the prebuild info
-        mDevice->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &desc.PrebuildInfo);
-
-        // Allocate the buffer
-        D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(
-            desc.PrebuildInfo.ResultDataMaxSizeInBytes,
-            D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS | D3D12_RESOURCE_FLAG_RAYTRACING_ACCELERATION_STRUCTURE);
+    void Device::BuildAccelerationStructure(const AccelerationStructureDesc& desc,
+                                            ComPtr<ID3D12GraphicsCommandList4>& cmdList)
+    {
+        DXR_ASSERT(desc.HasBeenAllocated(), "Acceleration structure has not been allocated");
 
-        auto outAccel = AllocateResource(resDesc, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+        DXR_ASSERT(desc.PrebuildInfo.ResultDataMaxSizeInBytes <= desc.DestSize,
+                   "Acceleration structure was compacted, it can't be rebuilt in place");
 
-        desc.BuildDesc.DestAccelerationStructureData = outAccel->GetResource()->GetGPUVirtualAddress();
+        // Postbuild info for compaction is queried separately, see EmitCompactionQueries(...)
 
-        return outAccel;
+        cmdList->BuildRaytracingAccelerationStructure(&desc.BuildDesc, 0, nullptr);
     }
 
-    void Device::BuildAccelerationStructure(const AccelerationStructureDesc& desc,
-                                            ComPtr<ID3D12GraphicsCommandList4>& cmdList)
+    BuildMode Device::UpdateAccelerationStructure(AccelerationStructureDesc& desc,
+                                                  ComPtr<ID3D12GraphicsCommandList4>& cmdList, float deformation)
     {
         DXR_ASSERT(desc.HasBeenAllocated(), "Acceleration structure has not been allocated");
+        DXR_ASSERT(desc.AllowsUpdate(), "Acceleration structure was not allocated with the ALLOW_UPDATE flag");
+        DXR_ASSERT(desc.BuildDesc.ScratchAccelerationStructureData != 0, "No scratch buffer assigned");
 
-        // TODO: Retrieve the postbuild info from the acceleration structure
+        auto& inputs = desc.BuildDesc.Inputs;
+
+        // A refit requires the same number of instances as the source, otherwise it has to be rebuilt
+        if (desc.GetType() == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL)
+        {
+            bool countChanged = inputs.NumDescs != desc.NumInstanceDescs;
+
+            inputs.InstanceDescs = desc.vpInstanceDescs;
+            inputs.NumDescs = desc.NumInstanceDescs;
+
+            if (countChanged)
+            {
+                desc.Policy.Reset();
+
+                // The allocation and the scratch buffer were sized for the previous count, the rebuild has to fit
+                // them. The stored prebuild info is left as is, it describes what was allocated.
+                [[maybe_unused]] auto info = mPrebuildInfoCache.GetOrQuery(inputs, [&](auto& prebuildInfo) {
+                    mDevice->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &prebuildInfo);
+                });
+
+                DXR_ASSERT(info.ResultDataMaxSizeInBytes <= desc.DestSize,
+                           "Acceleration structure is too small for the new number of instances, reallocate it");
+                DXR_ASSERT(info.ScratchDataSizeInBytes <= desc.PrebuildInfo.ScratchDataSizeInBytes,
+                           "Scratch buffer is too small for the new number of instances, reallocate it");
+            }
+        }
+
+        BuildMode mode = desc.Policy.Next(deformation);
+
+        DXR_ASSERT(mode == BuildMode::Update || desc.PrebuildInfo.ResultDataMaxSizeInBytes <= desc.DestSize,
+                   "Acceleration structure was compacted, it can only be refit, raise Policy.MaxRefits");
+
+        if (mode == BuildMode::Update)
+        {
+            inputs.Flags = desc.Flags | D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+            desc.BuildDesc.SourceAccelerationStructureData = desc.BuildDesc.DestAccelerationStructureData;
+        }
 
         cmdList->BuildRaytracingAccelerationStructure(&desc.BuildDesc, 0, nullptr);
+
+        // Leave the desc as a regular build, so other build functions don't accidentally refit
+        inputs.Flags = desc.Flags;
+        desc.BuildDesc.SourceAccelerationStructureData = 0;
+
+        return mode;
+    }
+
+    ComPtr<DMA::Allocation> Device::BuildAccelerationStructures(std::span<AccelerationStructureDesc> descs,
+                                                                ComPtr<ID3D12GraphicsCommandList4>& cmdList,
+                                                                UINT64 scratchBudget)
+    {
+        if (descs.empty())
+            return nullptr;
+
+        std::vector<UINT64> sizes;
+        sizes.reserve(descs.size());
+
+        for (auto& desc : descs)
+        {
+            DXR_ASSERT(desc.HasBeenAllocated(), "Acceleration structure has not been allocated");
+            sizes.push_back(desc.GetScratchBufferSize());
+        }
+
+        ScratchPlan plan = ScheduleScratchBatches(sizes, scratchBudget);
+
+        ComPtr<DMA::Allocation> scratchBuffer = AllocateScratchBuffer(plan.PeakSize);
+
+        for (size_t i = 0; i < descs.size(); i++) { AssignScratchBuffer(descs[i], scratchBuffer, plan.Offsets[i]); }
+
+        RecordScratchBatches(plan, std::span<const AccelerationStructureDesc>(descs), *cmdList.Get(),
+                             scratchBuffer->GetResource());
+
+        return scratchBuffer;
     }
 
     void Device::AssignScratchBuffer(std::vector<AccelerationStructureDesc>& descs, ComPtr<DMA::Allocation>& alloc)
@@ -121,9 +230,17 @@ namespace DXR
         }
     }
 
+    void Device::AssignScratchBuffer(std::vector<AccelerationStructureDesc>& descs, const ScratchPlan& plan,
+                                     ComPtr<DMA::Allocation>& alloc)
+    {
+        DXR_ASSERT(plan.Offsets.size() == descs.size(), "Scratch plan was made for a different list of builds");
+
+        for (size_t i = 0; i < descs.size(); i++) { AssignScratchBuffer(descs[i], alloc, plan.Offsets[i]); }
+    }
+
     void Device::AssignScratchBuffer(AccelerationStructureDesc& desc, ComPtr<DMA::Allocation>& alloc, UINT64 offset)
     {
-        DXR_ASSERT(offset + GetRequiredScratchBufferSize(desc) < alloc->GetSize(),
+        DXR_ASSERT(offset + GetRequiredScratchBufferSize(desc) <= alloc->GetSize(),
                    "Scratch buffer is too small for the provided acceleration structure");
 
         desc.BuildDesc.ScratchAccelerationStructureData =
@@ -156,7 +273,8 @@ namespace DXR
     ComPtr<DMA::Allocation> Device::AllocateScratchBuffer(UINT64 size)
     {
         D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-        return AllocateResource(resDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+        return AllocateResource(MemoryCategory::Scratch, resDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                                D3D12_HEAP_TYPE_DEFAULT);
     }
 
     ComPtr<DMA::Allocation> Device::AllocateInstanceBuffer(UINT64 numInstances, D3D12_HEAP_TYPE heapType)
@@ -164,7 +282,14 @@ namespace DXR
         D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(
             numInstances * sizeof(D3D12_RAYTRACING_INSTANCE_DESC), D3D12_RESOURCE_FLAG_NONE);
 
-        return AllocateResource(resDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, heapType);
+        return AllocateResource(MemoryCategory::Instances, resDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                                heapType);
+    }
+
+    void Device::FillInstanceBuffer(D3D12_RAYTRACING_INSTANCE_DESC* pInstanceDescs, const InstancePackDesc& src,
+                                    UINT64 count)
+    {
+        PackInstanceDescsParallel(*GetTaskPool(), src, count, pInstanceDescs);
     }
 
 } // namespace DXR
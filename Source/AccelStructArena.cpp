@@ -0,0 +1,200 @@
+#include "DXRay/AccelStructArena.h"
+#include "DXRay/Device.h"
+
+namespace DXR
+{
+    AccelStructArena::AccelStructArena(Device& device, UINT64 blockSize, UINT32 maxAllocationsPerBlock)
+        : mDevice(device), mBlockSize(DXR_ALIGN(blockSize, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT)),
+          mMaxAllocationsPerBlock(maxAllocationsPerBlock)
+    {
+        DXR_ASSERT(blockSize > 0, "Block size must not be zero");
+    }
+
+    AccelStructHandle AccelStructArena::Allocate(UINT64 size)
+    {
+        AccelStructHandle handle = {};
+
+        for (UINT32 i = 0; i < mBlocks.size() && !handle.IsValid(); i++)
+        {
+            if (mBlocks[i].Buffer == nullptr)
+                continue;
+
+            handle.Block = i;
+            handle.Allocation = mBlocks[i].Allocator->Allocate(size);
+        }
+
+        if (!handle.IsValid())
+        {
+            handle.Block = InternalCreateBlock(std::max(size, mBlockSize));
+            handle.Allocation = mBlocks[handle.Block].Allocator->Allocate(size);
+
+            DXR_ASSERT(handle.IsValid(), "Failed to allocate from a new block");
+        }
+
+        Block& block = mBlocks[handle.Block];
+
+        handle.Size = block.Allocator->GetAllocationSize(handle.Allocation);
+        handle.Address = block.Address + handle.Allocation.Offset;
+        handle.pResource = block.Buffer->GetResource();
+
+        mUsedSize += handle.Size;
+        mAllocationCount++;
+        mLive.emplace(handle.Address, handle);
+
+        return handle;
+    }
+
+    void AccelStructArena::Free(AccelStructHandle& handle)
+    {
+        if (!handle.IsValid())
+            return;
+
+        DXR_ASSERT(handle.Block < mBlocks.size() && mBlocks[handle.Block].Buffer != nullptr,
+                   "Handle does not belong to this arena");
+
+        [[maybe_unused]] size_t erased = mLive.erase(handle.Address);
+        DXR_ASSERT(erased == 1, "Handle was moved or freed already");
+
+        InternalFreeRange(handle);
+        mAllocationCount--;
+
+        handle = {};
+    }
+
+    void AccelStructArena::TrimEmptyBlocks()
+    {
+        for (Block& block : mBlocks)
+        {
+            if (block.Buffer == nullptr || block.Allocator->GetAllocationCount() > 0)
+                continue;
+
+            mReservedSize -= block.Allocator->GetSize();
+            mBlockCount--;
+
+            block = {};
+        }
+    }
+
+    AccelStructDefragmentation AccelStructArena::Defragment(ID3D12GraphicsCommandList4* cmdList, UINT64 maxBytes,
+                                                            UINT32 maxMoves)
+    {
+        std::vector<OffsetAllocator*> allocators(mBlocks.size());
+        for (size_t i = 0; i < mBlocks.size(); i++) { allocators[i] = mBlocks[i].Allocator.get(); }
+
+        std::vector<AccelStructHandle> handles = {};
+        handles.reserve(mLive.size());
+        for (auto& [address, handle] : mLive) { handles.push_back(handle); }
+
+        // The live map has no order, sort by placement so the same arena always plans the same moves
+        std::sort(handles.begin(), handles.end(), [](const AccelStructHandle& a, const AccelStructHandle& b) {
+            return a.Block != b.Block ? a.Block < b.Block : a.Allocation.Offset < b.Allocation.Offset;
+        });
+
+        std::vector<DefragmentationAllocation> allocations = {};
+        allocations.reserve(handles.size());
+        for (const AccelStructHandle& handle : handles)
+        {
+            allocations.push_back({handle.Block, handle.Allocation, handle.Size});
+        }
+
+        DefragmentationPlan plan = PlanDefragmentation(allocators, allocations, maxBytes, maxMoves);
+
+        AccelStructDefragmentation result = {};
+        result.MovedBytes = plan.MovedBytes;
+        result.IsComplete = plan.IsComplete;
+
+        if (plan.Moves.empty())
+            return result;
+
+        // The sources may still be written by builds earlier in the command list
+        D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+        cmdList->ResourceBarrier(1, &barrier);
+
+        result.Relocations.reserve(plan.Moves.size());
+
+        for (const DefragmentationMove& move : plan.Moves)
+        {
+            const AccelStructHandle& source = handles[move.Allocation];
+            Block& block = mBlocks[move.DestBlock];
+
+            AccelStructHandle dest = {};
+            dest.Block = move.DestBlock;
+            dest.Allocation = move.Destination;
+            dest.Size = block.Allocator->GetAllocationSize(move.Destination);
+            dest.Address = block.Address + move.Destination.Offset;
+            dest.pResource = block.Buffer->GetResource();
+
+            cmdList->CopyRaytracingAccelerationStructure(dest.Address, source.Address,
+                                                         D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_CLONE);
+
+            // The source counts as used memory until it is retired, the acceleration structure is still counted once
+            mUsedSize += dest.Size;
+            mLive.erase(source.Address);
+            mLive.emplace(dest.Address, dest);
+            mUnsubmittedFrees.push_back(source);
+
+            result.Relocations.push_back({source, dest});
+            result.Remap.emplace(source.Address, dest.Address);
+        }
+
+        // Top level builds read the copies
+        cmdList->ResourceBarrier(1, &barrier);
+
+        return result;
+    }
+
+    void AccelStructArena::Submit(UINT64 fenceValue)
+    {
+        for (const AccelStructHandle& handle : mUnsubmittedFrees) { mPendingFrees.push_back({fenceValue, handle}); }
+
+        mUnsubmittedFrees.clear();
+    }
+
+    void AccelStructArena::Retire(UINT64 completedFenceValue)
+    {
+        while (!mPendingFrees.empty() && mPendingFrees.front().FenceValue <= completedFenceValue)
+        {
+            InternalFreeRange(mPendingFrees.front().Handle);
+            mPendingFrees.pop_front();
+        }
+    }
+
+    UINT32 AccelStructArena::InternalCreateBlock(UINT64 size)
+    {
+        size = DXR_ALIGN(size, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+
+        D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(
+            size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS | D3D12_RESOURCE_FLAG_RAYTRACING_ACCELERATION_STRUCTURE);
+
+        Block block = {};
+        block.Buffer = mDevice.AllocateResource(MemoryCategory::AccelerationStructure, resDesc,
+                                                D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+        block.Address = block.Buffer->GetResource()->GetGPUVirtualAddress();
+        block.Allocator = std::make_unique<OffsetAllocator>(
+            size, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, mMaxAllocationsPerBlock);
+
+        mReservedSize += size;
+        mBlockCount++;
+
+        // Reuse the index of a trimmed block, so the indices of handles stay small
+        for (UINT32 i = 0; i < mBlocks.size(); i++)
+        {
+            if (mBlocks[i].Buffer == nullptr)
+            {
+                mBlocks[i] = std::move(block);
+                return i;
+            }
+        }
+
+        mBlocks.push_back(std::move(block));
+        return static_cast<UINT32>(mBlocks.size() - 1);
+    }
+
+    void AccelStructArena::InternalFreeRange(const AccelStructHandle& handle)
+    {
+        mBlocks[handle.Block].Allocator->Free(handle.Allocation);
+
+        mUsedSize -= handle.Size;
+    }
+
+} // namespace DXR
@@ -0,0 +1,375 @@
+#include "DXRay/BVHAnalyzer.h"
+#include "DXRay/Internal.h"
+
+#include <array>
+#include <chrono>
+
+namespace DXR
+{
+    namespace
+    {
+        using Internal::Bounds;
+
+        float GetAxis(const XMFLOAT3& v, UINT32 axis) { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; }
+
+        /// @brief The statistics of a subtree, summed while building.
+        struct SubtreeStats
+        {
+            double InteriorArea = 0.0;
+            double LeafArea = 0.0;
+            double OverlapArea = 0.0;
+            UINT64 NodeCount = 0;
+            UINT64 LeafCount = 0;
+            UINT32 MaxDepth = 0;
+
+            void Add(const SubtreeStats& other)
+            {
+                InteriorArea += other.InteriorArea;
+                LeafArea += other.LeafArea;
+                OverlapArea += other.OverlapArea;
+                NodeCount += other.NodeCount;
+                LeafCount += other.LeafCount;
+                MaxDepth = std::max(MaxDepth, other.MaxDepth);
+            }
+        };
+
+        class BVHBuilder
+        {
+        public:
+            BVHBuilder(TaskPool& pool, const BVHAnalysisOptions& options, std::vector<Bounds>& primitives)
+                : mPool(pool), mOptions(options), mPrimitives(primitives)
+            {
+            }
+
+            /// @brief Build over all primitives.
+            SubtreeStats Build()
+            {
+                std::vector<UINT32> indices(mPrimitives.size());
+                for (UINT32 i = 0; i < indices.size(); i++) { indices[i] = i; }
+
+                Bounds bounds = {};
+                for (const Bounds& primitive : mPrimitives) { bounds.Grow(primitive); }
+
+                if (indices.empty())
+                    return {};
+
+                return BuildNode(indices.data(), static_cast<UINT32>(indices.size()), bounds, 1);
+            }
+
+        private:
+            static constexpr UINT32 MaxBinCount = 64;
+
+            struct Bin
+            {
+                Bounds Box = {};
+                UINT32 Count = 0;
+            };
+
+            SubtreeStats BuildNode(UINT32* pIndices, UINT32 count, const Bounds& bounds, UINT32 depth)
+            {
+                SubtreeStats stats = {};
+                stats.NodeCount = 1;
+                stats.MaxDepth = depth;
+
+                const float area = bounds.GetArea();
+                const float leafCost = mOptions.IntersectionCost * count;
+
+                Bounds centroidBounds = {};
+                for (UINT32 i = 0; i < count; i++) { centroidBounds.Grow(mPrimitives[pIndices[i]].GetCenter()); }
+
+                // Find the cheapest split over the bins of all 3 axes
+                float bestCost = FLT_MAX;
+                UINT32 bestAxis = 0, bestSplit = 0;
+                Bounds bestLeft = {}, bestRight = {};
+
+                const UINT32 binCount = std::clamp(mOptions.BinCount, 2u, MaxBinCount);
+                std::array<Bin, MaxBinCount> bins;
+                std::array<Bounds, MaxBinCount> rightBounds;
+                std::array<UINT32, MaxBinCount> rightCounts;
+
+                for (UINT32 axis = 0; axis < 3 && count > 1; axis++)
+                {
+                    float axisMin = GetAxis(centroidBounds.Min, axis);
+                    float extent = GetAxis(centroidBounds.Max, axis) - axisMin;
+                    if (extent <= 0.0f)
+                        continue;
+
+                    float scale = binCount / extent;
+                    std::fill(bins.begin(), bins.begin() + binCount, Bin {});
+
+                    for (UINT32 i = 0; i < count; i++)
+                    {
+                        const Bounds& primitive = mPrimitives[pIndices[i]];
+                        float offset = GetAxis(primitive.GetCenter(), axis) - axisMin;
+                        UINT32 bin = std::min(static_cast<UINT32>(offset * scale), binCount - 1);
+                        bins[bin].Box.Grow(primitive);
+                        bins[bin].Count++;
+                    }
+
+                    // Sweep from the right, then evaluate every split from the left
+                    Bounds right = {};
+                    UINT32 rightCount = 0;
+                    for (UINT32 b = binCount - 1; b > 0; b--)
+                    {
+                        right.Grow(bins[b].Box);
+                        rightCount += bins[b].Count;
+                        rightBounds[b] = right;
+                        rightCounts[b] = rightCount;
+                    }
+
+                    Bounds left = {};
+                    UINT32 leftCount = 0;
+                    for (UINT32 b = 1; b < binCount; b++)
+                    {
+                        left.Grow(bins[b - 1].Box);
+                        leftCount += bins[b - 1].Count;
+
+                        if (leftCount == 0 || rightCounts[b] == 0)
+                            continue;
+
+                        float cost = mOptions.TraversalCost +
+                                     mOptions.IntersectionCost *
+                                         (left.GetArea() * leftCount + rightBounds[b].GetArea() * rightCounts[b]) /
+                                         std::max(area, FLT_MIN);
+
+                        if (cost < bestCost)
+                        {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestSplit = b;
+                            bestLeft = left;
+                            bestRight = rightBounds[b];
+                        }
+                    }
+                }
+
+                const bool mustSplit = count > mOptions.MaxLeafSize;
+                if (count <= 1 || (!mustSplit && leafCost <= bestCost))
+                {
+                    stats.LeafCount = 1;
+                    stats.LeafArea = static_cast<double>(area) * count;
+                    return stats;
+                }
+
+                UINT32 leftCount = 0;
+
+                if (bestCost < FLT_MAX)
+                {
+                    float axisMin = GetAxis(centroidBounds.Min, bestAxis);
+                    float scale = binCount / (GetAxis(centroidBounds.Max, bestAxis) - axisMin);
+
+                    UINT32* pMiddle = std::partition(pIndices, pIndices + count, [&](UINT32 index) {
+                        float center = GetAxis(mPrimitives[index].GetCenter(), bestAxis);
+                        return std::min(static_cast<UINT32>((center - axisMin) * scale), binCount - 1) < bestSplit;
+                    });
+                    leftCount = static_cast<UINT32>(pMiddle - pIndices);
+                }
+                else
+                {
+                    // All centroids are in the same place, split in the middle so the depth stays logarithmic
+                    leftCount = count / 2;
+                    bestLeft = {};
+                    bestRight = {};
+                    for (UINT32 i = 0; i < leftCount; i++) { bestLeft.Grow(mPrimitives[pIndices[i]]); }
+                    for (UINT32 i = leftCount; i < count; i++) { bestRight.Grow(mPrimitives[pIndices[i]]); }
+                }
+
+                stats.InteriorArea = area;
+                stats.OverlapArea = Bounds::Intersect(bestLeft, bestRight).GetArea();
+
+                SubtreeStats children[2] = {};
+                auto buildChild = [&](UINT64 child) {
+                    children[child] = child == 0 ? BuildNode(pIndices, leftCount, bestLeft, depth + 1)
+                                                 : BuildNode(pIndices + leftCount, count - leftCount, bestRight,
+                                                             depth + 1);
+                };
+
+                // Large subtrees are built on separate tasks, small ones aren't worth the queueing
+                if (count >= mOptions.ParallelThreshold)
+                {
+                    mPool.ParallelFor(2, 1, [&](UINT64 begin, UINT64 end) {
+                        for (UINT64 child = begin; child < end; child++) { buildChild(child); }
+                    });
+                }
+                else
+                {
+                    buildChild(0);
+                    buildChild(1);
+                }
+
+                stats.Add(children[0]);
+                stats.Add(children[1]);
+                return stats;
+            }
+
+        private:
+            TaskPool& mPool;
+            const BVHAnalysisOptions& mOptions;
+            std::vector<Bounds>& mPrimitives;
+        };
+
+        /// @brief Build a BVH over primitives and measure it.
+        /// @param interiorArea Receives the summed area of the interior nodes.
+        BVHMetrics Measure(TaskPool& pool, const BVHAnalysisOptions& options, std::vector<Bounds>& primitives,
+                           double& interiorArea)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            BVHBuilder builder(pool, options, primitives);
+            SubtreeStats stats = builder.Build();
+
+            auto end = std::chrono::steady_clock::now();
+
+            Bounds root = {};
+            for (const Bounds& primitive : primitives) { root.Grow(primitive); }
+
+            BVHMetrics metrics = {};
+            metrics.PrimitiveCount = primitives.size();
+            metrics.NodeCount = stats.NodeCount;
+            metrics.LeafCount = stats.LeafCount;
+            metrics.MaxDepth = stats.MaxDepth;
+            metrics.RootArea = root.GetArea();
+            metrics.BuildSeconds = std::chrono::duration<double>(end - start).count();
+
+            if (metrics.RootArea > 0.0f)
+            {
+                double cost = options.TraversalCost * stats.InteriorArea + options.IntersectionCost * stats.LeafArea;
+                metrics.SAHCost = static_cast<float>(cost / metrics.RootArea);
+            }
+
+            if (stats.InteriorArea > 0.0)
+                metrics.OverlapRatio = static_cast<float>(stats.OverlapArea / stats.InteriorArea);
+
+            interiorArea = stats.InteriorArea;
+            return metrics;
+        }
+
+        /// @brief Get the bounds of the triangles of a mesh, appended to primitives.
+        void GatherTriangles(TaskPool& pool, const MeshInput& mesh, std::vector<Bounds>& primitives)
+        {
+            const UINT32 indexCount = mesh.pIndices != nullptr ? mesh.IndexCount : mesh.VertexCount;
+            const UINT32 triangleCount = indexCount / 3;
+            const size_t first = primitives.size();
+
+            primitives.resize(first + triangleCount);
+
+            pool.ParallelFor(triangleCount, 16384, [&](UINT64 begin, UINT64 end) {
+                for (UINT64 t = begin; t < end; t++)
+                {
+                    Bounds bounds = {};
+                    for (UINT32 i = 0; i < 3; i++)
+                    {
+                        UINT64 index = mesh.pIndices != nullptr ? mesh.pIndices[t * 3 + i] : t * 3 + i;
+
+                        XMFLOAT3 position;
+                        memcpy(&position,
+                               reinterpret_cast<const BYTE*>(mesh.pPositions) + index * mesh.PositionStride,
+                               sizeof(XMFLOAT3));
+                        bounds.Grow(position);
+                    }
+
+                    primitives[first + t] = bounds;
+                }
+            });
+        }
+    } // namespace
+
+    BVHMetrics AnalyzeMesh(TaskPool& pool, const MeshInput& mesh, const BVHAnalysisOptions& options)
+    {
+        std::vector<Bounds> primitives = {};
+        GatherTriangles(pool, mesh, primitives);
+
+        double interiorArea = 0.0;
+        return Measure(pool, options, primitives, interiorArea);
+    }
+
+    BVHAnalysis AnalyzeGeometries(TaskPool& pool, std::span<const MeshInput> geometries,
+                                  const BVHAnalysisOptions& options)
+    {
+        // The builds run at the same time, so their own times overlap and only the total time gives the throughput
+        auto start = std::chrono::steady_clock::now();
+
+        BVHAnalysis analysis = {};
+        analysis.Geometries.resize(geometries.size());
+
+        // One BLAS per geometry, every geometry on its own task
+        std::vector<Bounds> geometryBounds(geometries.size());
+
+        pool.ParallelFor(geometries.size(), 1, [&](UINT64 begin, UINT64 end) {
+            for (UINT64 i = begin; i < end; i++)
+            {
+                std::vector<Bounds> primitives = {};
+                GatherTriangles(pool, geometries[i], primitives);
+
+                for (const Bounds& primitive : primitives) { geometryBounds[i].Grow(primitive); }
+
+                double interiorArea = 0.0;
+                analysis.Geometries[i] = Measure(pool, options, primitives, interiorArea);
+            }
+        });
+
+        // All geometries in one BLAS
+        std::vector<Bounds> merged = {};
+        for (const MeshInput& geometry : geometries) { GatherTriangles(pool, geometry, merged); }
+
+        double mergedInteriorArea = 0.0;
+        analysis.Merged = Measure(pool, options, merged, mergedInteriorArea);
+        analysis.MergedCost = analysis.Merged.SAHCost;
+
+        // One instance per geometry, the TLAS has an instance per leaf
+        BVHAnalysisOptions instanceOptions = options;
+        instanceOptions.MaxLeafSize = 1;
+
+        double instanceInteriorArea = 0.0;
+        analysis.Instances = Measure(pool, instanceOptions, geometryBounds, instanceInteriorArea);
+
+        // Rays that hit the bounds of a geometry enter its BLAS, and pay its cost relative to its own root
+        if (analysis.Instances.RootArea > 0.0f)
+        {
+            double cost = options.TraversalCost * instanceInteriorArea;
+            for (size_t i = 0; i < geometries.size(); i++)
+            {
+                const BVHMetrics& geometry = analysis.Geometries[i];
+                cost += static_cast<double>(geometry.RootArea) * (options.InstanceCost + geometry.SAHCost);
+            }
+
+            analysis.SeparateCost = static_cast<float>(cost / analysis.Instances.RootArea);
+        }
+
+        analysis.RecommendMerge = geometries.size() > 1 && analysis.MergedCost <= analysis.SeparateCost;
+
+        // Compare the cost of a build and the rays traced until the next one, for both preferences
+        UINT64 triangles = analysis.Merged.PrimitiveCount;
+        float rayCost = analysis.RecommendMerge || geometries.size() == 1 ? analysis.MergedCost : analysis.SeparateCost;
+
+        if (!options.Rebuilt)
+        {
+            // Built once, the build cost doesn't matter and compaction pays off
+            analysis.RecommendedFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE |
+                                        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
+        }
+        else
+        {
+            double buildCost = static_cast<double>(triangles) * options.BuildCostPerTriangle;
+            double traceCost = static_cast<double>(options.RaysPerBuild) * rayCost;
+
+            double fastTrace = buildCost * options.FastTraceBuildFactor + traceCost;
+            double fastBuild = buildCost + traceCost * options.FastBuildTraceFactor;
+
+            analysis.RecommendedFlags = fastTrace <= fastBuild
+                                            ? D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE
+                                            : D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD;
+        }
+
+        UINT64 built = analysis.Merged.PrimitiveCount;
+        for (const BVHMetrics& geometry : analysis.Geometries) { built += geometry.PrimitiveCount; }
+
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+
+        analysis.TrianglesPerSecond = seconds > 0.0 ? built / seconds : 0.0;
+
+        return analysis;
+    }
+
+} // namespace DXR
@@ -0,0 +1,114 @@
+#include "DXRay/Device.h"
+
+namespace DXR
+{
+    void Device::EmitCompactionQueries(CompactionBatch& batch, std::vector<ComPtr<DMA::Allocation>>& accelStructs,
+                                       ComPtr<ID3D12GraphicsCommandList4>& cmdList)
+    {
+        DXR_ASSERT(batch.mSources.empty(), "Compaction batch has already been used");
+        DXR_ASSERT(accelStructs.size() > 0, "No acceleration structures provided for compaction");
+
+        const UINT64 querySize =
+            accelStructs.size() * sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC);
+
+        batch.mSources = accelStructs;
+
+        // The postbuild info can only be written to a UAV in the default heap, so it is copied to a readback buffer
+        batch.mPostbuildBuffer =
+            AllocateResource(CD3DX12_RESOURCE_DESC::Buffer(querySize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+                             D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT);
+        batch.mReadbackBuffer = AllocateResource(CD3DX12_RESOURCE_DESC::Buffer(querySize),
+                                                 D3D12_RESOURCE_STATE_COPY_DEST, D3D12_HEAP_TYPE_READBACK);
+
+        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> addresses;
+        addresses.reserve(accelStructs.size());
+
+        for (auto& accelStruct : accelStructs)
+        {
+            addresses.push_back(accelStruct->GetResource()->GetGPUVirtualAddress());
+        }
+
+        // The builds have to be finished before their compacted size is known
+        D3D12_RESOURCE_BARRIER buildBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+        cmdList->ResourceBarrier(1, &buildBarrier);
+
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuildDesc = {};
+        postbuildDesc.DestBuffer = batch.mPostbuildBuffer->GetResource()->GetGPUVirtualAddress();
+        postbuildDesc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+
+        cmdList->EmitRaytracingAccelerationStructurePostbuildInfo(&postbuildDesc, static_cast<UINT>(addresses.size()),
+                                                                  addresses.data());
+
+        D3D12_RESOURCE_BARRIER toCopy = CD3DX12_RESOURCE_BARRIER::Transition(
+            batch.mPostbuildBuffer->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+            D3D12_RESOURCE_STATE_COPY_SOURCE);
+        cmdList->ResourceBarrier(1, &toCopy);
+
+        cmdList->CopyBufferRegion(batch.mReadbackBuffer->GetResource(), 0, batch.mPostbuildBuffer->GetResource(), 0,
+                                  querySize);
+    }
+
+    const std::vector<CompactionResult>& Device::CompactAccelerationStructures(
+        CompactionBatch& batch, ComPtr<ID3D12GraphicsCommandList4>& cmdList)
+    {
+        DXR_ASSERT(batch.IsQueried(), "Compaction batch has not been queried or has already been compacted");
+
+        const size_t numStructures = batch.mSources.size();
+
+        // Read back the compacted sizes, the command list that emitted them must have finished by now
+        void* pData = nullptr;
+        CD3DX12_RANGE readRange(
+            0, numStructures * sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC));
+        DXR_THROW_FAILED(batch.mReadbackBuffer->GetResource()->Map(0, &readRange, &pData));
+
+        auto* pSizes =
+            reinterpret_cast<D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC*>(pData);
+
+        batch.mResults.resize(numStructures);
+
+        for (size_t i = 0; i < numStructures; i++)
+        {
+            auto& source = batch.mSources[i];
+            auto& result = batch.mResults[i];
+
+            result.OldAddress = source->GetResource()->GetGPUVirtualAddress();
+            result.OriginalSize = source->GetSize();
+
+            // Without ALLOW_COMPACTION the driver reports no size, the original is kept as it is
+            DXR_ASSERT(pSizes[i].CompactedSizeInBytes != 0,
+                       "Acceleration structure was not built with the ALLOW_COMPACTION build flag");
+            if (pSizes[i].CompactedSizeInBytes == 0)
+            {
+                result.Allocation = source;
+                result.NewAddress = result.OldAddress;
+                result.CompactedSize = result.OriginalSize;
+                continue;
+            }
+
+            result.CompactedSize =
+                DXR_ALIGN(pSizes[i].CompactedSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+
+            D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(
+                result.CompactedSize,
+                D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS | D3D12_RESOURCE_FLAG_RAYTRACING_ACCELERATION_STRUCTURE);
+
+            result.Allocation = AllocateResource(MemoryCategory::AccelerationStructure, resDesc,
+                                                 D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+            result.CompactedSize = result.Allocation->GetSize();
+            result.NewAddress = result.Allocation->GetResource()->GetGPUVirtualAddress();
+
+            cmdList->CopyRaytracingAccelerationStructure(result.NewAddress, result.OldAddress,
+                                                         D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
+        }
+
+        CD3DX12_RANGE writeRange(0, 0);
+        batch.mReadbackBuffer->GetResource()->Unmap(0, &writeRange);
+
+        // The originals are read by the copies, so they can only be released after the GPU is done with them
+        batch.mRetired = std::move(batch.mSources);
+        batch.mSources.clear();
+
+        return batch.mResults;
+    }
+
+} // namespace DXR
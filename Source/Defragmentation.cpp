@@ -0,0 +1,120 @@
+#include "DXRay/Defragmentation.h"
+
+namespace DXR
+{
+    DefragmentationPlan PlanDefragmentation(std::span<OffsetAllocator* const> blocks,
+                                            std::span<const DefragmentationAllocation> allocations, UINT64 maxBytes,
+                                            UINT32 maxMoves)
+    {
+        DefragmentationPlan plan = {};
+
+        // The allocations of each block, largest first so the destinations are packed well
+        std::vector<std::vector<UINT32>> blockAllocations(blocks.size());
+
+        for (UINT32 i = 0; i < allocations.size(); i++)
+        {
+            DXR_ASSERT(allocations[i].Block < blocks.size() && blocks[allocations[i].Block] != nullptr,
+                       "Allocation is in a block that doesn't exist");
+            blockAllocations[allocations[i].Block].push_back(i);
+        }
+
+        for (auto& indices : blockAllocations)
+        {
+            std::stable_sort(indices.begin(), indices.end(),
+                             [&](UINT32 a, UINT32 b) { return allocations[a].Size > allocations[b].Size; });
+        }
+
+        auto usedSize = [&](UINT32 block) { return blocks[block]->GetSize() - blocks[block]->GetFreeSize(); };
+
+        // Blocks without allocations are left alone, moving into them doesn't free anything
+        std::vector<UINT32> order = {};
+
+        for (UINT32 b = 0; b < blocks.size(); b++)
+        {
+            if (blocks[b] != nullptr && !blockAllocations[b].empty())
+                order.push_back(b);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](UINT32 a, UINT32 b) { return usedSize(a) < usedSize(b); });
+
+        std::vector<bool> isSource(blocks.size(), false);
+
+        for (UINT32 source : order)
+        {
+            isSource[source] = true;
+
+            // The densest blocks first, so the sparse ones keep emptying
+            std::vector<UINT32> destinations = {};
+            UINT64 freeSize = 0;
+
+            for (auto it = order.rbegin(); it != order.rend(); ++it)
+            {
+                if (!isSource[*it])
+                {
+                    destinations.push_back(*it);
+                    freeSize += blocks[*it]->GetFreeSize();
+                }
+            }
+
+            // The next blocks have more to move and fewer destinations, so they won't fit either
+            if (freeSize < usedSize(source))
+                break;
+
+            size_t firstMove = plan.Moves.size();
+            bool fits = true;
+
+            for (UINT32 index : blockAllocations[source])
+            {
+                const DefragmentationAllocation& allocation = allocations[index];
+
+                if (plan.Moves.size() >= maxMoves ||
+                    (plan.MovedBytes > 0 && plan.MovedBytes + allocation.Size > maxBytes))
+                {
+                    plan.IsComplete = false;
+                    return plan;
+                }
+
+                DefragmentationMove move = {index, 0, {}};
+
+                for (UINT32 dest : destinations)
+                {
+                    move.Destination = blocks[dest]->Allocate(allocation.Size);
+
+                    if (move.Destination.IsValid())
+                    {
+                        move.DestBlock = dest;
+                        break;
+                    }
+                }
+
+                if (!move.Destination.IsValid())
+                {
+                    fits = false;
+                    break;
+                }
+
+                plan.Moves.push_back(move);
+                plan.MovedBytes += allocation.Size;
+            }
+
+            if (fits)
+            {
+                plan.EvacuatedBlocks.push_back(source);
+                continue;
+            }
+
+            // Moving only part of a block doesn't free anything, undo its moves
+            for (size_t i = firstMove; i < plan.Moves.size(); i++)
+            {
+                blocks[plan.Moves[i].DestBlock]->Free(plan.Moves[i].Destination);
+                plan.MovedBytes -= allocations[plan.Moves[i].Allocation].Size;
+            }
+
+            plan.Moves.resize(firstMove);
+            break;
+        }
+
+        return plan;
+    }
+
+} // namespace DXR
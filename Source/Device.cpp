@@ -3,7 +3,7 @@
 namespace DXR
 {
     Device::Device(ComPtr<IDXRDevice> device, ComPtr<IDXRAdapter> adapter, ComPtr<DMA::Allocator> allocator)
-        : mDevice(device), mAdapter(adapter), mAllocator(allocator)
+        : mDevice(device), mAdapter(adapter), mAllocator(allocator), mResidencyManager(device.Get(), adapter.Get())
     {
         if (mAllocator == nullptr)
         {
@@ -17,6 +17,34 @@ namespace DXR
 
     Device::~Device()
     {
+        // Queued pipeline compilations use the caches, wait for them before the members are destroyed
+        std::shared_ptr<TaskPool> pool = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mTaskPoolMutex);
+            pool = mTaskPool;
+        }
+
+        while (mPendingAsyncTasks.load(std::memory_order_acquire) != 0)
+        {
+            if (pool == nullptr || !pool->RunPendingTask())
+                std::this_thread::yield();
+        }
+    }
+
+    std::shared_ptr<TaskPool> Device::GetTaskPool()
+    {
+        std::lock_guard<std::mutex> lock(mTaskPoolMutex);
+
+        if (mTaskPool == nullptr)
+            mTaskPool = std::make_shared<TaskPool>();
+
+        return mTaskPool;
+    }
+
+    void Device::SetTaskPool(const std::shared_ptr<TaskPool>& pool)
+    {
+        std::lock_guard<std::mutex> lock(mTaskPoolMutex);
+        mTaskPool = pool;
     }
 
     void* Device::MapAllocationForWrite(ComPtr<DMA::Allocation>& res)
@@ -30,6 +58,13 @@ namespace DXR
     ComPtr<DMA::Allocation> Device::AllocateResource(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES state,
                                                      D3D12_HEAP_TYPE heapType, DMA::ALLOCATION_FLAGS allocFlags,
                                                      D3D12_HEAP_FLAGS heapFlags)
+    {
+        return AllocateResource(MemoryCategory::Other, desc, state, heapType, allocFlags, heapFlags);
+    }
+
+    ComPtr<DMA::Allocation> Device::AllocateResource(MemoryCategory category, const D3D12_RESOURCE_DESC& desc,
+                                                     D3D12_RESOURCE_STATES state, D3D12_HEAP_TYPE heapType,
+                                                     DMA::ALLOCATION_FLAGS allocFlags, D3D12_HEAP_FLAGS heapFlags)
     {
         ComPtr<DMA::Allocation> outAlloc = nullptr;
 
@@ -41,6 +76,8 @@ namespace DXR
 
         DXR_THROW_FAILED(mAllocator->CreateResource(&allocDesc, &desc, state, nullptr, &outAlloc, {}, nullptr));
 
+        mResidencyManager.TrackAllocation(category, outAlloc.Get());
+
         return outAlloc;
     }
 
@@ -0,0 +1,140 @@
+#include "DXRay/HitGroupTableBuilder.h"
+
+namespace DXR
+{
+    UINT32 HitGroupTableBuilder::AddRecordGroup(std::span<const HitGroupRecordDesc> records)
+    {
+        DXR_ASSERT(!records.empty(), "Record group must have at least one record");
+
+        mGroupStarts.push_back(static_cast<UINT32>(mPendingRecords.size()));
+
+        for (auto& record : records)
+        {
+            auto [hitGroup, inserted] =
+                mHitGroupIndices.try_emplace(record.HitGroup, static_cast<UINT32>(mHitGroups.size()));
+            if (inserted)
+                mHitGroups.push_back(record.HitGroup);
+
+            UINT64 offset = mPendingData.size();
+            mPendingData.resize(offset + record.Size);
+            if (record.Size > 0)
+                memcpy(mPendingData.data() + offset, record.pData, record.Size);
+
+            mPendingRecords.push_back({hitGroup->second, offset, record.Size});
+            mMaxDataSize = std::max(mMaxDataSize, record.Size);
+        }
+
+        return static_cast<UINT32>(mGroupStarts.size() - 1);
+    }
+
+    void HitGroupTableBuilder::Build(ComPtr<ID3D12StateObject>& pipeline)
+    {
+        ComPtr<ID3D12StateObjectProperties> stateObjectProps = nullptr;
+        DXR_THROW_FAILED(pipeline.As(&stateObjectProps));
+
+        // Records are compared whole, so unused bytes are zero like they are in the shader table
+        mRecordSize = static_cast<UINT32>(DXR_ALIGN(D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + mMaxDataSize,
+                                                    D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT));
+
+        std::vector<const void*> identifiers(mHitGroups.size());
+        for (UINT32 i = 0; i < mHitGroups.size(); i++)
+        {
+            identifiers[i] = stateObjectProps->GetShaderIdentifier(mHitGroups[i].c_str());
+            DXR_ASSERT(identifiers[i] != nullptr, "Hit group does not exist in the pipeline");
+        }
+
+        mRecords.clear();
+        mRecordHitGroups.clear();
+        mGroupRemap.assign(mGroupStarts.size(), 0);
+
+        // Hash of the contents of a group to the index of its first record, multiple entries in case of collisions
+        std::unordered_multimap<size_t, UINT32> uniqueGroups = {};
+        uniqueGroups.reserve(mGroupStarts.size());
+
+        std::vector<BYTE> groupData = {};
+
+        for (UINT32 group = 0; group < mGroupStarts.size(); group++)
+        {
+            UINT32 first = mGroupStarts[group];
+            UINT32 end = group + 1 < mGroupStarts.size() ? mGroupStarts[group + 1]
+                                                          : static_cast<UINT32>(mPendingRecords.size());
+            UINT32 count = end - first;
+
+            groupData.assign(UINT64(count) * mRecordSize, 0);
+
+            for (UINT32 i = 0; i < count; i++)
+            {
+                auto& record = mPendingRecords[first + i];
+                BYTE* pRecord = groupData.data() + (UINT64(i) * mRecordSize);
+
+                memcpy(pRecord, identifiers[record.HitGroup], D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+                if (record.Size > 0)
+                {
+                    memcpy(pRecord + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES, mPendingData.data() + record.Offset,
+                           record.Size);
+                }
+            }
+
+            std::string_view key(reinterpret_cast<const char*>(groupData.data()), groupData.size());
+            size_t hash = std::hash<std::string_view> {}(key);
+
+            bool found = false;
+            auto [candidate, candidatesEnd] = uniqueGroups.equal_range(hash);
+            for (; candidate != candidatesEnd; candidate++)
+            {
+                UINT64 start = UINT64(candidate->second) * mRecordSize;
+
+                if (start + groupData.size() <= mRecords.size() &&
+                    memcmp(mRecords.data() + start, groupData.data(), groupData.size()) == 0)
+                {
+                    mGroupRemap[group] = candidate->second;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (found)
+                continue;
+
+            UINT32 uniqueIndex = static_cast<UINT32>(mRecordHitGroups.size());
+            mGroupRemap[group] = uniqueIndex;
+            uniqueGroups.emplace(hash, uniqueIndex);
+
+            mRecords.insert(mRecords.end(), groupData.begin(), groupData.end());
+            for (UINT32 i = first; i < end; i++) { mRecordHitGroups.push_back(mPendingRecords[i].HitGroup); }
+        }
+
+        mStats.NumRecords = static_cast<UINT32>(mPendingRecords.size());
+        mStats.NumUniqueRecords = static_cast<UINT32>(mRecordHitGroups.size());
+        mStats.OriginalSize = UINT64(mStats.NumRecords) * mRecordSize;
+        mStats.DeduplicatedSize = UINT64(mStats.NumUniqueRecords) * mRecordSize;
+    }
+
+    void HitGroupTableBuilder::AddToShaderTable(ShaderTable& table)
+    {
+        DXR_ASSERT(!mRecordHitGroups.empty(), "Build the records before adding them to a shader table");
+
+        for (UINT32 i = 0; i < mRecordHitGroups.size(); i++)
+        {
+            auto handle = table.AddShaderRecord(mHitGroups[mRecordHitGroups[i]], ShaderType::HitGroup);
+
+            if (i == 0)
+                mFirstRecord = handle;
+        }
+
+        mFirstHitGroupIndex = mFirstRecord.GetIndex();
+    }
+
+    void HitGroupTableBuilder::WriteShaderRecords(ShaderTable& table) const
+    {
+        DXR_ASSERT(mFirstRecord.IsValid(), "Records have not been added to a shader table");
+
+        if (mMaxDataSize == 0)
+            return;
+
+        // Identifiers are written by the shader table itself, only the local root arguments are taken from the records
+        table.WriteShaderRecords(mFirstRecord, static_cast<UINT32>(mRecordHitGroups.size()),
+                                 mRecords.data() + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES, mMaxDataSize, mRecordSize);
+    }
+
+} // namespace DXR
@@ -0,0 +1,276 @@
+#include "DXRay/InstanceManager.h"
+
+#include <bit>
+
+namespace DXR
+{
+    InstanceManager::InstanceManager(Device& device, UINT32 capacity, UINT32 numBuffers, D3D12_HEAP_TYPE heapType)
+        : mDevice(device), mHeapType(heapType)
+    {
+        DXR_ASSERT(heapType != D3D12_HEAP_TYPE_DEFAULT, "Instance buffers must be in heap that is CPU accessible");
+        DXR_ASSERT(numBuffers > 0, "Instance manager needs at least one instance buffer");
+
+        capacity = std::max(capacity, 1u);
+
+        mBuffers.resize(numBuffers);
+
+        for (auto& buffer : mBuffers)
+        {
+            buffer.Allocation = mDevice.AllocateInstanceBuffer(capacity, mHeapType);
+            buffer.pDescs =
+                reinterpret_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(mDevice.MapAllocationForWrite(buffer.Allocation));
+            buffer.Capacity = capacity;
+            buffer.DirtyBits.resize((capacity + 63) / 64, 0);
+        }
+
+        mTransforms.reserve(capacity);
+        mAccelStructs.reserve(capacity);
+        mInstanceIDs.reserve(capacity);
+        mHitGroupOffsets.reserve(capacity);
+        mMasks.reserve(capacity);
+        mFlags.reserve(capacity);
+        mSlotToHandle.reserve(capacity);
+    }
+
+    InstanceHandle InstanceManager::AddInstance(D3D12_GPU_VIRTUAL_ADDRESS accelStruct, const XMFLOAT3X4& transform,
+                                                UINT32 instanceID, UINT8 mask, UINT32 hitGroupOffset,
+                                                D3D12_RAYTRACING_INSTANCE_FLAGS flags)
+    {
+        UINT32 slot = GetInstanceCount();
+        InstanceHandle handle = {};
+
+        // Reuse the handle of a removed instance if there is one
+        if (!mFreeHandles.empty())
+        {
+            handle.Id = mFreeHandles.back();
+            mFreeHandles.pop_back();
+            mHandleToSlot[handle.Id] = slot;
+        }
+        else
+        {
+            handle.Id = static_cast<UINT32>(mHandleToSlot.size());
+            mHandleToSlot.push_back(slot);
+        }
+
+        mSlotToHandle.push_back(handle.Id);
+        mTransforms.push_back(transform);
+        mAccelStructs.push_back(accelStruct);
+        mInstanceIDs.push_back(instanceID);
+        mHitGroupOffsets.push_back(hitGroupOffset);
+        mMasks.push_back(mask);
+        mFlags.push_back(static_cast<UINT8>(flags));
+
+        MarkDirty(slot);
+
+        return handle;
+    }
+
+    void InstanceManager::RemoveInstance(InstanceHandle handle)
+    {
+        UINT32 slot = GetSlot(handle);
+        UINT32 last = GetInstanceCount() - 1;
+
+        // Move the last instance into the hole, so the instances stay dense
+        if (slot != last)
+        {
+            mTransforms[slot] = mTransforms[last];
+            mAccelStructs[slot] = mAccelStructs[last];
+            mInstanceIDs[slot] = mInstanceIDs[last];
+            mHitGroupOffsets[slot] = mHitGroupOffsets[last];
+            mMasks[slot] = mMasks[last];
+            mFlags[slot] = mFlags[last];
+
+            mSlotToHandle[slot] = mSlotToHandle[last];
+            mHandleToSlot[mSlotToHandle[slot]] = slot;
+
+            MarkDirty(slot);
+        }
+
+        mTransforms.pop_back();
+        mAccelStructs.pop_back();
+        mInstanceIDs.pop_back();
+        mHitGroupOffsets.pop_back();
+        mMasks.pop_back();
+        mFlags.pop_back();
+        mSlotToHandle.pop_back();
+
+        mHandleToSlot[handle.Id] = UINT32_MAX;
+        mFreeHandles.push_back(handle.Id);
+    }
+
+    void InstanceManager::SetTransform(InstanceHandle handle, const XMFLOAT3X4& transform)
+    {
+        UINT32 slot = GetSlot(handle);
+        mTransforms[slot] = transform;
+        MarkDirty(slot);
+    }
+
+    void InstanceManager::SetTransform(InstanceHandle handle, FXMMATRIX transform)
+    {
+        UINT32 slot = GetSlot(handle);
+        XMStoreFloat3x4(&mTransforms[slot], transform);
+        MarkDirty(slot);
+    }
+
+    void InstanceManager::SetAccelerationStructure(InstanceHandle handle, D3D12_GPU_VIRTUAL_ADDRESS accelStruct)
+    {
+        UINT32 slot = GetSlot(handle);
+        mAccelStructs[slot] = accelStruct;
+        MarkDirty(slot);
+    }
+
+    UINT32 InstanceManager::RemapAccelerationStructures(const AccelStructRemap& remap)
+    {
+        if (remap.empty())
+            return 0;
+
+        UINT32 count = 0;
+
+        for (UINT32 slot = 0; slot < GetInstanceCount(); slot++)
+        {
+            auto moved = remap.find(mAccelStructs[slot]);
+            if (moved == remap.end())
+                continue;
+
+            mAccelStructs[slot] = moved->second;
+            MarkDirty(slot);
+            count++;
+        }
+
+        return count;
+    }
+
+    void InstanceManager::SetInstanceID(InstanceHandle handle, UINT32 instanceID)
+    {
+        UINT32 slot = GetSlot(handle);
+        mInstanceIDs[slot] = instanceID;
+        MarkDirty(slot);
+    }
+
+    void InstanceManager::SetMask(InstanceHandle handle, UINT8 mask)
+    {
+        UINT32 slot = GetSlot(handle);
+        mMasks[slot] = mask;
+        MarkDirty(slot);
+    }
+
+    void InstanceManager::SetHitGroupOffset(InstanceHandle handle, UINT32 hitGroupOffset)
+    {
+        UINT32 slot = GetSlot(handle);
+        mHitGroupOffsets[slot] = hitGroupOffset;
+        MarkDirty(slot);
+    }
+
+    void InstanceManager::SetFlags(InstanceHandle handle, D3D12_RAYTRACING_INSTANCE_FLAGS flags)
+    {
+        UINT32 slot = GetSlot(handle);
+        mFlags[slot] = static_cast<UINT8>(flags);
+        MarkDirty(slot);
+    }
+
+    UINT32 InstanceManager::Flush(UINT32 frameIndex, AccelerationStructureDesc& tlas)
+    {
+        auto& buffer = mBuffers[frameIndex % mBuffers.size()];
+        const UINT32 count = GetInstanceCount();
+
+        // Grow geometrically, the old buffer was last used numBuffers frames ago, so it can be released
+        if (count > buffer.Capacity)
+        {
+            buffer.Capacity = std::max(count, buffer.Capacity * 2);
+            buffer.Allocation = mDevice.AllocateInstanceBuffer(buffer.Capacity, mHeapType);
+            buffer.pDescs =
+                reinterpret_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(mDevice.MapAllocationForWrite(buffer.Allocation));
+
+            // Nothing of the new buffer is valid yet
+            buffer.DirtyBits.assign((buffer.Capacity + 63) / 64, 0);
+            for (UINT32 slot = 0; slot < count; slot++) { buffer.DirtyBits[slot / 64] |= 1ull << (slot % 64); }
+        }
+
+        auto writeRange = [&](UINT32 begin, UINT32 end) {
+            for (UINT32 slot = begin; slot < end; slot++)
+            {
+                D3D12_RAYTRACING_INSTANCE_DESC desc = {};
+                memcpy(desc.Transform, &mTransforms[slot], sizeof(desc.Transform));
+                desc.InstanceID = mInstanceIDs[slot];
+                desc.InstanceMask = mMasks[slot];
+                desc.InstanceContributionToHitGroupIndex = mHitGroupOffsets[slot];
+                desc.Flags = mFlags[slot];
+                desc.AccelerationStructure = mAccelStructs[slot];
+
+                // Write the whole desc at once, the buffer is usually write-combined memory
+                buffer.pDescs[slot] = desc;
+            }
+        };
+
+        UINT32 written = 0;
+        UINT32 rangeBegin = 0;
+        UINT32 rangeEnd = 0;
+        mLastFlushRangeCount = 0;
+
+        // Find runs of dirty bits and coalesce adjacent runs across words into a single range
+        for (UINT32 word = 0; word < buffer.DirtyBits.size(); word++)
+        {
+            UINT64 bits = buffer.DirtyBits[word];
+            buffer.DirtyBits[word] = 0;
+
+            while (bits != 0)
+            {
+                UINT32 first = std::countr_zero(bits);
+                UINT32 length = std::countr_one(bits >> first);
+
+                bits &= length == 64 ? 0 : ~(((1ull << length) - 1) << first);
+
+                // Slots past the end belong to removed instances, nothing to write
+                UINT32 begin = word * 64 + first;
+                UINT32 end = std::min(begin + length, count);
+                if (begin >= end)
+                    continue;
+
+                if (begin != rangeEnd || rangeBegin == rangeEnd)
+                {
+                    if (rangeBegin != rangeEnd)
+                    {
+                        writeRange(rangeBegin, rangeEnd);
+                        mLastFlushRangeCount++;
+                    }
+                    rangeBegin = begin;
+                }
+
+                rangeEnd = end;
+                written += end - begin;
+            }
+        }
+
+        if (rangeBegin != rangeEnd)
+        {
+            writeRange(rangeBegin, rangeEnd);
+            mLastFlushRangeCount++;
+        }
+
+        tlas.vpInstanceDescs = buffer.Allocation->GetResource()->GetGPUVirtualAddress();
+        tlas.NumInstanceDescs = count;
+
+        return written;
+    }
+
+    UINT32 InstanceManager::GetSlot(InstanceHandle handle) const
+    {
+        DXR_ASSERT(handle.IsValid() && handle.Id < mHandleToSlot.size() && mHandleToSlot[handle.Id] != UINT32_MAX,
+                   "Invalid instance handle");
+        return mHandleToSlot[handle.Id];
+    }
+
+    void InstanceManager::MarkDirty(UINT32 slot)
+    {
+        const UINT32 word = slot / 64;
+
+        for (auto& buffer : mBuffers)
+        {
+            if (word >= buffer.DirtyBits.size())
+                buffer.DirtyBits.resize(word + 1, 0);
+
+            buffer.DirtyBits[word] |= 1ull << (slot % 64);
+        }
+    }
+
+} // namespace DXR
@@ -0,0 +1,119 @@
+#include "DXRay/InstancePacking.h"
+
+#if defined(_XM_SSE_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
+namespace DXR
+{
+    namespace
+    {
+        /// @brief Get the last 16 bytes of an instance description, everything but the transform.
+        void GetInstanceFields(const InstancePackDesc& src, UINT64 i, UINT32& idAndMask, UINT32& offsetAndFlags,
+                               D3D12_GPU_VIRTUAL_ADDRESS& accelStruct)
+        {
+            UINT32 id = src.pInstanceIDs ? src.pInstanceIDs[i] : static_cast<UINT32>(i);
+            UINT32 mask = src.pMasks ? src.pMasks[i] : 0xFF;
+            UINT32 offset = src.pHitGroupOffsets ? src.pHitGroupOffsets[i] : 0;
+            UINT32 flags = src.pFlags ? src.pFlags[i] : 0;
+
+            // Same layout as the bit fields of D3D12_RAYTRACING_INSTANCE_DESC, 24 bits followed by 8 bits
+            idAndMask = (id & 0xFFFFFF) | (mask << 24);
+            offsetAndFlags = (offset & 0xFFFFFF) | (flags << 24);
+            accelStruct = src.pAccelStructs[i];
+        }
+    } // namespace
+
+    void PackInstanceDescsScalar(const InstancePackDesc& src, UINT64 first, UINT64 count,
+                                 D3D12_RAYTRACING_INSTANCE_DESC* pDest)
+    {
+        DXR_ASSERT(src.pTransforms != nullptr && src.pAccelStructs != nullptr, "Transforms and BLAS are required");
+
+        for (UINT64 i = first; i < first + count; i++)
+        {
+            const XMFLOAT4X4& m = src.pTransforms[i];
+            D3D12_RAYTRACING_INSTANCE_DESC desc = {};
+
+            for (UINT32 row = 0; row < 3; row++)
+            {
+                for (UINT32 col = 0; col < 4; col++)
+                {
+                    desc.Transform[row][col] = src.Layout == MatrixLayout::RowMajor ? m.m[row][col] : m.m[col][row];
+                }
+            }
+
+            UINT32 idAndMask, offsetAndFlags;
+            GetInstanceFields(src, i, idAndMask, offsetAndFlags, desc.AccelerationStructure);
+
+            desc.InstanceID = idAndMask & 0xFFFFFF;
+            desc.InstanceMask = idAndMask >> 24;
+            desc.InstanceContributionToHitGroupIndex = offsetAndFlags & 0xFFFFFF;
+            desc.Flags = offsetAndFlags >> 24;
+
+            pDest[i] = desc;
+        }
+    }
+
+    void PackInstanceDescs(const InstancePackDesc& src, UINT64 first, UINT64 count,
+                           D3D12_RAYTRACING_INSTANCE_DESC* pDest)
+    {
+#if defined(_XM_SSE_INTRINSICS_)
+        static_assert(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) == 64, "Instance description is expected to be 64 bytes");
+
+        DXR_ASSERT(src.pTransforms != nullptr && src.pAccelStructs != nullptr, "Transforms and BLAS are required");
+
+        // Streaming stores need 16 byte alignment, which instance buffers have anyway
+        if ((reinterpret_cast<UINT_PTR>(pDest) & 15) != 0)
+        {
+            PackInstanceDescsScalar(src, first, count, pDest);
+            return;
+        }
+
+        for (UINT64 i = first; i < first + count; i++)
+        {
+            const float* m = &src.pTransforms[i].m[0][0];
+            float* pDst = reinterpret_cast<float*>(pDest + i);
+
+            __m128 row0 = _mm_loadu_ps(m + 0);
+            __m128 row1 = _mm_loadu_ps(m + 4);
+            __m128 row2 = _mm_loadu_ps(m + 8);
+
+            if (src.Layout == MatrixLayout::ColumnMajor)
+            {
+                __m128 row3 = _mm_loadu_ps(m + 12);
+                _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+            }
+
+            UINT32 idAndMask, offsetAndFlags;
+            D3D12_GPU_VIRTUAL_ADDRESS accelStruct;
+            GetInstanceFields(src, i, idAndMask, offsetAndFlags, accelStruct);
+
+            __m128i fields = _mm_set_epi32(static_cast<int>(accelStruct >> 32), static_cast<int>(accelStruct),
+                                           static_cast<int>(offsetAndFlags), static_cast<int>(idAndMask));
+
+            // Full 64 byte line written with non-temporal stores, so write-combining buffers are flushed whole
+            _mm_stream_ps(pDst + 0, row0);
+            _mm_stream_ps(pDst + 4, row1);
+            _mm_stream_ps(pDst + 8, row2);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(pDst + 12), fields);
+        }
+
+        // Make the streaming stores visible before the buffer is used
+        _mm_sfence();
+#else
+        PackInstanceDescsScalar(src, first, count, pDest);
+#endif
+    }
+
+    void PackInstanceDescsParallel(TaskPool& pool, const InstancePackDesc& src, UINT64 count,
+                                   D3D12_RAYTRACING_INSTANCE_DESC* pDest, UINT64 grainSize)
+    {
+        DXR_ASSERT((reinterpret_cast<UINT_PTR>(pDest) & 63) == 0,
+                   "Instance descriptions should be cache line aligned to avoid sharing lines between threads");
+
+        pool.ParallelFor(count, grainSize, [&](UINT64 begin, UINT64 end) {
+            PackInstanceDescs(src, begin, end - begin, pDest);
+        });
+    }
+
+} // namespace DXR
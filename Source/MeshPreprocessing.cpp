@@ -0,0 +1,323 @@
+#include "DXRay/MeshPreprocessing.h"
+#include "DXRay/Internal.h"
+
+#include <bit>
+#include <cmath>
+
+namespace DXR
+{
+    namespace
+    {
+        using Internal::HashCombine;
+        using Internal::MortonCode;
+
+        constexpr UINT32 NoVertex = UINT32_MAX;
+
+        XMFLOAT3 LoadPosition(const MeshInput& mesh, UINT32 index)
+        {
+            XMFLOAT3 position;
+            memcpy(&position, reinterpret_cast<const BYTE*>(mesh.pPositions) + UINT64(index) * mesh.PositionStride,
+                   sizeof(XMFLOAT3));
+
+            // Adding zero turns -0 into +0, so both weld
+            return {position.x + 0.0f, position.y + 0.0f, position.z + 0.0f};
+        }
+
+        UINT64 CellKey(INT32 x, INT32 y, INT32 z)
+        {
+            return HashCombine(HashCombine(static_cast<UINT32>(x), static_cast<UINT32>(y)), static_cast<UINT32>(z));
+        }
+
+        float DistanceSquared(const XMFLOAT3& a, const XMFLOAT3& b)
+        {
+            float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        /// @brief Weld the vertices of a mesh with a hash grid.
+        /// @param remap Receives the welded vertex of each input vertex.
+        /// @return The input vertex of each welded vertex.
+        std::vector<UINT32> WeldVertices(const MeshInput& mesh, float tolerance, std::vector<UINT32>& remap)
+        {
+            std::vector<UINT32> welded = {};
+            std::vector<XMFLOAT3> positions = {};
+            std::vector<UINT32> next = {};
+            std::unordered_map<UINT64, UINT32> cells = {};
+
+            welded.reserve(mesh.VertexCount);
+            positions.reserve(mesh.VertexCount);
+            next.reserve(mesh.VertexCount);
+            cells.reserve(mesh.VertexCount);
+            remap.resize(mesh.VertexCount);
+
+            auto add = [&](UINT32 vertex, const XMFLOAT3& position, UINT64 key) {
+                UINT32 index = static_cast<UINT32>(welded.size());
+                auto [head, inserted] = cells.try_emplace(key, NoVertex);
+
+                welded.push_back(vertex);
+                positions.push_back(position);
+                next.push_back(head->second);
+                head->second = index;
+
+                return index;
+            };
+
+            auto find = [&](UINT64 key, auto&& matches) {
+                auto head = cells.find(key);
+                if (head == cells.end())
+                    return NoVertex;
+
+                for (UINT32 i = head->second; i != NoVertex; i = next[i])
+                {
+                    if (matches(positions[i]))
+                        return i;
+                }
+
+                return NoVertex;
+            };
+
+            if (tolerance <= 0.0f)
+            {
+                // Exact welding, the cell is the bit pattern of the position
+                for (UINT32 v = 0; v < mesh.VertexCount; v++)
+                {
+                    XMFLOAT3 p = LoadPosition(mesh, v);
+                    UINT64 key =
+                        CellKey(std::bit_cast<INT32>(p.x), std::bit_cast<INT32>(p.y), std::bit_cast<INT32>(p.z));
+
+                    UINT32 index = find(key, [&](const XMFLOAT3& q) { return p.x == q.x && p.y == q.y && p.z == q.z; });
+                    remap[v] = index != NoVertex ? index : add(v, p, key);
+                }
+
+                return welded;
+            }
+
+            // Vertices within the tolerance are at most one cell apart
+            const float invCellSize = 1.0f / tolerance;
+            const float toleranceSquared = tolerance * tolerance;
+
+            for (UINT32 v = 0; v < mesh.VertexCount; v++)
+            {
+                XMFLOAT3 p = LoadPosition(mesh, v);
+                INT32 cx = static_cast<INT32>(std::floor(p.x * invCellSize));
+                INT32 cy = static_cast<INT32>(std::floor(p.y * invCellSize));
+                INT32 cz = static_cast<INT32>(std::floor(p.z * invCellSize));
+
+                UINT32 index = NoVertex;
+                auto matches = [&](const XMFLOAT3& q) { return DistanceSquared(p, q) <= toleranceSquared; };
+
+                for (INT32 dz = -1; dz <= 1 && index == NoVertex; dz++)
+                {
+                    for (INT32 dy = -1; dy <= 1 && index == NoVertex; dy++)
+                    {
+                        for (INT32 dx = -1; dx <= 1 && index == NoVertex; dx++)
+                        {
+                            index = find(CellKey(cx + dx, cy + dy, cz + dz), matches);
+                        }
+                    }
+                }
+
+                remap[v] = index != NoVertex ? index : add(v, p, CellKey(cx, cy, cz));
+            }
+
+            return welded;
+        }
+    } // namespace
+
+    D3D12_RAYTRACING_GEOMETRY_DESC PreprocessedMesh::GetGeometryDesc(D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer,
+                                                                     D3D12_GPU_VIRTUAL_ADDRESS indexBuffer,
+                                                                     D3D12_RAYTRACING_GEOMETRY_FLAGS flags) const
+    {
+        D3D12_RAYTRACING_GEOMETRY_DESC desc = {};
+        desc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+        desc.Flags = flags;
+        desc.Triangles.Transform3x4 = 0;
+        desc.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
+        desc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+        desc.Triangles.IndexCount = static_cast<UINT>(Indices.size());
+        desc.Triangles.VertexCount = static_cast<UINT>(Vertices.size());
+        desc.Triangles.IndexBuffer = indexBuffer;
+        desc.Triangles.VertexBuffer.StartAddress = vertexBuffer;
+        desc.Triangles.VertexBuffer.StrideInBytes = sizeof(XMFLOAT3);
+        return desc;
+    }
+
+    PreprocessedMesh PreprocessMesh(const MeshInput& mesh, const MeshPreprocessOptions& options)
+    {
+        DXR_ASSERT(mesh.pPositions != nullptr, "Mesh has no positions");
+
+        PreprocessedMesh result = {};
+
+        const UINT32 indexCount = mesh.pIndices != nullptr ? mesh.IndexCount : mesh.VertexCount;
+        const UINT32 triangleCount = indexCount / 3;
+
+        result.Stats.InputVertices = mesh.VertexCount;
+        result.Stats.InputTriangles = triangleCount;
+
+        std::vector<UINT32> remap = {};
+        std::vector<UINT32> welded = WeldVertices(mesh, options.WeldTolerance, remap);
+
+        // The triangles that are kept, with welded indices
+        std::vector<UINT32> indices = {};
+        indices.reserve(UINT64(triangleCount) * 3);
+
+        // The input triangle each kept triangle came from
+        std::vector<UINT32> triangles = {};
+        triangles.reserve(triangleCount);
+
+        const float maxCrossSquared = 4.0f * options.MinTriangleArea * options.MinTriangleArea;
+
+        for (UINT32 t = 0; t < triangleCount; t++)
+        {
+            UINT32 tri[3];
+            for (UINT32 i = 0; i < 3; i++)
+            {
+                UINT32 index = mesh.pIndices != nullptr ? mesh.pIndices[t * 3 + i] : t * 3 + i;
+                DXR_ASSERT(index < mesh.VertexCount, "Index out of range");
+                tri[i] = remap[index];
+            }
+
+            if (options.RemoveDegenerates)
+            {
+                if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+                {
+                    result.Stats.DegenerateTriangles++;
+                    continue;
+                }
+
+                // Twice the area is the length of the cross product of two edges
+                XMFLOAT3 a = LoadPosition(mesh, welded[tri[0]]);
+                XMFLOAT3 b = LoadPosition(mesh, welded[tri[1]]);
+                XMFLOAT3 c = LoadPosition(mesh, welded[tri[2]]);
+
+                float e0x = b.x - a.x, e0y = b.y - a.y, e0z = b.z - a.z;
+                float e1x = c.x - a.x, e1y = c.y - a.y, e1z = c.z - a.z;
+
+                float cx = e0y * e1z - e0z * e1y;
+                float cy = e0z * e1x - e0x * e1z;
+                float cz = e0x * e1y - e0y * e1x;
+                float crossSquared = cx * cx + cy * cy + cz * cz;
+
+                if (crossSquared <= maxCrossSquared)
+                {
+                    result.Stats.ZeroAreaTriangles++;
+                    continue;
+                }
+            }
+
+            indices.insert(indices.end(), tri, tri + 3);
+            triangles.push_back(t);
+        }
+
+        const UINT32 keptTriangles = static_cast<UINT32>(indices.size() / 3);
+
+        if (options.ReorderTriangles && keptTriangles > 1)
+        {
+            // Centroids are kept as sums of the 3 vertices, the scale doesn't matter after normalizing
+            std::vector<XMFLOAT3> centroids(keptTriangles);
+            XMFLOAT3 boundsMin = {FLT_MAX, FLT_MAX, FLT_MAX};
+            XMFLOAT3 boundsMax = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+            for (UINT32 t = 0; t < keptTriangles; t++)
+            {
+                XMFLOAT3 centroid = {};
+                for (UINT32 i = 0; i < 3; i++)
+                {
+                    XMFLOAT3 p = LoadPosition(mesh, welded[indices[t * 3 + i]]);
+                    centroid = {centroid.x + p.x, centroid.y + p.y, centroid.z + p.z};
+                }
+
+                centroids[t] = centroid;
+                boundsMin = {std::min(boundsMin.x, centroid.x), std::min(boundsMin.y, centroid.y),
+                             std::min(boundsMin.z, centroid.z)};
+                boundsMax = {std::max(boundsMax.x, centroid.x), std::max(boundsMax.y, centroid.y),
+                             std::max(boundsMax.z, centroid.z)};
+            }
+
+            // Normalize to the bounds, flat axes stay at 0
+            auto inverse = [](float extent) { return extent > 0.0f ? 1.0f / extent : 0.0f; };
+            XMFLOAT3 scale = {inverse(boundsMax.x - boundsMin.x), inverse(boundsMax.y - boundsMin.y),
+                              inverse(boundsMax.z - boundsMin.z)};
+
+            std::vector<std::pair<UINT32, UINT32>> order(keptTriangles);
+
+            for (UINT32 t = 0; t < keptTriangles; t++)
+            {
+                const XMFLOAT3& c = centroids[t];
+                order[t] = {MortonCode((c.x - boundsMin.x) * scale.x, (c.y - boundsMin.y) * scale.y,
+                                       (c.z - boundsMin.z) * scale.z),
+                            t};
+            }
+
+            std::sort(order.begin(), order.end());
+
+            std::vector<UINT32> sorted(indices.size());
+            std::vector<UINT32> sortedTriangles(keptTriangles);
+            for (UINT32 t = 0; t < keptTriangles; t++)
+            {
+                memcpy(&sorted[t * 3], &indices[order[t].second * 3], 3 * sizeof(UINT32));
+                sortedTriangles[t] = triangles[order[t].second];
+            }
+
+            indices.swap(sorted);
+            triangles.swap(sortedTriangles);
+        }
+
+        // Drop vertices that are no longer used. When reordering, vertices are numbered by first use, so the vertices
+        // of nearby triangles are nearby too, otherwise they keep their order.
+        std::vector<UINT32> newIndex(welded.size(), NoVertex);
+        UINT32 outputVertices = 0;
+
+        if (options.ReorderTriangles)
+        {
+            for (UINT32 index : indices)
+            {
+                if (newIndex[index] == NoVertex)
+                    newIndex[index] = outputVertices++;
+            }
+        }
+        else
+        {
+            for (UINT32 index : indices) { newIndex[index] = 0; }
+            for (UINT32& index : newIndex)
+            {
+                if (index != NoVertex)
+                    index = outputVertices++;
+            }
+        }
+
+        result.Vertices.resize(outputVertices);
+        result.SourceVertices.resize(outputVertices);
+
+        for (UINT32 v = 0; v < welded.size(); v++)
+        {
+            if (newIndex[v] == NoVertex)
+                continue;
+
+            result.Vertices[newIndex[v]] = LoadPosition(mesh, welded[v]);
+            result.SourceVertices[newIndex[v]] = welded[v];
+        }
+
+        for (UINT32& index : indices) { index = newIndex[index]; }
+        result.Indices = std::move(indices);
+        result.SourceTriangles = std::move(triangles);
+
+        result.Stats.OutputVertices = outputVertices;
+        result.Stats.OutputTriangles = keptTriangles;
+
+        return result;
+    }
+
+    std::vector<PreprocessedMesh> PreprocessMeshes(TaskPool& pool, std::span<const MeshInput> meshes,
+                                                   const MeshPreprocessOptions& options)
+    {
+        std::vector<PreprocessedMesh> results(meshes.size());
+
+        pool.ParallelFor(meshes.size(), 1, [&](UINT64 begin, UINT64 end) {
+            for (UINT64 i = begin; i < end; i++) { results[i] = PreprocessMesh(meshes[i], options); }
+        });
+
+        return results;
+    }
+
+} // namespace DXR
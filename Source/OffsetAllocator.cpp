@@ -0,0 +1,296 @@
+#include "DXRay/OffsetAllocator.h"
+
+#include <bit>
+
+namespace DXR
+{
+    namespace
+    {
+        // Sizes are binned by a floating point number with a 3 bit mantissa and a 5 bit exponent, so the bins grow
+        // exponentially and each power of two is split into 8 bins
+        constexpr UINT32 MantissaBits = 3;
+        constexpr UINT32 MantissaValue = 1 << MantissaBits;
+        constexpr UINT32 MantissaMask = MantissaValue - 1;
+
+        constexpr UINT32 NoSpace = UINT32_MAX;
+
+        /// @brief Get the bin of an allocation, the first bin whose ranges are all large enough.
+        UINT32 SizeToBinRoundUp(UINT32 size)
+        {
+            if (size < MantissaValue)
+                return size;
+
+            UINT32 mantissaStartBit = (31 - std::countl_zero(size)) - MantissaBits;
+            UINT32 exponent = mantissaStartBit + 1;
+            UINT32 mantissa = (size >> mantissaStartBit) & MantissaMask;
+
+            if ((size & ((1u << mantissaStartBit) - 1)) != 0)
+                mantissa++;
+
+            // The mantissa can carry into the exponent
+            return (exponent << MantissaBits) + mantissa;
+        }
+
+        /// @brief Get the bin of a free range, the last bin whose size fits in the range.
+        UINT32 SizeToBinRoundDown(UINT32 size)
+        {
+            if (size < MantissaValue)
+                return size;
+
+            UINT32 mantissaStartBit = (31 - std::countl_zero(size)) - MantissaBits;
+            UINT32 exponent = mantissaStartBit + 1;
+            UINT32 mantissa = (size >> mantissaStartBit) & MantissaMask;
+
+            return (exponent << MantissaBits) | mantissa;
+        }
+
+        /// @brief Get the smallest size of a bin.
+        UINT32 BinToSize(UINT32 bin)
+        {
+            UINT32 exponent = bin >> MantissaBits;
+            UINT32 mantissa = bin & MantissaMask;
+
+            if (exponent == 0)
+                return mantissa;
+
+            return (mantissa | MantissaValue) << (exponent - 1);
+        }
+
+        UINT32 FindLowestSetBitAfter(UINT32 mask, UINT32 startBit)
+        {
+            UINT64 masked = UINT64(mask) & ~((1ull << startBit) - 1);
+            return masked == 0 ? NoSpace : std::countr_zero(masked);
+        }
+    } // namespace
+
+    OffsetAllocator::OffsetAllocator(UINT64 size, UINT64 granularity, UINT32 maxAllocations)
+        : mGranularity(granularity), mMaxAllocations(maxAllocations)
+    {
+        DXR_ASSERT(granularity != 0 && (granularity & (granularity - 1)) == 0, "Granularity must be a power of two.");
+        DXR_ASSERT(size / granularity <= UINT32_MAX, "Size is too large for the granularity.");
+        DXR_ASSERT(maxAllocations > 0, "At least one allocation is needed.");
+
+        mSize = static_cast<UINT32>(size / granularity);
+        Reset();
+    }
+
+    OffsetAllocation OffsetAllocator::Allocate(UINT64 size)
+    {
+        UINT64 units = std::max<UINT64>((size + mGranularity - 1) / mGranularity, 1);
+
+        // The remainder of the range needs a node of its own
+        if (units > mFreeStorage || mFreeNodes.empty())
+            return {};
+
+        UINT32 minBin = SizeToBinRoundUp(static_cast<UINT32>(units));
+        UINT32 minTopBin = minBin >> TopBinsIndexShift;
+        UINT32 minLeafBin = minBin & LeafBinsIndexMask;
+
+        UINT32 topBin = minTopBin;
+        UINT32 leafBin = NoSpace;
+
+        if (mUsedBinsTop & (1u << topBin))
+            leafBin = FindLowestSetBitAfter(mUsedBins[topBin], minLeafBin);
+
+        // All ranges of the next top bins are large enough
+        if (leafBin == NoSpace)
+        {
+            topBin = FindLowestSetBitAfter(mUsedBinsTop, minTopBin + 1);
+            if (topBin == NoSpace)
+                return {};
+
+            leafBin = std::countr_zero(static_cast<UINT32>(mUsedBins[topBin]));
+        }
+
+        UINT32 bin = (topBin << TopBinsIndexShift) | leafBin;
+
+        UINT32 nodeIndex = mBinIndices[bin];
+        Node& node = mNodes[nodeIndex];
+        UINT32 nodeSize = node.DataSize;
+
+        node.DataSize = static_cast<UINT32>(units);
+        node.Used = true;
+
+        mBinIndices[bin] = node.BinListNext;
+        if (node.BinListNext != Node::Unused)
+            mNodes[node.BinListNext].BinListPrev = Node::Unused;
+
+        mFreeStorage -= nodeSize;
+
+        if (mBinIndices[bin] == Node::Unused)
+        {
+            mUsedBins[topBin] &= ~(1u << leafBin);
+            if (mUsedBins[topBin] == 0)
+                mUsedBinsTop &= ~(1u << topBin);
+        }
+
+        // Put the rest of the range back as a free range after the allocation
+        UINT32 remainder = nodeSize - node.DataSize;
+        if (remainder > 0)
+        {
+            UINT32 newNodeIndex = InternalInsertNodeIntoBin(remainder, node.DataOffset + node.DataSize);
+
+            if (node.NeighborNext != Node::Unused)
+                mNodes[node.NeighborNext].NeighborPrev = newNodeIndex;
+
+            mNodes[newNodeIndex].NeighborPrev = nodeIndex;
+            mNodes[newNodeIndex].NeighborNext = node.NeighborNext;
+            node.NeighborNext = newNodeIndex;
+        }
+
+        mNumAllocations++;
+
+        return {UINT64(node.DataOffset) * mGranularity, nodeIndex};
+    }
+
+    void OffsetAllocator::Free(OffsetAllocation allocation)
+    {
+        if (!allocation.IsValid())
+            return;
+
+        DXR_ASSERT(allocation.Node < mNodes.size() && mNodes[allocation.Node].Used, "Allocation is not allocated.");
+
+        Node& node = mNodes[allocation.Node];
+        UINT32 offset = node.DataOffset;
+        UINT32 size = node.DataSize;
+
+        // Merge with the free ranges before and after it
+        if (node.NeighborPrev != Node::Unused && !mNodes[node.NeighborPrev].Used)
+        {
+            Node prev = mNodes[node.NeighborPrev];
+            offset = prev.DataOffset;
+            size += prev.DataSize;
+
+            InternalRemoveNodeFromBin(node.NeighborPrev);
+            node.NeighborPrev = prev.NeighborPrev;
+        }
+
+        if (node.NeighborNext != Node::Unused && !mNodes[node.NeighborNext].Used)
+        {
+            Node next = mNodes[node.NeighborNext];
+            size += next.DataSize;
+
+            InternalRemoveNodeFromBin(node.NeighborNext);
+            node.NeighborNext = next.NeighborNext;
+        }
+
+        UINT32 neighborPrev = node.NeighborPrev;
+        UINT32 neighborNext = node.NeighborNext;
+
+        mFreeNodes.push_back(allocation.Node);
+        mNumAllocations--;
+
+        UINT32 mergedNodeIndex = InternalInsertNodeIntoBin(size, offset);
+
+        if (neighborPrev != Node::Unused)
+        {
+            mNodes[mergedNodeIndex].NeighborPrev = neighborPrev;
+            mNodes[neighborPrev].NeighborNext = mergedNodeIndex;
+        }
+
+        if (neighborNext != Node::Unused)
+        {
+            mNodes[mergedNodeIndex].NeighborNext = neighborNext;
+            mNodes[neighborNext].NeighborPrev = mergedNodeIndex;
+        }
+    }
+
+    void OffsetAllocator::Reset()
+    {
+        mFreeStorage = 0;
+        mNumAllocations = 0;
+        mUsedBinsTop = 0;
+
+        std::fill(std::begin(mUsedBins), std::end(mUsedBins), UINT8(0));
+        std::fill(std::begin(mBinIndices), std::end(mBinIndices), Node::Unused);
+
+        mNodes.assign(mMaxAllocations, Node {});
+
+        // Pop from the back, so the nodes are used from the front
+        mFreeNodes.resize(mMaxAllocations);
+        for (UINT32 i = 0; i < mMaxAllocations; i++) { mFreeNodes[i] = mMaxAllocations - i - 1; }
+
+        if (mSize > 0)
+            InternalInsertNodeIntoBin(mSize, 0);
+    }
+
+    UINT64 OffsetAllocator::GetAllocationSize(OffsetAllocation allocation) const
+    {
+        if (!allocation.IsValid())
+            return 0;
+
+        return UINT64(mNodes[allocation.Node].DataSize) * mGranularity;
+    }
+
+    UINT64 OffsetAllocator::GetLargestFreeRange() const
+    {
+        if (mUsedBinsTop == 0)
+            return 0;
+
+        UINT32 topBin = 31 - std::countl_zero(mUsedBinsTop);
+        UINT32 leafBin = 31 - std::countl_zero(static_cast<UINT32>(mUsedBins[topBin]));
+
+        return UINT64(BinToSize((topBin << TopBinsIndexShift) | leafBin)) * mGranularity;
+    }
+
+    UINT32 OffsetAllocator::InternalInsertNodeIntoBin(UINT32 size, UINT32 offset)
+    {
+        UINT32 bin = SizeToBinRoundDown(size);
+        UINT32 topBin = bin >> TopBinsIndexShift;
+        UINT32 leafBin = bin & LeafBinsIndexMask;
+
+        if (mBinIndices[bin] == Node::Unused)
+        {
+            mUsedBins[topBin] |= 1u << leafBin;
+            mUsedBinsTop |= 1u << topBin;
+        }
+
+        UINT32 headIndex = mBinIndices[bin];
+        UINT32 nodeIndex = mFreeNodes.back();
+        mFreeNodes.pop_back();
+
+        mNodes[nodeIndex] = Node {.DataOffset = offset, .DataSize = size, .BinListNext = headIndex};
+
+        if (headIndex != Node::Unused)
+            mNodes[headIndex].BinListPrev = nodeIndex;
+
+        mBinIndices[bin] = nodeIndex;
+        mFreeStorage += size;
+
+        return nodeIndex;
+    }
+
+    void OffsetAllocator::InternalRemoveNodeFromBin(UINT32 nodeIndex)
+    {
+        const Node& node = mNodes[nodeIndex];
+
+        if (node.BinListPrev != Node::Unused)
+        {
+            mNodes[node.BinListPrev].BinListNext = node.BinListNext;
+            if (node.BinListNext != Node::Unused)
+                mNodes[node.BinListNext].BinListPrev = node.BinListPrev;
+        }
+        else
+        {
+            // The node is the head of its bin
+            UINT32 bin = SizeToBinRoundDown(node.DataSize);
+            UINT32 topBin = bin >> TopBinsIndexShift;
+            UINT32 leafBin = bin & LeafBinsIndexMask;
+
+            mBinIndices[bin] = node.BinListNext;
+            if (node.BinListNext != Node::Unused)
+                mNodes[node.BinListNext].BinListPrev = Node::Unused;
+
+            if (mBinIndices[bin] == Node::Unused)
+            {
+                mUsedBins[topBin] &= ~(1u << leafBin);
+                if (mUsedBins[topBin] == 0)
+                    mUsedBinsTop &= ~(1u << topBin);
+            }
+        }
+
+        mFreeStorage -= node.DataSize;
+        mFreeNodes.push_back(nodeIndex);
+    }
+
+} // namespace DXR
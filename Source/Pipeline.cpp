@@ -2,21 +2,100 @@
 
 namespace DXR
 {
+    namespace
+    {
+        /// @brief Counts an asynchronous task of a device until it finishes, also if it throws.
+        class PendingTaskScope
+        {
+        public:
+            explicit PendingTaskScope(std::atomic<UINT32>& counter) : mCounter(counter) {}
+            ~PendingTaskScope() { mCounter.fetch_sub(1, std::memory_order_release); }
+
+        private:
+            std::atomic<UINT32>& mCounter;
+        };
+    } // namespace
+
     ComPtr<ID3D12StateObject> Device::CreatePipeline(CD3DX12_STATE_OBJECT_DESC& desc)
     {
-        ComPtr<ID3D12StateObject> pipeline;
-        DXR_THROW_FAILED(mDevice->CreateStateObject(desc, IID_PPV_ARGS(&pipeline)));
+        const D3D12_STATE_OBJECT_DESC& stateObjectDesc = desc;
 
-        return pipeline;
+        return mStateObjectCache.GetOrCreate(stateObjectDesc, nullptr, [&]() {
+            ComPtr<ID3D12StateObject> pipeline;
+            DXR_THROW_FAILED(mDevice->CreateStateObject(&stateObjectDesc, IID_PPV_ARGS(&pipeline)));
+            return pipeline;
+        });
     }
 
     ComPtr<ID3D12StateObject> Device::ExpandPipeline(CD3DX12_STATE_OBJECT_DESC& desc,
                                                      ComPtr<ID3D12StateObject>& pipeline,
                                                      ComPtr<ID3D12StateObject>& collection)
     {
-        ComPtr<ID3D12StateObject> expandedPipeline;
-        DXR_THROW_FAILED(mDevice->AddToStateObject(desc, collection.Get(), IID_PPV_ARGS(&expandedPipeline)));
+        const D3D12_STATE_OBJECT_DESC& stateObjectDesc = desc;
+
+        auto expandedPipeline = mStateObjectCache.GetOrCreate(stateObjectDesc, pipeline.Get(), [&]() {
+            ComPtr<ID3D12StateObject> expanded;
+            DXR_THROW_FAILED(mDevice->AddToStateObject(&stateObjectDesc, pipeline.Get(), IID_PPV_ARGS(&expanded)));
+            return expanded;
+        });
+
+        // Existing exports keep their identifiers, so the expanded pipeline can use the ones already cached
+        mShaderIdentifierCache.RegisterExpandedPipeline(expandedPipeline.Get(), pipeline.Get());
+
         return expandedPipeline;
     }
 
+    std::future<ComPtr<ID3D12StateObject>> Device::CreatePipelineAsync(StateObjectBuilder builder)
+    {
+        mPendingAsyncTasks.fetch_add(1, std::memory_order_relaxed);
+
+        return GetTaskPool()->Submit([this, builder = std::move(builder)]() {
+            PendingTaskScope scope(mPendingAsyncTasks);
+
+            CD3DX12_STATE_OBJECT_DESC desc(D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE);
+            builder(desc);
+            return CreatePipeline(desc);
+        });
+    }
+
+    std::future<ComPtr<ID3D12StateObject>> Device::CreateCollectionAsync(StateObjectBuilder builder)
+    {
+        mPendingAsyncTasks.fetch_add(1, std::memory_order_relaxed);
+
+        return GetTaskPool()->Submit([this, builder = std::move(builder)]() {
+            PendingTaskScope scope(mPendingAsyncTasks);
+
+            CD3DX12_STATE_OBJECT_DESC desc(D3D12_STATE_OBJECT_TYPE_COLLECTION);
+            builder(desc);
+            return CreatePipeline(desc);
+        });
+    }
+
+    ComPtr<ID3D12StateObject> Device::LinkCollections(ComPtr<ID3D12StateObject>& pipeline,
+                                                      std::span<std::future<ComPtr<ID3D12StateObject>>> collections)
+    {
+        DXR_ASSERT(!collections.empty(), "No collections to link");
+
+        auto pool = GetTaskPool();
+
+        CD3DX12_STATE_OBJECT_DESC desc(D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE);
+        std::vector<ComPtr<ID3D12StateObject>> finished;
+        finished.reserve(collections.size());
+
+        for (auto& future : collections)
+        {
+            // Compile other collections on this thread instead of only waiting for this one
+            finished.push_back(pool->Wait(future));
+
+            auto existingCollection = desc.CreateSubobject<CD3DX12_EXISTING_COLLECTION_SUBOBJECT>();
+            existingCollection->SetExistingCollection(finished.back().Get());
+        }
+
+        // Keep allowing additions, so more collections can be linked later
+        auto config = desc.CreateSubobject<CD3DX12_STATE_OBJECT_CONFIG_SUBOBJECT>();
+        config->SetFlags(D3D12_STATE_OBJECT_FLAG_ALLOW_STATE_OBJECT_ADDITION);
+
+        return ExpandPipeline(desc, pipeline, finished.back());
+    }
+
 } // namespace DXR
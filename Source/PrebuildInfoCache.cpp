@@ -0,0 +1,139 @@
+#include "DXRay/PrebuildInfoCache.h"
+#include "DXRay/Internal.h"
+
+namespace DXR
+{
+    namespace
+    {
+        using Internal::HashCombine;
+
+        /// @brief Append the sizing-relevant fields of a geometry to a signature.
+        /// @return False if the type of the geometry is not supported.
+        bool AppendGeometry(const D3D12_RAYTRACING_GEOMETRY_DESC& geometry, std::vector<UINT64>& signature)
+        {
+            signature.push_back(geometry.Type);
+            signature.push_back(geometry.Flags);
+
+            switch (geometry.Type)
+            {
+            case D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES: {
+                auto& triangles = geometry.Triangles;
+
+                // Only whether there is a transform matters, not where it is
+                signature.push_back(triangles.Transform3x4 != 0);
+                signature.push_back(triangles.IndexFormat);
+                signature.push_back(triangles.VertexFormat);
+                signature.push_back(triangles.IndexCount);
+                signature.push_back(triangles.VertexCount);
+                return true;
+            }
+            case D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS: {
+                signature.push_back(geometry.AABBs.AABBCount);
+                return true;
+            }
+
+            // Newer geometry types have sizing-relevant data behind pointers, query them every time
+            default: return false;
+            }
+        }
+
+        /// @brief Get the sizing-relevant fields of build inputs, see HashPrebuildInputs(...).
+        /// @return False if the inputs have geometry types that are not supported.
+        bool GetSignature(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs,
+                          std::vector<UINT64>& signature)
+        {
+            signature.clear();
+            signature.push_back(inputs.Type);
+            signature.push_back(inputs.Flags);
+            signature.push_back(inputs.NumDescs);
+
+            if (inputs.Type == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL)
+            {
+                // Geometries are appended in order, their order decides the geometry indices of the BLAS
+                for (UINT i = 0; i < inputs.NumDescs; i++)
+                {
+                    const D3D12_RAYTRACING_GEOMETRY_DESC& geometry =
+                        inputs.DescsLayout == D3D12_ELEMENTS_LAYOUT_ARRAY ? inputs.pGeometryDescs[i]
+                                                                          : *inputs.ppGeometryDescs[i];
+
+                    if (!AppendGeometry(geometry, signature))
+                        return false;
+                }
+            }
+
+            return true;
+        }
+
+        UINT64 HashSignature(const std::vector<UINT64>& signature)
+        {
+            UINT64 hash = 0;
+            for (UINT64 value : signature) { hash = HashCombine(hash, value); }
+
+            // 0 means the inputs can't be hashed
+            return hash == 0 ? 1 : hash;
+        }
+    } // namespace
+
+    UINT64 HashPrebuildInputs(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs)
+    {
+        std::vector<UINT64> signature = {};
+        return GetSignature(inputs, signature) ? HashSignature(signature) : 0;
+    }
+
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO PrebuildInfoCache::GetOrQuery(
+        const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs,
+        const std::function<void(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO&)>& query)
+    {
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO info = {};
+
+        std::vector<UINT64> signature = {};
+        if (!GetSignature(inputs, signature))
+        {
+            mUncacheable++;
+            query(info);
+            return info;
+        }
+
+        UINT64 hash = HashSignature(signature);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            // Signatures with the same hash are told apart by their fields
+            auto [begin, end] = mEntries.equal_range(hash);
+            for (auto entry = begin; entry != end; ++entry)
+            {
+                if (entry->second.Signature == signature)
+                {
+                    mHits++;
+                    return entry->second.PrebuildInfo;
+                }
+            }
+        }
+
+        // Query outside of the lock, two threads with the same signature at once both query, which is harmless
+        query(info);
+        mMisses++;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto [begin, end] = mEntries.equal_range(hash);
+        if (std::none_of(begin, end, [&](auto& entry) { return entry.second.Signature == signature; }))
+            mEntries.emplace(hash, Entry {std::move(signature), info});
+
+        return info;
+    }
+
+    void PrebuildInfoCache::Clear()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEntries.clear();
+    }
+
+    size_t PrebuildInfoCache::GetSize()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mEntries.size();
+    }
+
+} // namespace DXR
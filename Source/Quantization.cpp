@@ -0,0 +1,193 @@
+#include "DXRay/Quantization.h"
+
+#include <cmath>
+
+namespace DXR
+{
+    namespace
+    {
+        constexpr float SnormMax = 32767.0f;
+
+        INT16 EncodeSnorm16(float value)
+        {
+            return static_cast<INT16>(std::lround(std::clamp(value, -1.0f, 1.0f) * SnormMax));
+        }
+
+        float DecodeSnorm16(INT16 value)
+        {
+            // -32768 and -32767 both decode to -1
+            return std::max(static_cast<float>(value) / SnormMax, -1.0f);
+        }
+
+        float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+        {
+            float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+            return std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+
+        /// @brief Quantize vertices to 16-bit SNORM in their bounding box.
+        /// @return The largest distance between an original and a dequantized vertex.
+        float QuantizeVertices(std::span<const XMFLOAT3> vertices, QuantizedMesh& mesh)
+        {
+            XMFLOAT3 boundsMin = {FLT_MAX, FLT_MAX, FLT_MAX};
+            XMFLOAT3 boundsMax = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+            for (const XMFLOAT3& v : vertices)
+            {
+                boundsMin = {std::min(boundsMin.x, v.x), std::min(boundsMin.y, v.y), std::min(boundsMin.z, v.z)};
+                boundsMax = {std::max(boundsMax.x, v.x), std::max(boundsMax.y, v.y), std::max(boundsMax.z, v.z)};
+            }
+
+            // The box is mapped to [-1, 1], flat axes keep a scale of 1 so they don't divide by 0
+            float center[3] = {(boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f,
+                               (boundsMin.z + boundsMax.z) * 0.5f};
+            float scale[3] = {(boundsMax.x - boundsMin.x) * 0.5f, (boundsMax.y - boundsMin.y) * 0.5f,
+                              (boundsMax.z - boundsMin.z) * 0.5f};
+
+            for (float& s : scale)
+            {
+                if (s <= 0.0f)
+                    s = 1.0f;
+            }
+
+            mesh.Transform = {};
+            for (UINT32 axis = 0; axis < 3; axis++)
+            {
+                mesh.Transform.m[axis][axis] = scale[axis];
+                mesh.Transform.m[axis][3] = center[axis];
+            }
+
+            mesh.VertexFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
+            mesh.VertexStride = 4 * sizeof(INT16);
+            mesh.VertexData.resize(vertices.size() * mesh.VertexStride);
+
+            INT16* pDest = reinterpret_cast<INT16*>(mesh.VertexData.data());
+            float maxError = 0.0f;
+
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                const float* p = &vertices[i].x;
+
+                // The builder ignores W
+                for (UINT32 axis = 0; axis < 3; axis++)
+                {
+                    pDest[i * 4 + axis] = EncodeSnorm16((p[axis] - center[axis]) / scale[axis]);
+                }
+                pDest[i * 4 + 3] = 0;
+
+                maxError = std::max(maxError, Distance(vertices[i], mesh.GetPosition(static_cast<UINT32>(i))));
+            }
+
+            return maxError;
+        }
+    } // namespace
+
+    D3D12_RAYTRACING_GEOMETRY_DESC QuantizedMesh::GetGeometryDesc(D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer,
+                                                                  D3D12_GPU_VIRTUAL_ADDRESS indexBuffer,
+                                                                  D3D12_GPU_VIRTUAL_ADDRESS transform,
+                                                                  D3D12_RAYTRACING_GEOMETRY_FLAGS flags) const
+    {
+        DXR_ASSERT(!HasTransform() || transform % D3D12_RAYTRACING_TRANSFORM3X4_BYTE_ALIGNMENT == 0,
+                   "Transform is not aligned");
+
+        D3D12_RAYTRACING_GEOMETRY_DESC desc = {};
+        desc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+        desc.Flags = flags;
+        desc.Triangles.Transform3x4 = HasTransform() ? transform : 0;
+        desc.Triangles.IndexFormat = IndexFormat;
+        desc.Triangles.VertexFormat = VertexFormat;
+        desc.Triangles.IndexCount = IndexCount;
+        desc.Triangles.VertexCount = VertexCount;
+        desc.Triangles.IndexBuffer = indexBuffer;
+        desc.Triangles.VertexBuffer.StartAddress = vertexBuffer;
+        desc.Triangles.VertexBuffer.StrideInBytes = VertexStride;
+        return desc;
+    }
+
+    XMFLOAT3 QuantizedMesh::GetPosition(UINT32 index) const
+    {
+        DXR_ASSERT(index < VertexCount, "Vertex out of range");
+
+        if (!HasTransform())
+        {
+            XMFLOAT3 position;
+            memcpy(&position, VertexData.data() + UINT64(index) * VertexStride, sizeof(XMFLOAT3));
+            return position;
+        }
+
+        const INT16* pSource = reinterpret_cast<const INT16*>(VertexData.data() + UINT64(index) * VertexStride);
+        float q[3] = {DecodeSnorm16(pSource[0]), DecodeSnorm16(pSource[1]), DecodeSnorm16(pSource[2])};
+
+        float p[3];
+        for (UINT32 row = 0; row < 3; row++)
+        {
+            const float* m = Transform.m[row];
+            p[row] = m[0] * q[0] + m[1] * q[1] + m[2] * q[2] + m[3];
+        }
+
+        return {p[0], p[1], p[2]};
+    }
+
+    QuantizedMesh QuantizeMesh(std::span<const XMFLOAT3> vertices, std::span<const UINT32> indices,
+                               const QuantizationOptions& options)
+    {
+        QuantizedMesh mesh = {};
+        mesh.VertexCount = static_cast<UINT32>(vertices.size());
+        mesh.IndexCount = static_cast<UINT32>(indices.size());
+
+        mesh.Stats.Meshes = 1;
+        mesh.Stats.OriginalSize = vertices.size_bytes() + indices.size_bytes();
+
+        // The transform costs 48 bytes, tiny meshes would grow
+        if (options.AllowVertex16 && vertices.size() * 4 > sizeof(XMFLOAT3X4))
+        {
+            float error = QuantizeVertices(vertices, mesh);
+
+            if (error <= options.MaxPositionError)
+            {
+                mesh.Stats.Vertex16Meshes = 1;
+                mesh.Stats.MaxPositionError = error;
+            }
+            else
+            {
+                mesh.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+                mesh.VertexStride = sizeof(XMFLOAT3);
+                mesh.Transform = {};
+            }
+        }
+
+        if (!mesh.HasTransform())
+        {
+            mesh.VertexData.resize(vertices.size_bytes());
+            memcpy(mesh.VertexData.data(), vertices.data(), vertices.size_bytes());
+        }
+
+        // Index 0xFFFF is a valid vertex for triangles, there is no strip cut
+        if (options.AllowIndex16 && vertices.size() <= 0x10000)
+        {
+            mesh.IndexFormat = DXGI_FORMAT_R16_UINT;
+            mesh.IndexData.resize(indices.size() * sizeof(UINT16));
+
+            UINT16* pDest = reinterpret_cast<UINT16*>(mesh.IndexData.data());
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                DXR_ASSERT(indices[i] < vertices.size(), "Index out of range");
+                pDest[i] = static_cast<UINT16>(indices[i]);
+            }
+
+            mesh.Stats.Index16Meshes = 1;
+        }
+        else
+        {
+            mesh.IndexData.resize(indices.size_bytes());
+            memcpy(mesh.IndexData.data(), indices.data(), indices.size_bytes());
+        }
+
+        mesh.Stats.QuantizedSize = mesh.VertexData.size() + mesh.IndexData.size();
+        if (mesh.HasTransform())
+            mesh.Stats.QuantizedSize += sizeof(XMFLOAT3X4);
+
+        return mesh;
+    }
+
+} // namespace DXR
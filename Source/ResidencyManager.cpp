@@ -0,0 +1,307 @@
+#include "DXRay/ResidencyManager.h"
+
+namespace DXR
+{
+    ResidencyManager::ResidencyManager(IDXRDevice* device, IDXRAdapter* adapter) : mDevice(device)
+    {
+        // Budgets need IDXGIAdapter3, without it nothing is evicted
+        if (adapter != nullptr && FAILED(adapter->QueryInterface(IID_PPV_ARGS(&mAdapter))))
+            mAdapter = nullptr;
+    }
+
+    ResidencyManager::~ResidencyManager()
+    {
+        // Resources that are still tracked are alive, otherwise their callback would have untracked them
+        for (auto& [resource, tracked] : mAllocations)
+        {
+            if (tracked.Context == nullptr)
+                continue;
+
+            ComPtr<ID3DDestructionNotifier> notifier = nullptr;
+            if (SUCCEEDED(resource->QueryInterface(IID_PPV_ARGS(&notifier))) && notifier != nullptr)
+                notifier->UnregisterDestructionCallback(tracked.CallbackId);
+        }
+    }
+
+    void ResidencyManager::TrackAllocation(MemoryCategory category, DMA::Allocation* allocation)
+    {
+        ID3D12Resource* resource = allocation->GetResource();
+        UINT64 size = allocation->GetSize();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // Without a destruction notification the allocation can't be accounted, it would never be subtracted
+        ComPtr<ID3DDestructionNotifier> notifier = nullptr;
+        if (FAILED(resource->QueryInterface(IID_PPV_ARGS(&notifier))) || notifier == nullptr)
+            return;
+
+        TrackedAllocation tracked = {category, size};
+        tracked.Context = std::make_unique<DestructionContext>(DestructionContext {this, resource});
+
+        if (FAILED(notifier->RegisterDestructionCallback(&OnResourceDestroyed, tracked.Context.get(),
+                                                         &tracked.CallbackId)))
+            return;
+
+        mCategoryUsage[static_cast<UINT32>(category)] += size;
+        mAllocations[resource] = std::move(tracked);
+    }
+
+    void ResidencyManager::TrackAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address, DMA::Allocation* allocation,
+                                                      UINT64 size)
+    {
+        // Residency is per heap, a placed resource can't be made resident or evicted on its own
+        ID3D12Heap* heap = allocation->GetHeap();
+        TrackAccelerationStructure(address, heap != nullptr ? static_cast<ID3D12Pageable*>(heap)
+                                                            : static_cast<ID3D12Pageable*>(allocation->GetResource()),
+                                   size);
+    }
+
+    void ResidencyManager::TrackAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address, ID3D12Pageable* pageable,
+                                                      UINT64 size)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        DXR_ASSERT(mEntries.find(address) == mEntries.end(), "Acceleration structure is tracked already");
+
+        PageableState& state = mPageables[pageable];
+        DXR_ASSERT(state.Entries == 0 || state.ResidentEntries > 0, "Pageable is evicted");
+
+        state.Entries++;
+        state.ResidentEntries++;
+
+        // New acceleration structures count as just referenced, they are about to be used
+        mLRU.push_back({address, pageable, size, mCurrentFrame, true});
+        mEntries[address] = std::prev(mLRU.end());
+        mResidentSize += size;
+    }
+
+    void ResidencyManager::UntrackAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        // Released after unlocking, if it is the last reference the destruction callback locks the mutex
+        ComPtr<ID3D12Pageable> pageable = nullptr;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto entry = mEntries.find(address);
+        if (entry == mEntries.end())
+            return;
+
+        pageable = std::move(entry->second->Pageable);
+
+        auto state = mPageables.find(pageable.Get());
+        state->second.Entries--;
+
+        if (entry->second->Resident)
+        {
+            mResidentSize -= entry->second->Size;
+
+            // The others in the pageable are evicted, it was only kept resident for this one
+            if (--state->second.ResidentEntries == 0 && state->second.Entries > 0)
+                mPendingEvict.push_back(std::move(pageable));
+        }
+
+        if (state->second.Entries == 0)
+            mPageables.erase(state);
+
+        mLRU.erase(entry->second);
+        mEntries.erase(entry);
+    }
+
+    void ResidencyManager::MarkReferenced(std::span<const D3D12_GPU_VIRTUAL_ADDRESS> addresses, UINT64 frame)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mCurrentFrame = std::max(mCurrentFrame, frame);
+
+        for (D3D12_GPU_VIRTUAL_ADDRESS address : addresses)
+        {
+            auto entry = mEntries.find(address);
+            if (entry == mEntries.end())
+                continue;
+
+            auto it = entry->second;
+
+            // Instances of the same BLAS are common, only the first one has to move it
+            if (it->LastFrame == frame && std::next(it) == mLRU.end())
+                continue;
+
+            if (!it->Resident && it->LastFrame != frame)
+                mPendingResident.push_back(address);
+
+            it->LastFrame = frame;
+            mLRU.splice(mLRU.end(), mLRU, it);
+        }
+    }
+
+    ResidencyUpdate ResidencyManager::Update(UINT64 frame)
+    {
+        ResidencyUpdate result = {};
+        std::vector<ComPtr<ID3D12Pageable>> evicted = {};
+        std::vector<ComPtr<ID3D12Pageable>> pendingEvict = {};
+        std::function<void(D3D12_GPU_VIRTUAL_ADDRESS)> callback = nullptr;
+        bool simulated = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mCurrentFrame = std::max(mCurrentFrame, frame);
+
+            // Referenced acceleration structures are needed this frame, restore them first in one batch
+            std::vector<ID3D12Pageable*> restored = {};
+
+            for (D3D12_GPU_VIRTUAL_ADDRESS address : mPendingResident)
+            {
+                auto entry = mEntries.find(address);
+                if (entry == mEntries.end() || entry->second->Resident)
+                    continue;
+
+                entry->second->Resident = true;
+                mResidentSize += entry->second->Size;
+                result.MadeResident.push_back(address);
+
+                // A pageable shared with resident acceleration structures was never evicted
+                if (mPageables[entry->second->Pageable.Get()].ResidentEntries++ == 0)
+                    restored.push_back(entry->second->Pageable.Get());
+            }
+
+            mPendingResident.clear();
+            result.MadeResidentPageables = static_cast<UINT32>(restored.size());
+
+            if (!restored.empty() && !mSimulated && mDevice != nullptr)
+                DXR_THROW_FAILED(mDevice->MakeResident(static_cast<UINT>(restored.size()), restored.data()));
+
+            // Pageables that lost their last resident acceleration structure, unless one was restored since
+            pendingEvict.swap(mPendingEvict);
+
+            for (ComPtr<ID3D12Pageable>& pageable : pendingEvict)
+            {
+                auto state = mPageables.find(pageable.Get());
+                if (state != mPageables.end() && state->second.ResidentEntries == 0)
+                    evicted.push_back(pageable);
+            }
+
+            InternalQueryBudget(result.Budget, result.Usage);
+
+            // Free enough to get below the low watermark, so the next frames don't evict again right away
+            UINT64 target = static_cast<UINT64>(result.Budget * static_cast<double>(mPolicy.LowWatermark));
+            UINT64 toFree = result.Usage - std::min(result.Usage, target);
+            UINT64 freed = 0;
+
+            if (result.Usage <= static_cast<UINT64>(result.Budget * static_cast<double>(mPolicy.HighWatermark)))
+                toFree = 0;
+
+            for (AccelStructEntry& entry : mLRU)
+            {
+                // The list is ordered by last frame, the rest may still be in use by the GPU
+                if (freed >= toFree || entry.LastFrame + mPolicy.MinIdleFrames > frame)
+                    break;
+
+                if (!entry.Resident)
+                    continue;
+
+                entry.Resident = false;
+                mResidentSize -= entry.Size;
+                freed += entry.Size;
+                result.Evicted.push_back(entry.Address);
+
+                // A pageable shared with resident acceleration structures has to stay resident for them
+                if (--mPageables[entry.Pageable.Get()].ResidentEntries == 0)
+                    evicted.push_back(entry.Pageable);
+            }
+
+            result.EvictedPageables = static_cast<UINT32>(evicted.size());
+            callback = mEvictionCallback;
+            simulated = mSimulated;
+        }
+
+        // Outside of the lock, so the callback can use the manager
+        if (callback)
+        {
+            for (D3D12_GPU_VIRTUAL_ADDRESS address : result.Evicted) { callback(address); }
+        }
+
+        if (!evicted.empty() && !simulated && mDevice != nullptr)
+        {
+            std::vector<ID3D12Pageable*> pageables(evicted.size());
+            for (size_t i = 0; i < evicted.size(); i++) { pageables[i] = evicted[i].Get(); }
+
+            DXR_THROW_FAILED(mDevice->Evict(static_cast<UINT>(pageables.size()), pageables.data()));
+        }
+
+        return result;
+    }
+
+    void ResidencyManager::SetEvictionCallback(std::function<void(D3D12_GPU_VIRTUAL_ADDRESS)> callback)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEvictionCallback = std::move(callback);
+    }
+
+    void ResidencyManager::SetPolicy(const ResidencyPolicy& policy)
+    {
+        DXR_ASSERT(policy.LowWatermark <= policy.HighWatermark, "Low watermark must not be above the high watermark");
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPolicy = policy;
+    }
+
+    void ResidencyManager::SetSimulatedBudget(UINT64 budget, UINT64 baseUsage)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSimulated = true;
+        mSimulatedBudget = budget;
+        mSimulatedBaseUsage = baseUsage;
+    }
+
+    UINT64 ResidencyManager::GetResidentSize()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mResidentSize;
+    }
+
+    bool ResidencyManager::IsResident(D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto entry = mEntries.find(address);
+        return entry != mEntries.end() && entry->second->Resident;
+    }
+
+    void ResidencyManager::InternalQueryBudget(UINT64& budget, UINT64& usage)
+    {
+        if (mSimulated)
+        {
+            budget = mSimulatedBudget;
+            usage = mSimulatedBaseUsage + mResidentSize;
+            return;
+        }
+
+        // Without a budget there is nothing to stay within
+        DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+        if (mAdapter == nullptr || FAILED(mAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info)))
+        {
+            budget = UINT64_MAX;
+            usage = 0;
+            return;
+        }
+
+        budget = info.Budget;
+        usage = info.CurrentUsage;
+    }
+
+    void __stdcall ResidencyManager::OnResourceDestroyed(void* pData)
+    {
+        // Copy the context, untracking the resource frees it
+        DestructionContext context = *reinterpret_cast<DestructionContext*>(pData);
+
+        std::lock_guard<std::mutex> lock(context.pManager->mMutex);
+
+        auto tracked = context.pManager->mAllocations.find(context.pResource);
+        if (tracked == context.pManager->mAllocations.end())
+            return;
+
+        context.pManager->mCategoryUsage[static_cast<UINT32>(tracked->second.Category)] -= tracked->second.Size;
+        context.pManager->mAllocations.erase(tracked);
+    }
+
+} // namespace DXR
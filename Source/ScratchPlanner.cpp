@@ -0,0 +1,115 @@
+#include "DXRay/ScratchPlanner.h"
+
+namespace DXR
+{
+    ScratchPlan PlanScratchMemory(const std::vector<UINT64>& scratchSizes, UINT32 maxBatchSize)
+    {
+        ScratchPlan plan = {};
+
+        const UINT32 numBuilds = static_cast<UINT32>(scratchSizes.size());
+
+        // No limit means every build is in flight at the same time
+        if (maxBatchSize == 0)
+            maxBatchSize = std::max(numBuilds, 1u);
+
+        plan.Offsets.resize(numBuilds);
+        plan.Order.resize(numBuilds);
+        plan.Batches.reserve((numBuilds + maxBatchSize - 1) / maxBatchSize);
+
+        ScratchBatch batch = {};
+
+        for (UINT32 i = 0; i < numBuilds; i++)
+        {
+            UINT64 size = DXR_ALIGN(scratchSizes[i], D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+
+            // The previous batch is done once the barrier is passed, so start over at the beginning of the buffer
+            if (batch.Count == maxBatchSize)
+            {
+                plan.Batches.push_back(batch);
+                batch = {i, 0, 0};
+            }
+
+            plan.Order[i] = i;
+            plan.Offsets[i] = batch.Size;
+
+            batch.Size += size;
+            batch.Count++;
+
+            plan.UnplannedSize += size;
+            plan.PeakSize = std::max(plan.PeakSize, batch.Size);
+        }
+
+        if (batch.Count > 0)
+            plan.Batches.push_back(batch);
+
+        return plan;
+    }
+
+    ScratchPlan ScheduleScratchBatches(const std::vector<UINT64>& scratchSizes, UINT64 scratchBudget,
+                                       UINT32 maxBatchSize)
+    {
+        ScratchPlan plan = {};
+
+        const UINT32 numBuilds = static_cast<UINT32>(scratchSizes.size());
+
+        if (maxBatchSize == 0)
+            maxBatchSize = std::max(numBuilds, 1u);
+
+        plan.Offsets.resize(numBuilds);
+
+        // Largest builds first, ties keep their original order so the schedule is deterministic
+        std::vector<UINT32> bySize(numBuilds);
+        for (UINT32 i = 0; i < numBuilds; i++) { bySize[i] = i; }
+
+        std::stable_sort(bySize.begin(), bySize.end(),
+                         [&](UINT32 a, UINT32 b) { return scratchSizes[a] > scratchSizes[b]; });
+
+        // First fit decreasing: put every build into the first batch that still has room for it
+        std::vector<ScratchBatch> batches;
+        std::vector<UINT32> batchOfBuild(numBuilds);
+
+        for (UINT32 build : bySize)
+        {
+            UINT64 size = DXR_ALIGN(scratchSizes[build], D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+
+            // A build larger than the budget fits in no batch, not even in its own, so it ends up alone in a new one
+            size_t b = 0;
+            while (b < batches.size() &&
+                   (batches[b].Count == maxBatchSize || batches[b].Size + size > scratchBudget))
+                b++;
+
+            if (b == batches.size())
+                batches.push_back({});
+
+            plan.Offsets[build] = batches[b].Size;
+            batches[b].Size += size;
+            batches[b].Count++;
+            batchOfBuild[build] = static_cast<UINT32>(b);
+
+            plan.UnplannedSize += size;
+            plan.PeakSize = std::max(plan.PeakSize, batches[b].Size);
+        }
+
+        // Lay out the recording order so every batch is a contiguous range of it
+        UINT32 first = 0;
+        for (auto& batch : batches)
+        {
+            batch.First = first;
+            first += batch.Count;
+        }
+
+        std::vector<UINT32> cursor(batches.size(), 0);
+        plan.Order.resize(numBuilds);
+
+        for (UINT32 build : bySize)
+        {
+            UINT32 b = batchOfBuild[build];
+            plan.Order[batches[b].First + cursor[b]++] = build;
+        }
+
+        plan.Batches = std::move(batches);
+
+        return plan;
+    }
+
+} // namespace DXR
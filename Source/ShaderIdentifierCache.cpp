@@ -0,0 +1,133 @@
+#include "DXRay/ShaderIdentifierCache.h"
+
+namespace DXR
+{
+    ShaderIdentifierCache::~ShaderIdentifierCache()
+    {
+        // Pipelines that are still tracked are alive, otherwise their callback would have untracked them
+        while (!mPipelines.empty()) { InternalUntrackPipeline(mPipelines.begin()->first, true); }
+    }
+
+    void ShaderIdentifierCache::RegisterExpandedPipeline(ID3D12StateObject* pipeline, ID3D12StateObject* parent)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (mPipelines.find(pipeline) != mPipelines.end())
+            return;
+
+        InternalTrackPipeline(pipeline, InternalGetPipeline(parent).Scope);
+    }
+
+    void ShaderIdentifierCache::GetShaderIdentifiers(ID3D12StateObject* pipeline, std::span<const std::wstring> names,
+                                                     BYTE* pDest)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        PipelineScope& scope = *InternalGetPipeline(pipeline).Scope;
+
+        ComPtr<ID3D12StateObjectProperties> stateObjectProps = nullptr;
+        const Identifier* pPrevious = nullptr;
+
+        for (size_t i = 0; i < names.size(); i++, pDest += D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES)
+        {
+            // Records of the same shader are often next to each other, e.g. many records of one hit group
+            if (pPrevious != nullptr && names[i] == names[i - 1])
+            {
+                memcpy(pDest, pPrevious->data(), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+                mHitCount++;
+                continue;
+            }
+
+            // The pipelines this one was expanded from have the same identifiers for their exports
+            const Identifier* pCached = nullptr;
+            for (const PipelineScope* pScope = &scope; pScope != nullptr && pCached == nullptr;
+                 pScope = pScope->Parent.get())
+            {
+                auto cached = pScope->Identifiers.find(names[i]);
+                if (cached != pScope->Identifiers.end())
+                    pCached = &cached->second;
+            }
+
+            if (pCached == nullptr)
+            {
+                if (stateObjectProps == nullptr)
+                    DXR_THROW_FAILED(pipeline->QueryInterface(IID_PPV_ARGS(&stateObjectProps)));
+
+                void* pShaderId = stateObjectProps->GetShaderIdentifier(names[i].c_str());
+                DXR_ASSERT(pShaderId != nullptr, "Shader does not exist in the pipeline.");
+
+                // The export may have been added by this pipeline, so only it and its expansions may see it
+                Identifier& identifier = scope.Identifiers[names[i]];
+                memcpy(identifier.data(), pShaderId, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+                pCached = &identifier;
+                mMissCount++;
+            }
+            else
+            {
+                mHitCount++;
+            }
+
+            memcpy(pDest, pCached->data(), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+            pPrevious = pCached;
+        }
+    }
+
+    void ShaderIdentifierCache::InvalidatePipeline(ID3D12StateObject* pipeline)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        InternalUntrackPipeline(pipeline, true);
+    }
+
+    ShaderIdentifierCache::TrackedPipeline& ShaderIdentifierCache::InternalTrackPipeline(
+        ID3D12StateObject* pipeline, std::shared_ptr<PipelineScope> parent)
+    {
+        auto& tracked = mPipelines[pipeline];
+        tracked.Scope = std::make_shared<PipelineScope>(PipelineScope {{}, std::move(parent)});
+
+        // Without a destruction notification the pipeline stays cached until it is invalidated by hand
+        ComPtr<ID3DDestructionNotifier> notifier = nullptr;
+        if (SUCCEEDED(pipeline->QueryInterface(IID_PPV_ARGS(&notifier))) && notifier != nullptr)
+        {
+            tracked.Context = std::make_unique<DestructionContext>(DestructionContext {this, pipeline});
+
+            if (FAILED(notifier->RegisterDestructionCallback(&OnPipelineDestroyed, tracked.Context.get(),
+                                                             &tracked.CallbackId)))
+                tracked.Context = nullptr;
+        }
+
+        return tracked;
+    }
+
+    ShaderIdentifierCache::TrackedPipeline& ShaderIdentifierCache::InternalGetPipeline(ID3D12StateObject* pipeline)
+    {
+        auto tracked = mPipelines.find(pipeline);
+        return tracked != mPipelines.end() ? tracked->second : InternalTrackPipeline(pipeline, nullptr);
+    }
+
+    void ShaderIdentifierCache::InternalUntrackPipeline(ID3D12StateObject* pipeline, bool unregisterCallback)
+    {
+        auto tracked = mPipelines.find(pipeline);
+        if (tracked == mPipelines.end())
+            return;
+
+        if (unregisterCallback && tracked->second.Context != nullptr)
+        {
+            ComPtr<ID3DDestructionNotifier> notifier = nullptr;
+            if (SUCCEEDED(pipeline->QueryInterface(IID_PPV_ARGS(&notifier))) && notifier != nullptr)
+                notifier->UnregisterDestructionCallback(tracked->second.CallbackId);
+        }
+
+        // The scope lives on while pipelines expanded from this one refer to it
+        mPipelines.erase(tracked);
+    }
+
+    void __stdcall ShaderIdentifierCache::OnPipelineDestroyed(void* pData)
+    {
+        // Copy the context, untracking the pipeline frees it
+        DestructionContext context = *reinterpret_cast<DestructionContext*>(pData);
+
+        std::lock_guard<std::mutex> lock(context.pCache->mMutex);
+        context.pCache->InternalUntrackPipeline(context.pPipeline, false);
+    }
+
+} // namespace DXR
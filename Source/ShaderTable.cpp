@@ -1,115 +1,464 @@
 #include "DXRay/ShaderTable.h"
 
+#if defined(_XM_SSE_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
 namespace DXR
 {
-    void Device::CreateShaderTable(ShaderTable& table, D3D12_HEAP_TYPE heap, ComPtr<ID3D12StateObject>& pipeline)
+    namespace
     {
-        DXR_ASSERT(heap != D3D12_HEAP_TYPE_DEFAULT, "Shader table must be in heap that is CPU accessible");
+        /// @brief Copy to write-combined memory front to back. Both pointers must be 16 byte aligned and size a
+        /// multiple of 16, which shader records always are.
+        void StreamCopy(CHAR* pDest, const CHAR* pSrc, UINT64 size)
+        {
+#if defined(_XM_SSE_INTRINSICS_)
+            for (UINT64 i = 0; i < size; i += 16)
+            {
+                __m128i chunk = _mm_load_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+                _mm_stream_si128(reinterpret_cast<__m128i*>(pDest + i), chunk);
+            }
+#else
+            memcpy(pDest, pSrc, size);
+#endif
+        }
 
-        UINT64 numRgen = table.mNumRayGenShaders;
-        UINT64 numMiss = table.mNumMissShaders;
-        UINT64 numHitGroup = table.mNumHitGroupShaders;
-        UINT64 numCallable = table.mNumCallableShaders;
+        /// @brief Sort ranges and merge the ones that overlap or touch, so each byte is copied once with as few
+        /// copies as possible.
+        template <typename Range>
+        void MergeRanges(std::vector<Range>& ranges)
+        {
+            if (ranges.empty())
+                return;
 
-        UINT64 rgenAlignedSize =
-            DXR_ALIGN(numRgen * table.mRayGenShaderRecordSize, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
-        UINT64 missAlignedSize =
-            DXR_ALIGN(numMiss * table.mMissShaderRecordSize, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
-        UINT64 hitGroupAlignedSize =
-            DXR_ALIGN(numHitGroup * table.mHitGroupRecordSize, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
-        UINT64 callableAlignedSize =
-            DXR_ALIGN(numCallable * table.mCallableRecordSize, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+            std::sort(ranges.begin(), ranges.end(), [](auto& a, auto& b) { return a.Begin < b.Begin; });
 
-        auto tableBufDesc = CD3DX12_RESOURCE_DESC::Buffer(rgenAlignedSize + missAlignedSize + hitGroupAlignedSize +
-                                                          callableAlignedSize);
+            size_t numMerged = 0;
+            for (size_t i = 1; i < ranges.size(); i++)
+            {
+                if (ranges[i].Begin <= ranges[numMerged].End)
+                    ranges[numMerged].End = std::max(ranges[numMerged].End, ranges[i].End);
+                else
+                    ranges[++numMerged] = ranges[i];
+            }
+            ranges.resize(numMerged + 1);
+        }
+    } // namespace
 
-        table.mShaderTable = AllocateResource(tableBufDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, heap,
-                                              DMA::ALLOCATION_FLAG_NONE, D3D12_HEAP_FLAG_NONE);
+    void ShaderTable::WriteShaderRecords(ShaderRecordHandle first, UINT32 count, const void* data, UINT32 size,
+                                         UINT32 stride)
+    {
+        DXR_ASSERT(mBuilt, "Shader table must be built before setting shader record data.");
+
+        auto& section = mSections[first.Value >> ShaderRecordHandle::TypeShift];
+        UINT32 firstIndex = first.GetIndex();
+        UINT64 recordSize = section.RecordSize;
 
-        CHAR* pData = reinterpret_cast<CHAR*>(MapAllocationForWrite(table.mShaderTable));
+        DXR_ASSERT(firstIndex + count <= section.NumBuilt,
+                   "Shader has been added but the shader table was not updated.");
+        DXR_ASSERT(D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + size <= recordSize, "Data does not fit in shader record.");
 
-        table.mRayGenStartPtr = pData;
-        pData += rgenAlignedSize;
-        table.mMissStartPtr = pData;
-        pData += missAlignedSize;
-        table.mHitGroupStartPtr = pData;
-        pData += hitGroupAlignedSize;
-        table.mCallableStartPtr = pData;
+        if (stride == 0)
+            stride = size;
 
-        // Now that we have the pointers, we can fill in the shader table with identifiers
+        // Records are assembled in a cached bounce buffer and streamed out in large sequential chunks. A shader table
+        // in a DEFAULT heap or with versions is written to its CPU copy, which is cached memory that is read again.
+        bool isWriteCombined = !UsesStaging();
+        constexpr UINT64 BounceSize = 8192;
+        alignas(64) CHAR bounce[BounceSize];
 
-        ComPtr<ID3D12StateObjectProperties> stateObjectProps = nullptr;
-        DXR_THROW_FAILED(pipeline.As(&stateObjectProps));
+        const CHAR* pSrc = reinterpret_cast<const CHAR*>(data);
+        CHAR* pDest = section.StartPtr + (firstIndex * recordSize);
+        UINT32 recordsPerChunk = static_cast<UINT32>(BounceSize / recordSize);
 
-        for (auto& [name, entry] : table.mShaders)
+        for (UINT32 chunkStart = 0; chunkStart < count; chunkStart += recordsPerChunk)
         {
+            UINT32 chunkCount = std::min(recordsPerChunk, count - chunkStart);
+            CHAR* pRecord = bounce;
 
-            switch (entry.Type)
+            for (UINT32 i = chunkStart; i < chunkStart + chunkCount; i++, pRecord += recordSize)
             {
-            case ShaderType::RayGen:
+                const BYTE* pId = &section.Identifiers[(firstIndex + i) * D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES];
+
+                memcpy(pRecord, pId, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+                memcpy(pRecord + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES, pSrc + (UINT64(i) * stride), size);
+                memset(pRecord + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + size, 0,
+                       recordSize - D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES - size);
+            }
+
+            if (isWriteCombined)
+                StreamCopy(pDest, bounce, chunkCount * recordSize);
+            else
+                memcpy(pDest, bounce, chunkCount * recordSize);
+
+            pDest += chunkCount * recordSize;
+        }
+
+        MarkDirty(section.Offset + (firstIndex * recordSize), count * recordSize);
+
+#if defined(_XM_SSE_INTRINSICS_)
+        // Make the streaming stores visible before the shader table is used
+        _mm_sfence();
+#endif
+    }
+
+    void ShaderTable::UpdateDispatchDesc()
+    {
+        const auto& rgen = GetSection(ShaderType::RayGen);
+        const auto& miss = GetSection(ShaderType::Miss);
+        const auto& hitGroup = GetSection(ShaderType::HitGroup);
+        const auto& callable = GetSection(ShaderType::Callable);
+
+        if (rgen.NumShaders > 0)
+        {
+            mDispatchDesc.RayGenerationShaderRecord.SizeInBytes = rgen.RecordSize;
+        }
+        if (miss.NumShaders > 0)
+        {
+            mDispatchDesc.MissShaderTable.StartAddress = mShaderTableGPUAddress + miss.Offset;
+            mDispatchDesc.MissShaderTable.SizeInBytes = miss.RecordSize * miss.NumShaders;
+            mDispatchDesc.MissShaderTable.StrideInBytes = miss.RecordSize;
+        }
+        if (hitGroup.NumShaders > 0)
+        {
+            mDispatchDesc.HitGroupTable.StartAddress = mShaderTableGPUAddress + hitGroup.Offset;
+            mDispatchDesc.HitGroupTable.SizeInBytes = hitGroup.RecordSize * hitGroup.NumShaders;
+            mDispatchDesc.HitGroupTable.StrideInBytes = hitGroup.RecordSize;
+        }
+        if (callable.NumShaders > 0)
+        {
+            mDispatchDesc.CallableShaderTable.StartAddress = mShaderTableGPUAddress + callable.Offset;
+            mDispatchDesc.CallableShaderTable.SizeInBytes = callable.RecordSize * callable.NumShaders;
+            mDispatchDesc.CallableShaderTable.StrideInBytes = callable.RecordSize;
+        }
+    }
+
+    UINT64 ShaderTable::GetRequiredSize() const
+    {
+        UINT64 tableSize = 0;
+        for (auto& section : mSections)
+        {
+            tableSize += DXR_ALIGN((section.NumShaders + section.NumReserved) * section.RecordSize,
+                                   D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+        }
+        return tableSize;
+    }
+
+    void ShaderTable::BuildInPlace(CHAR* pData, D3D12_GPU_VIRTUAL_ADDRESS address,
+                                   const std::function<void(std::span<const std::wstring>, BYTE*)>& getIdentifiers)
+    {
+        DXR_ASSERT(mVersions.GetCount() == 0, "Shader tables built in place can't be versioned.");
+        DXR_ASSERT(reinterpret_cast<UINT64>(pData) % D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT == 0,
+                   "Shader table memory is not aligned.");
+
+        mShaderTable = nullptr;
+        mHeapType = D3D12_HEAP_TYPE_UPLOAD;
+
+        // Every identifier is written again, like when the device creates the shader table
+        for (auto& section : mSections)
+        {
+            section.Capacity = section.NumShaders + section.NumReserved;
+            section.NumBuilt = 0;
+        }
+
+        InternalSetMemory(pData, address, InternalLayoutSections());
+        InternalWriteShaderIdentifiers(getIdentifiers);
+    }
+
+    UINT64 ShaderTable::InternalLayoutSections()
+    {
+        UINT64 tableSize = 0;
+
+        for (auto& section : mSections)
+        {
+            section.Offset = tableSize;
+            tableSize += DXR_ALIGN(section.Capacity * section.RecordSize, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+        }
+
+        return tableSize;
+    }
+
+    void ShaderTable::InternalSetMemory(CHAR* pData, D3D12_GPU_VIRTUAL_ADDRESS address, UINT64 size)
+    {
+        for (auto& section : mSections) { section.StartPtr = pData + section.Offset; }
+
+        mShaderTableSize = size;
+        mShaderTableBaseAddress = address;
+        mShaderTableGPUAddress = address;
+        mBuilt = true;
+    }
+
+    void ShaderTable::InternalWriteShaderIdentifiers(
+        const std::function<void(std::span<const std::wstring>, BYTE*)>& getIdentifiers)
+    {
+        // Only the shaders that were added since the last build need their identifier, the rest is already there
+        for (auto& section : mSections)
+        {
+            if (section.NumShaders == section.NumBuilt)
+                continue;
+
+            section.Identifiers.resize(section.NumShaders * D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+
+            BYTE* pIdentifiers = &section.Identifiers[section.NumBuilt * D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES];
+            std::span<const std::wstring> names(section.Names.data() + section.NumBuilt,
+                                                section.NumShaders - section.NumBuilt);
+
+            getIdentifiers(names, pIdentifiers);
+
+            for (UINT32 index = section.NumBuilt; index < section.NumShaders; index++)
             {
-                void* pShaderId = stateObjectProps->GetShaderIdentifier(name.c_str());
-                memcpy(table.mRayGenStartPtr + (table.mRayGenShadersBuilt * table.mRayGenShaderRecordSize), pShaderId,
+                memcpy(section.StartPtr + (index * section.RecordSize),
+                       &section.Identifiers[index * D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES],
                        D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-                entry.Index = table.mRayGenShadersBuilt++; // Assign the index to the shader and increment the counter
-                break;
             }
-            case ShaderType::Miss:
+
+            MarkDirty(section.Offset + (section.NumBuilt * section.RecordSize),
+                      (section.NumShaders - section.NumBuilt) * section.RecordSize);
+
+            section.NumBuilt = section.NumShaders;
+        }
+
+        UpdateDispatchDesc();
+
+        mNeedsReallocation = false;
+        mNewShadersAdded = false;
+    }
+
+    bool ShaderTableVersions::Commit(UINT64 frameIndex, UINT64 completedFenceValue, const CHAR* pSource,
+                                     std::vector<Range>& dirtyRanges)
+    {
+        DXR_ASSERT(!mVersions.empty(), "Buffer is not versioned.");
+        DXR_ASSERT(mData != nullptr, "Versions have no storage.");
+
+        UINT32 versionIndex = static_cast<UINT32>(frameIndex % mVersions.size());
+        auto& version = mVersions[versionIndex];
+
+        if (version.FenceValue > completedFenceValue)
+            return false;
+
+        // Every version has to receive the edits of this commit, the other ones get them on their own next commit
+        MergeRanges(dirtyRanges);
+
+        for (auto& other : mVersions)
+        {
+            if (other.NeedsFullCopy)
+                continue;
+
+            other.PendingRanges.insert(other.PendingRanges.end(), dirtyRanges.begin(), dirtyRanges.end());
+            for (auto& range : dirtyRanges) { other.PendingSize += range.End - range.Begin; }
+
+            // Past a point one sequential copy of the whole buffer is cheaper than many small ones
+            if (other.PendingSize >= mVersionSize / 2)
             {
-                void* pShaderId = stateObjectProps->GetShaderIdentifier(name.c_str());
-                memcpy(table.mMissStartPtr + (table.mMissShadersBuilt * table.mMissShaderRecordSize), pShaderId,
-                       D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-                entry.Index = table.mMissShadersBuilt++; // Assign the index to the shader and increment the counter
-                break;
+                other.NeedsFullCopy = true;
+                other.PendingRanges.clear();
             }
-            case ShaderType::HitGroup:
+        }
+
+        dirtyRanges.clear();
+
+        CHAR* pVersion = mData + (versionIndex * mVersionSize);
+
+        if (version.NeedsFullCopy)
+        {
+            memcpy(pVersion, pSource, mVersionSize);
+        }
+        else
+        {
+            MergeRanges(version.PendingRanges);
+            for (auto& range : version.PendingRanges)
             {
-                void* pShaderId = stateObjectProps->GetShaderIdentifier(name.c_str());
-                memcpy(table.mHitGroupStartPtr + (table.mHitGroupShadersBuilt * table.mHitGroupRecordSize), pShaderId,
-                       D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-                entry.Index = table.mHitGroupShadersBuilt++; // Assign the index to the shader and increment the counter
-                break;
+                memcpy(pVersion + range.Begin, pSource + range.Begin, range.End - range.Begin);
             }
-            case ShaderType::Callable:
+        }
+
+        version.PendingRanges.clear();
+        version.PendingSize = 0;
+        version.NeedsFullCopy = false;
+
+        mCurrent = versionIndex;
+        return true;
+    }
+
+    bool ShaderTable::CommitVersion(UINT64 frameIndex, UINT64 completedFenceValue)
+    {
+        DXR_ASSERT(mBuilt, "Shader table must be built before committing a version.");
+
+        if (!mVersions.Commit(frameIndex, completedFenceValue, mStaging.data(), mDirtyRanges))
+            return false;
+
+        mShaderTableGPUAddress = mShaderTableBaseAddress + mVersions.GetCurrentOffset();
+        UpdateDispatchDesc();
+
+        return true;
+    }
+
+    void Device::CreateShaderTable(ShaderTable& table, D3D12_HEAP_TYPE heap, ComPtr<ID3D12StateObject>& pipeline)
+    {
+        DXR_ASSERT(heap != D3D12_HEAP_TYPE_DEFAULT || table.mVersions.GetCount() == 0,
+                   "Shader tables in a DEFAULT heap are updated with copies and don't need versions");
+
+        table.mHeapType = heap;
+
+        // Make space for all shaders and the reserved ones, every identifier is written again
+        for (auto& section : table.mSections)
+        {
+            section.Capacity = section.NumShaders + section.NumReserved;
+            section.NumBuilt = 0;
+        }
+
+        InternalAllocateShaderTable(table);
+        InternalWriteShaderIdentifiers(table, pipeline);
+    }
+
+    ComPtr<DMA::Allocation> Device::UpdateShaderTable(ShaderTable& table, ComPtr<ID3D12StateObject>& pipeline)
+    {
+        if (table.mShaderTable == nullptr)
+        {
+            CreateShaderTable(table, table.mHeapType, pipeline);
+            return nullptr;
+        }
+
+        ComPtr<DMA::Allocation> oldTable = nullptr;
+
+        if (table.mNeedsReallocation)
+        {
+            CHAR* oldStartPtrs[ShaderTypeCount] = {};
+
+            // Grow sections geometrically, so adding shaders one by one doesn't reallocate every time
+            for (UINT32 i = 0; i < ShaderTypeCount; i++)
             {
-                void* pShaderId = stateObjectProps->GetShaderIdentifier(name.c_str());
-                memcpy(table.mCallableStartPtr + (table.mCallableShadersBuilt * table.mCallableRecordSize), pShaderId,
-                       D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-                entry.Index = table.mCallableShadersBuilt++; // Assign the index to the shader and increment the counter
-                break;
+                auto& section = table.mSections[i];
+                oldStartPtrs[i] = section.StartPtr;
+
+                UINT32 required = section.NumShaders + section.NumReserved;
+                if (required > section.Capacity)
+                    section.Capacity = std::max(required, section.Capacity * 2);
             }
+
+            oldTable = table.mShaderTable;
+
+            // Keeps the old CPU copy alive until the records are copied over, the new one is a different vector
+            std::vector<CHAR> oldStaging = std::move(table.mStaging);
+
+            InternalAllocateShaderTable(table);
+
+            // Carry over the records that are already built, identifiers and local root arguments alike
+            for (UINT32 i = 0; i < ShaderTypeCount; i++)
+            {
+                auto& section = table.mSections[i];
+                memcpy(section.StartPtr, oldStartPtrs[i], section.NumBuilt * section.RecordSize);
             }
         }
 
-        table.mShaderTableGPUAddress = table.mShaderTable->GetResource()->GetGPUVirtualAddress();
+        InternalWriteShaderIdentifiers(table, pipeline);
 
-        if (table.mNumRayGenShaders > 0)
+        return oldTable;
+    }
+
+    void Device::InternalAllocateShaderTable(ShaderTable& table)
+    {
+        UINT64 tableSize = table.InternalLayoutSections();
+
+        auto tableBufDesc = CD3DX12_RESOURCE_DESC::Buffer(tableSize);
+        CHAR* pData = nullptr;
+
+        if (table.mHeapType == D3D12_HEAP_TYPE_DEFAULT)
         {
-            table.mDispatchDesc.RayGenerationShaderRecord.SizeInBytes = table.mRayGenShaderRecordSize;
+            // Buffers in a DEFAULT heap start out in the common state, the first upload transitions it
+            table.mShaderTable = AllocateResource(MemoryCategory::ShaderTable, tableBufDesc,
+                                                  D3D12_RESOURCE_STATE_COMMON, table.mHeapType);
+            table.mShaderTableState = D3D12_RESOURCE_STATE_COMMON;
+
+            // Everything is written to the CPU copy, and all of it has to be uploaded to the new buffer
+            table.mStaging.assign(tableSize, 0);
+            table.mDirtyRanges.assign(1, {0, tableSize});
+            pData = table.mStaging.data();
         }
-        if (table.mNumMissShaders > 0)
+        else if (table.mVersions.GetCount() > 0)
         {
-            table.mDispatchDesc.MissShaderTable.StartAddress = table.mShaderTableGPUAddress + rgenAlignedSize;
-            table.mDispatchDesc.MissShaderTable.SizeInBytes = table.mMissShaderRecordSize * table.mNumMissShaders;
-            table.mDispatchDesc.MissShaderTable.StrideInBytes = table.mMissShaderRecordSize;
+            // Versions are laid out one after the other, tableSize keeps each of them aligned
+            auto versionsBufDesc = CD3DX12_RESOURCE_DESC::Buffer(tableSize * table.mVersions.GetCount());
+
+            table.mShaderTable = AllocateResource(MemoryCategory::ShaderTable, versionsBufDesc,
+                                                  D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, table.mHeapType);
+
+            // The buffer is new, so no version is in use and all of them have to be filled on their next commit
+            table.mVersions.SetStorage(reinterpret_cast<CHAR*>(MapAllocationForWrite(table.mShaderTable)), tableSize);
+
+            table.mStaging.assign(tableSize, 0);
+            table.mDirtyRanges.clear();
+            pData = table.mStaging.data();
         }
-        if (table.mNumHitGroupShaders > 0)
+        else
         {
-            table.mDispatchDesc.HitGroupTable.StartAddress =
-                table.mShaderTableGPUAddress + rgenAlignedSize + missAlignedSize;
-            table.mDispatchDesc.HitGroupTable.SizeInBytes = table.mHitGroupRecordSize * table.mNumHitGroupShaders;
-            table.mDispatchDesc.HitGroupTable.StrideInBytes = table.mHitGroupRecordSize;
+            table.mShaderTable = AllocateResource(MemoryCategory::ShaderTable, tableBufDesc,
+                                                  D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, table.mHeapType);
+            pData = reinterpret_cast<CHAR*>(MapAllocationForWrite(table.mShaderTable));
         }
-        if (table.mNumCallableShaders > 0)
+
+        table.InternalSetMemory(pData, table.mShaderTable->GetResource()->GetGPUVirtualAddress(), tableSize);
+    }
+
+    void Device::UploadShaderTable(ShaderTable& table, ComPtr<ID3D12GraphicsCommandList4>& cmdList,
+                                   UINT64 completedFenceValue)
+    {
+        if (!table.IsInDefaultHeap() || table.mDirtyRanges.empty())
+            return;
+
+        auto& ranges = table.mDirtyRanges;
+        MergeRanges(ranges);
+
+        // Only a buffer whose copies the GPU has finished can be overwritten, with more frames in flight or more
+        // uploads per frame than buffers, another one is added
+        auto slot = std::find_if(table.mUploadSlots.begin(), table.mUploadSlots.end(),
+                                 [&](auto& candidate) { return candidate.FenceValue <= completedFenceValue; });
+
+        if (slot == table.mUploadSlots.end())
+            slot = table.mUploadSlots.emplace(slot);
+
+        // The upload buffer mirrors the layout of the table, so ranges have the same offset in both. It is replaced
+        // when the table has grown, which is safe for the same reason as writing to it.
+        if (slot->Buffer == nullptr || slot->Buffer->GetSize() < table.mShaderTableSize)
+        {
+            auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(table.mShaderTableSize);
+            slot->Buffer = AllocateResource(MemoryCategory::ShaderTable, uploadDesc, D3D12_RESOURCE_STATE_GENERIC_READ,
+                                            D3D12_HEAP_TYPE_UPLOAD);
+            slot->pData = reinterpret_cast<CHAR*>(MapAllocationForWrite(slot->Buffer));
+        }
+
+        slot->FenceValue = ShaderTable::UnsubmittedFenceValue;
+
+        for (auto& range : ranges)
         {
-            table.mDispatchDesc.CallableShaderTable.StartAddress =
-                table.mShaderTableGPUAddress + rgenAlignedSize + missAlignedSize + hitGroupAlignedSize;
-            table.mDispatchDesc.CallableShaderTable.SizeInBytes = table.mCallableRecordSize * table.mNumCallableShaders;
-            table.mDispatchDesc.CallableShaderTable.StrideInBytes = table.mCallableRecordSize;
+            memcpy(slot->pData + range.Begin, table.mStaging.data() + range.Begin, range.End - range.Begin);
         }
 
-        table.mNeedsReallocation = false;
-        table.mNewShadersAdded = false;
+        ID3D12Resource* pTable = table.mShaderTable->GetResource();
+
+        D3D12_RESOURCE_BARRIER toCopy =
+            CD3DX12_RESOURCE_BARRIER::Transition(pTable, table.mShaderTableState, D3D12_RESOURCE_STATE_COPY_DEST);
+        cmdList->ResourceBarrier(1, &toCopy);
+
+        for (auto& range : ranges)
+        {
+            cmdList->CopyBufferRegion(pTable, range.Begin, slot->Buffer->GetResource(), range.Begin,
+                                      range.End - range.Begin);
+        }
+
+        D3D12_RESOURCE_BARRIER toRead = CD3DX12_RESOURCE_BARRIER::Transition(
+            pTable, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        cmdList->ResourceBarrier(1, &toRead);
+
+        table.mShaderTableState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+        ranges.clear();
+    }
+
+    void Device::InternalWriteShaderIdentifiers(ShaderTable& table, ComPtr<ID3D12StateObject>& pipeline)
+    {
+        table.InternalWriteShaderIdentifiers([&](std::span<const std::wstring> names, BYTE* pDest) {
+            mShaderIdentifierCache.GetShaderIdentifiers(pipeline.Get(), names, pDest);
+        });
     }
 
 } // namespace DXR
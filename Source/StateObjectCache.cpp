@@ -0,0 +1,381 @@
+#include "DXRay/StateObjectCache.h"
+
+namespace DXR
+{
+    namespace
+    {
+        constexpr UINT64 FNVOffsetBasis = 0xcbf29ce484222325ull;
+        constexpr UINT64 FNVPrime = 0x100000001b3ull;
+
+        UINT64 HashBytes(const void* pData, size_t size, UINT64 hash = FNVOffsetBasis)
+        {
+            const BYTE* pBytes = reinterpret_cast<const BYTE*>(pData);
+            for (size_t i = 0; i < size; i++) { hash = (hash ^ pBytes[i]) * FNVPrime; }
+            return hash;
+        }
+
+        /// @brief Append a value to a signature.
+        void AppendValue(std::vector<BYTE>& signature, UINT64 value)
+        {
+            const BYTE* pBytes = reinterpret_cast<const BYTE*>(&value);
+            signature.insert(signature.end(), pBytes, pBytes + sizeof(value));
+        }
+
+        /// @brief Append bytes to a signature, prefixed with their size so consecutive fields can't run together.
+        void AppendBytes(std::vector<BYTE>& signature, const void* pData, size_t size)
+        {
+            AppendValue(signature, size);
+            const BYTE* pBytes = reinterpret_cast<const BYTE*>(pData);
+            signature.insert(signature.end(), pBytes, pBytes + size);
+        }
+
+        void AppendString(std::vector<BYTE>& signature, LPCWSTR str)
+        {
+            // Null and empty strings mean different things for some fields, e.g. ExportToRename
+            if (str == nullptr)
+            {
+                AppendValue(signature, UINT64_MAX);
+                return;
+            }
+
+            AppendBytes(signature, str, wcslen(str) * sizeof(WCHAR));
+        }
+
+        /// @brief Append a list of signatures independent of its order.
+        void AppendUnordered(std::vector<BYTE>& signature, std::vector<std::vector<BYTE>>& elements)
+        {
+            std::sort(elements.begin(), elements.end());
+
+            AppendValue(signature, elements.size());
+            for (auto& element : elements) { AppendBytes(signature, element.data(), element.size()); }
+        }
+
+        void AppendExports(std::vector<BYTE>& signature, const D3D12_EXPORT_DESC* pExports, UINT32 numExports)
+        {
+            std::vector<std::vector<BYTE>> elements(numExports);
+            for (UINT32 i = 0; i < numExports; i++)
+            {
+                AppendString(elements[i], pExports[i].Name);
+                AppendString(elements[i], pExports[i].ExportToRename);
+                AppendValue(elements[i], pExports[i].Flags);
+            }
+            AppendUnordered(signature, elements);
+        }
+
+        void AppendExportNames(std::vector<BYTE>& signature, LPCWSTR* pExports, UINT32 numExports)
+        {
+            std::vector<std::vector<BYTE>> elements(numExports);
+            for (UINT32 i = 0; i < numExports; i++) { AppendString(elements[i], pExports[i]); }
+            AppendUnordered(signature, elements);
+        }
+
+        void AppendBytecode(std::vector<BYTE>& signature, const D3D12_SHADER_BYTECODE& bytecode)
+        {
+            // A DXIL container starts with "DXBC" and a 16 byte digest of its contents, which stands in for the whole
+            // library. Containers that were not signed by the validator have a zero digest.
+            constexpr size_t DigestOffset = 4;
+            constexpr size_t DigestSize = 16;
+            constexpr BYTE ZeroDigest[DigestSize] = {};
+
+            const BYTE* pBytes = reinterpret_cast<const BYTE*>(bytecode.pShaderBytecode);
+
+            if (bytecode.BytecodeLength >= DigestOffset + DigestSize && memcmp(pBytes, "DXBC", 4) == 0 &&
+                memcmp(pBytes + DigestOffset, ZeroDigest, DigestSize) != 0)
+            {
+                AppendValue(signature, bytecode.BytecodeLength);
+                AppendBytes(signature, pBytes + DigestOffset, DigestSize);
+                return;
+            }
+
+            AppendBytes(signature, pBytes, bytecode.BytecodeLength);
+        }
+
+        /// @brief Append the contents of a subobject to a signature.
+        /// @return False if the type of the subobject is not supported.
+        bool AppendSubobject(std::vector<BYTE>& signature, const D3D12_STATE_SUBOBJECT& subobject,
+                             std::vector<ComPtr<IUnknown>>* pReferences)
+        {
+            AppendValue(signature, subobject.Type);
+
+            switch (subobject.Type)
+            {
+            case D3D12_STATE_SUBOBJECT_TYPE_STATE_OBJECT_CONFIG: {
+                auto& desc = *reinterpret_cast<const D3D12_STATE_OBJECT_CONFIG*>(subobject.pDesc);
+                AppendValue(signature, desc.Flags);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_GLOBAL_ROOT_SIGNATURE: {
+                auto& desc = *reinterpret_cast<const D3D12_GLOBAL_ROOT_SIGNATURE*>(subobject.pDesc);
+                if (pReferences)
+                    pReferences->emplace_back(desc.pGlobalRootSignature);
+                AppendValue(signature, reinterpret_cast<UINT_PTR>(desc.pGlobalRootSignature));
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_LOCAL_ROOT_SIGNATURE: {
+                auto& desc = *reinterpret_cast<const D3D12_LOCAL_ROOT_SIGNATURE*>(subobject.pDesc);
+                if (pReferences)
+                    pReferences->emplace_back(desc.pLocalRootSignature);
+                AppendValue(signature, reinterpret_cast<UINT_PTR>(desc.pLocalRootSignature));
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_NODE_MASK: {
+                auto& desc = *reinterpret_cast<const D3D12_NODE_MASK*>(subobject.pDesc);
+                AppendValue(signature, desc.NodeMask);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY: {
+                auto& desc = *reinterpret_cast<const D3D12_DXIL_LIBRARY_DESC*>(subobject.pDesc);
+                AppendBytecode(signature, desc.DXILLibrary);
+                AppendExports(signature, desc.pExports, desc.NumExports);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_EXISTING_COLLECTION: {
+                auto& desc = *reinterpret_cast<const D3D12_EXISTING_COLLECTION_DESC*>(subobject.pDesc);
+                if (pReferences)
+                    pReferences->emplace_back(desc.pExistingCollection);
+                AppendValue(signature, reinterpret_cast<UINT_PTR>(desc.pExistingCollection));
+                AppendExports(signature, desc.pExports, desc.NumExports);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_SUBOBJECT_TO_EXPORTS_ASSOCIATION: {
+                // The associated subobject is described by its contents, its address depends on the order of subobjects
+                auto& desc = *reinterpret_cast<const D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION*>(subobject.pDesc);
+                std::vector<BYTE> associated = {};
+                if (!AppendSubobject(associated, *desc.pSubobjectToAssociate, nullptr))
+                    return false;
+
+                AppendBytes(signature, associated.data(), associated.size());
+                AppendExportNames(signature, desc.pExports, desc.NumExports);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_DXIL_SUBOBJECT_TO_EXPORTS_ASSOCIATION: {
+                auto& desc = *reinterpret_cast<const D3D12_DXIL_SUBOBJECT_TO_EXPORTS_ASSOCIATION*>(subobject.pDesc);
+                AppendString(signature, desc.SubobjectToAssociate);
+                AppendExportNames(signature, desc.pExports, desc.NumExports);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_SHADER_CONFIG: {
+                auto& desc = *reinterpret_cast<const D3D12_RAYTRACING_SHADER_CONFIG*>(subobject.pDesc);
+                AppendValue(signature, desc.MaxPayloadSizeInBytes);
+                AppendValue(signature, desc.MaxAttributeSizeInBytes);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_PIPELINE_CONFIG: {
+                auto& desc = *reinterpret_cast<const D3D12_RAYTRACING_PIPELINE_CONFIG*>(subobject.pDesc);
+                AppendValue(signature, desc.MaxTraceRecursionDepth);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_PIPELINE_CONFIG1: {
+                auto& desc = *reinterpret_cast<const D3D12_RAYTRACING_PIPELINE_CONFIG1*>(subobject.pDesc);
+                AppendValue(signature, desc.MaxTraceRecursionDepth);
+                AppendValue(signature, desc.Flags);
+                return true;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_HIT_GROUP: {
+                auto& desc = *reinterpret_cast<const D3D12_HIT_GROUP_DESC*>(subobject.pDesc);
+                AppendString(signature, desc.HitGroupExport);
+                AppendValue(signature, desc.Type);
+                AppendString(signature, desc.AnyHitShaderImport);
+                AppendString(signature, desc.ClosestHitShaderImport);
+                AppendString(signature, desc.IntersectionShaderImport);
+                return true;
+            }
+
+            // Subobjects of other pipeline types are not used by DXRay, caching them could return the wrong object
+            default: return false;
+            }
+        }
+
+        /// @brief Hash a signature, 0 is reserved for descriptions that can't be hashed.
+        UINT64 HashSignature(const std::vector<BYTE>& signature)
+        {
+            UINT64 hash = HashBytes(signature.data(), signature.size());
+            return hash == 0 ? 1 : hash;
+        }
+    } // namespace
+
+    bool GetStateObjectSignature(const D3D12_STATE_OBJECT_DESC& desc, std::vector<BYTE>& signature,
+                                 std::vector<ComPtr<IUnknown>>* pReferences)
+    {
+        std::vector<std::vector<BYTE>> subobjects(desc.NumSubobjects);
+
+        for (UINT32 i = 0; i < desc.NumSubobjects; i++)
+        {
+            if (!AppendSubobject(subobjects[i], desc.pSubobjects[i], pReferences))
+                return false;
+        }
+
+        signature.clear();
+        AppendValue(signature, desc.Type);
+        AppendUnordered(signature, subobjects);
+        return true;
+    }
+
+    UINT64 HashStateObjectDesc(const D3D12_STATE_OBJECT_DESC& desc, std::vector<ComPtr<IUnknown>>* pReferences)
+    {
+        std::vector<BYTE> signature = {};
+        if (!GetStateObjectSignature(desc, signature, pReferences))
+            return 0;
+
+        return HashSignature(signature);
+    }
+
+    ComPtr<ID3D12StateObject> StateObjectCache::GetOrCreate(const D3D12_STATE_OBJECT_DESC& desc,
+                                                            ID3D12StateObject* parent,
+                                                            const std::function<ComPtr<ID3D12StateObject>()>& create)
+    {
+        if (mCapacity.load() == 0)
+            return create();
+
+        std::vector<ComPtr<IUnknown>> references = {};
+        std::vector<BYTE> signature = {};
+
+        if (!GetStateObjectSignature(desc, signature, &references))
+        {
+            mUncacheable++;
+            return create();
+        }
+
+        // An expansion is only the same if it expands the same state object
+        AppendValue(signature, reinterpret_cast<UINT_PTR>(parent));
+        if (parent != nullptr)
+            references.emplace_back(parent);
+
+        UINT64 hash = HashSignature(signature);
+
+        std::promise<ComPtr<ID3D12StateObject>> promise;
+        std::shared_future<ComPtr<ID3D12StateObject>> cached = {};
+        UINT64 id = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            // Descriptions with the same hash are only the same if their signatures are
+            auto [first, last] = mEntries.equal_range(hash);
+            auto entry = std::find_if(first, last,
+                                      [&](auto& candidate) { return candidate.second.Signature == signature; });
+
+            if (entry != last)
+            {
+                cached = entry->second.StateObject;
+                entry->second.LastUse = ++mUseCounter;
+                mHits++;
+
+                if (cached.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    mInFlightHits++;
+            }
+            else
+            {
+                id = ++mUseCounter;
+                mEntries.emplace(hash, Entry {promise.get_future().share(), std::move(signature), std::move(references),
+                                              id, id});
+                mMisses++;
+            }
+        }
+
+        // Wait outside of the lock, so other state objects can be requested in the meantime
+        if (cached.valid())
+            return cached.get();
+
+        ComPtr<ID3D12StateObject> stateObject = nullptr;
+
+        try
+        {
+            stateObject = create();
+        }
+        catch (...)
+        {
+            // Threads that wait get the exception too, and the next request tries again
+            promise.set_exception(std::current_exception());
+
+            Entry erased = {};
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            Erase(hash, id, erased);
+            throw;
+        }
+
+        promise.set_value(stateObject);
+
+        // Entries are only evicted once they are ready, so make room now that this one is. The evicted state objects
+        // are released after unlocking, releasing one may run callbacks that use the cache.
+        std::vector<Entry> evicted = {};
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            // Don't keep failed compilations around
+            if (stateObject == nullptr)
+            {
+                evicted.emplace_back();
+                Erase(hash, id, evicted.back());
+            }
+
+            Evict(mCapacity.load(), evicted);
+        }
+
+        return stateObject;
+    }
+
+    void StateObjectCache::SetCapacity(size_t capacity)
+    {
+        std::vector<Entry> evicted = {};
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCapacity = capacity;
+        Evict(capacity, evicted);
+    }
+
+    void StateObjectCache::Clear()
+    {
+        std::unordered_multimap<UINT64, Entry> entries = {};
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        entries.swap(mEntries);
+    }
+
+    size_t StateObjectCache::GetSize()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mEntries.size();
+    }
+
+    void StateObjectCache::Erase(UINT64 hash, UINT64 id, Entry& erased)
+    {
+        // The entry may be gone already, and another one with the same hash added, if the cache was cleared
+        auto [first, last] = mEntries.equal_range(hash);
+        auto entry = std::find_if(first, last, [&](auto& candidate) { return candidate.second.Id == id; });
+
+        if (entry == last)
+            return;
+
+        erased = std::move(entry->second);
+        mEntries.erase(entry);
+    }
+
+    void StateObjectCache::Evict(size_t capacity, std::vector<Entry>& evicted)
+    {
+        while (mEntries.size() > capacity)
+        {
+            auto oldest = mEntries.end();
+
+            for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+            {
+                // Entries that are being compiled are erased by the thread compiling them if it fails
+                if (it->second.StateObject.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    continue;
+
+                if (oldest == mEntries.end() || it->second.LastUse < oldest->second.LastUse)
+                    oldest = it;
+            }
+
+            if (oldest == mEntries.end())
+                return;
+
+            evicted.push_back(std::move(oldest->second));
+            mEntries.erase(oldest);
+            mEvictions++;
+        }
+    }
+
+} // namespace DXR
@@ -0,0 +1,255 @@
+#include "DXRay/StaticBatching.h"
+#include "DXRay/Internal.h"
+
+namespace DXR
+{
+    namespace
+    {
+        using Internal::Bounds;
+        using Internal::MortonCode;
+
+        /// @brief Multiply two 3x4 row-major affine transforms, the result applies b first.
+        XMFLOAT3X4 Multiply(const XMFLOAT3X4& a, const XMFLOAT3X4& b)
+        {
+            XMFLOAT3X4 result = {};
+            for (UINT32 row = 0; row < 3; row++)
+            {
+                for (UINT32 col = 0; col < 4; col++)
+                {
+                    float value = col == 3 ? a.m[row][3] : 0.0f;
+                    for (UINT32 k = 0; k < 3; k++) { value += a.m[row][k] * b.m[k][col]; }
+                    result.m[row][col] = value;
+                }
+            }
+            return result;
+        }
+
+        XMFLOAT3 TransformPoint(const XMFLOAT3X4& m, const XMFLOAT3& p)
+        {
+            return {m.m[0][0] * p.x + m.m[0][1] * p.y + m.m[0][2] * p.z + m.m[0][3],
+                    m.m[1][0] * p.x + m.m[1][1] * p.y + m.m[1][2] * p.z + m.m[1][3],
+                    m.m[2][0] * p.x + m.m[2][1] * p.y + m.m[2][2] * p.z + m.m[2][3]};
+        }
+
+        /// @brief Get the world bounds of a mesh from the corners of its object bounds.
+        Bounds GetWorldBounds(const StaticMeshDesc& mesh)
+        {
+            Bounds bounds = {};
+            for (UINT32 corner = 0; corner < 8; corner++)
+            {
+                XMFLOAT3 p = {corner & 1 ? mesh.BoundsMax.x : mesh.BoundsMin.x,
+                              corner & 2 ? mesh.BoundsMax.y : mesh.BoundsMin.y,
+                              corner & 4 ? mesh.BoundsMax.z : mesh.BoundsMin.z};
+                bounds.Grow(TransformPoint(mesh.Transform, p));
+            }
+            return bounds;
+        }
+
+        /// @brief Check if a transform mirrors, which flips the winding of its triangles.
+        bool IsMirrored(const XMFLOAT3X4& m)
+        {
+            float determinant = m.m[0][0] * (m.m[1][1] * m.m[2][2] - m.m[1][2] * m.m[2][1]) -
+                                m.m[0][1] * (m.m[1][0] * m.m[2][2] - m.m[1][2] * m.m[2][0]) +
+                                m.m[0][2] * (m.m[1][0] * m.m[2][1] - m.m[1][1] * m.m[2][0]);
+            return determinant < 0.0f;
+        }
+
+        UINT64 GetTriangleCount(const D3D12_RAYTRACING_GEOMETRY_DESC& geometry)
+        {
+            const auto& triangles = geometry.Triangles;
+            return (triangles.IndexFormat == DXGI_FORMAT_UNKNOWN ? triangles.VertexCount : triangles.IndexCount) / 3;
+        }
+    } // namespace
+
+    void StaticBatchingResult::FillAccelerationStructureDesc(UINT32 batch, std::span<const StaticMeshDesc> meshes,
+                                                             D3D12_GPU_VIRTUAL_ADDRESS transforms,
+                                                             AccelerationStructureDesc& desc) const
+    {
+        const StaticBatch& b = Batches[batch];
+
+        desc.Geometries.resize(b.Meshes.size());
+        desc.pGeometries.clear();
+
+        for (size_t i = 0; i < b.Meshes.size(); i++)
+        {
+            desc.Geometries[i] = meshes[b.Meshes[i]].Geometry;
+
+            // The geometry transform is part of the pre-transform
+            if (b.IsMerged())
+            {
+                desc.Geometries[i].Triangles.Transform3x4 =
+                    transforms + (UINT64(b.FirstTransform) + i) * sizeof(XMFLOAT3X4);
+            }
+        }
+    }
+
+    std::vector<UINT32> StaticBatchingResult::AddHitGroupRecords(HitGroupTableBuilder& builder,
+                                                                 std::span<const HitGroupRecordDesc> records) const
+    {
+        std::vector<UINT32> groups(Batches.size());
+        std::vector<HitGroupRecordDesc> group = {};
+
+        for (size_t b = 0; b < Batches.size(); b++)
+        {
+            group.clear();
+            for (UINT32 mesh : Batches[b].Meshes) { group.push_back(records[mesh]); }
+
+            groups[b] = builder.AddRecordGroup(group);
+        }
+
+        return groups;
+    }
+
+    StaticBatchingResult BatchStaticMeshes(std::span<const StaticMeshDesc> meshes, const StaticBatchingOptions& options)
+    {
+        StaticBatchingResult result = {};
+        result.Stats.InputInstances = meshes.size();
+        result.Stats.InputBuildCalls = meshes.size();
+
+        std::vector<Bounds> bounds(meshes.size());
+        Bounds sceneCenters = {};
+
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            DXR_ASSERT(meshes[i].Geometry.Type == D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES,
+                       "Only triangle geometries can be batched");
+
+            bounds[i] = GetWorldBounds(meshes[i]);
+            sceneCenters.Grow(bounds[i].GetCenter());
+        }
+
+        auto addSingle = [&](UINT32 mesh) {
+            StaticBatch batch = {};
+            batch.Meshes = {mesh};
+            batch.Transform = meshes[mesh].Transform;
+            batch.InstanceMask = meshes[mesh].InstanceMask;
+            batch.InstanceFlags = meshes[mesh].InstanceFlags;
+            batch.TriangleCount = GetTriangleCount(meshes[mesh].Geometry);
+            result.Batches.push_back(std::move(batch));
+        };
+
+        // Small meshes sorted by their instance state, then along the curve, so neighbors in the list are close
+        std::vector<std::pair<UINT64, UINT32>> candidates = {};
+
+        XMFLOAT3 sceneExtent = {sceneCenters.Max.x - sceneCenters.Min.x, sceneCenters.Max.y - sceneCenters.Min.y,
+                                sceneCenters.Max.z - sceneCenters.Min.z};
+        auto normalize = [](float v, float min, float extent) { return extent > 0.0f ? (v - min) / extent : 0.0f; };
+
+        for (UINT32 i = 0; i < meshes.size(); i++)
+        {
+            // Merging replaces the geometry transform, without its CPU copy it can't be folded in
+            bool unknownTransform =
+                meshes[i].Geometry.Triangles.Transform3x4 != 0 && meshes[i].pGeometryTransform == nullptr;
+
+            if (unknownTransform || GetTriangleCount(meshes[i].Geometry) > options.MaxMeshTriangles)
+            {
+                addSingle(i);
+                continue;
+            }
+
+            XMFLOAT3 c = bounds[i].GetCenter();
+            UINT32 code = MortonCode(normalize(c.x, sceneCenters.Min.x, sceneExtent.x),
+                                     normalize(c.y, sceneCenters.Min.y, sceneExtent.y),
+                                     normalize(c.z, sceneCenters.Min.z, sceneExtent.z));
+
+            // Merged meshes share the winding of the instance, mirrored meshes are only merged with each other and
+            // their batch gets a flipped winding
+            UINT64 mirrored = IsMirrored(meshes[i].Transform) ? 1 : 0;
+            UINT64 state = (mirrored << 16) | (UINT64(meshes[i].InstanceFlags) << 8) | meshes[i].InstanceMask;
+            candidates.push_back({(state << 32) | code, i});
+        }
+
+        std::sort(candidates.begin(), candidates.end());
+
+        std::vector<UINT32> current = {};
+        Bounds currentBounds = {};
+        UINT64 currentTriangles = 0;
+        UINT64 currentState = 0;
+        double currentArea = 0.0;
+
+        auto flush = [&]() {
+            if (current.size() == 1)
+                addSingle(current[0]);
+
+            if (current.size() > 1)
+            {
+                StaticBatch batch = {};
+                batch.Meshes = current;
+                batch.FirstTransform = static_cast<UINT32>(result.GeometryTransforms.size());
+                batch.InstanceMask = meshes[current[0]].InstanceMask;
+                batch.InstanceFlags = meshes[current[0]].InstanceFlags;
+                batch.TriangleCount = currentTriangles;
+
+                // Facing is decided in object space, where the pre-transforms now mirror the meshes, while their
+                // own instance transforms did not affect it. Flip the winding back.
+                if (currentState & (1ull << 16))
+                {
+                    batch.InstanceFlags ^= D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
+                }
+
+                // The instance moves the batch to its center, the pre-transforms move the meshes from there
+                XMFLOAT3 center = currentBounds.GetCenter();
+                batch.Transform = {1.0f, 0.0f, 0.0f, center.x, 0.0f, 1.0f, 0.0f, center.y, 0.0f, 0.0f, 1.0f, center.z};
+
+                for (UINT32 mesh : current)
+                {
+                    XMFLOAT3X4 transform = meshes[mesh].Transform;
+                    transform.m[0][3] -= center.x;
+                    transform.m[1][3] -= center.y;
+                    transform.m[2][3] -= center.z;
+
+                    if (meshes[mesh].pGeometryTransform != nullptr)
+                        transform = Multiply(transform, *meshes[mesh].pGeometryTransform);
+
+                    result.GeometryTransforms.push_back(transform);
+                }
+
+                result.Stats.MergedMeshes += current.size();
+                result.Stats.MergedBatches++;
+                result.Batches.push_back(std::move(batch));
+            }
+
+            current.clear();
+            currentBounds = {};
+            currentTriangles = 0;
+            currentArea = 0.0;
+        };
+
+        for (auto& [key, mesh] : candidates)
+        {
+            UINT64 state = key >> 32;
+            UINT64 triangles = GetTriangleCount(meshes[mesh].Geometry);
+
+            Bounds grown = currentBounds;
+            grown.Grow(bounds[mesh]);
+
+            double area = currentArea + bounds[mesh].GetArea();
+
+            bool fits = !current.empty() && state == currentState &&
+                        current.size() < options.MaxBatchGeometries &&
+                        currentTriangles + triangles <= options.MaxBatchTriangles &&
+                        grown.GetArea() <= options.MaxAreaRatio * std::max(area, static_cast<double>(FLT_MIN));
+
+            if (!fits)
+            {
+                flush();
+                grown = bounds[mesh];
+                area = bounds[mesh].GetArea();
+            }
+
+            current.push_back(mesh);
+            currentBounds = grown;
+            currentTriangles += triangles;
+            currentState = state;
+            currentArea = area;
+        }
+
+        flush();
+
+        result.Stats.OutputInstances = result.Batches.size();
+        result.Stats.OutputBuildCalls = result.Batches.size();
+
+        return result;
+    }
+
+} // namespace DXR
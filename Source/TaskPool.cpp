@@ -0,0 +1,167 @@
+#include "DXRay/TaskPool.h"
+
+namespace DXR
+{
+    TaskPool::TaskPool(UINT32 numThreads)
+    {
+        if (numThreads == 0)
+            numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+        mQueues.resize(numThreads);
+        for (auto& queue : mQueues) { queue = std::make_unique<WorkQueue>(); }
+
+        mThreads.reserve(numThreads);
+        for (UINT32 i = 0; i < numThreads; i++) { mThreads.emplace_back(&TaskPool::WorkerLoop, this, i); }
+    }
+
+    TaskPool::~TaskPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            mStop = true;
+        }
+        mWakeCondition.notify_all();
+
+        for (auto& thread : mThreads) { thread.join(); }
+    }
+
+    void TaskPool::ParallelFor(UINT64 count, UINT64 grainSize, const std::function<void(UINT64, UINT64)>& func)
+    {
+        if (count == 0)
+            return;
+
+        grainSize = std::max<UINT64>(grainSize, 1);
+        const UINT64 numChunks = (count + grainSize - 1) / grainSize;
+
+        // A single chunk or no workers, not worth queueing
+        if (numChunks == 1 || mThreads.empty())
+        {
+            for (UINT64 begin = 0; begin < count; begin += grainSize)
+            {
+                func(begin, std::min(begin + grainSize, count));
+            }
+            return;
+        }
+
+        std::atomic<UINT64> remaining = numChunks;
+
+        // The chunks reference this frame, so an exception must not leave it before all of them are done. The first
+        // one is kept and rethrown once they are, the chunks that haven't started yet are skipped.
+        std::mutex exceptionMutex;
+        std::exception_ptr exception = nullptr;
+        std::atomic<bool> failed = false;
+
+        auto runChunk = [&](UINT64 chunk) {
+            if (!failed.load(std::memory_order_relaxed))
+            {
+                try
+                {
+                    UINT64 begin = chunk * grainSize;
+                    func(begin, std::min(begin + grainSize, count));
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(exceptionMutex);
+                    if (exception == nullptr)
+                        exception = std::current_exception();
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            remaining.fetch_sub(1, std::memory_order_release);
+        };
+
+        // Keep the first chunk for the calling thread, so it starts working right away
+        for (UINT64 chunk = 1; chunk < numChunks; chunk++)
+        {
+            Push([&runChunk, chunk]() { runChunk(chunk); });
+        }
+
+        runChunk(0);
+
+        // Help with the remaining chunks, or any other work, until all chunks are done
+        while (remaining.load(std::memory_order_acquire) != 0)
+        {
+            if (!RunPendingTask())
+                std::this_thread::yield();
+        }
+
+        if (exception != nullptr)
+            std::rethrow_exception(exception);
+    }
+
+    void TaskPool::Push(std::function<void()> task)
+    {
+        // Without workers the tasks are run by threads that wait on them
+        UINT32 index = mQueues.empty() ? 0 : mNextQueue.fetch_add(1, std::memory_order_relaxed) % mQueues.size();
+
+        if (mQueues.empty())
+        {
+            task();
+            return;
+        }
+
+        // Count the task before it can be taken, so the counter never drops below zero
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            mPendingTasks.fetch_add(1, std::memory_order_release);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mQueues[index]->Mutex);
+            mQueues[index]->Tasks.push_back(std::move(task));
+        }
+        mWakeCondition.notify_one();
+    }
+
+    bool TaskPool::TryRunTask(UINT32 home)
+    {
+        const UINT32 numQueues = static_cast<UINT32>(mQueues.size());
+
+        for (UINT32 i = 0; i < numQueues; i++)
+        {
+            auto& queue = *mQueues[(home + i) % numQueues];
+            std::function<void()> task;
+
+            {
+                std::lock_guard<std::mutex> lock(queue.Mutex);
+                if (queue.Tasks.empty())
+                    continue;
+
+                // Own work is taken from the back, which is the most recent and likely still in cache, stolen work
+                // from the front, which is the oldest
+                if (i == 0)
+                {
+                    task = std::move(queue.Tasks.back());
+                    queue.Tasks.pop_back();
+                }
+                else
+                {
+                    task = std::move(queue.Tasks.front());
+                    queue.Tasks.pop_front();
+                }
+            }
+
+            mPendingTasks.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            return true;
+        }
+
+        return false;
+    }
+
+    void TaskPool::WorkerLoop(UINT32 index)
+    {
+        while (true)
+        {
+            if (TryRunTask(index))
+                continue;
+
+            std::unique_lock<std::mutex> lock(mWakeMutex);
+            mWakeCondition.wait(lock, [this]() { return mStop || mPendingTasks.load(std::memory_order_acquire) > 0; });
+
+            if (mStop)
+                return;
+        }
+    }
+
+} // namespace DXR
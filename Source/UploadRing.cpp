@@ -0,0 +1,80 @@
+#include "DXRay/UploadRing.h"
+
+namespace DXR
+{
+    UINT64 RingAllocator::Allocate(UINT64 size, UINT64 alignment)
+    {
+        DXR_ASSERT(size <= mSize, "Allocation is larger than the ring");
+
+        UINT64 offset = DXR_ALIGN(mHead, alignment);
+
+        // Don't wrap a chunk around the end, skip the rest of the ring instead
+        if (offset + size > mSize)
+            offset = 0;
+
+        // Bytes consumed from the head, including alignment padding or the skipped end of the ring
+        UINT64 consumed = offset >= mHead ? offset + size - mHead : mSize - mHead + size;
+
+        if (consumed > mSize - mUsed)
+            return UINT64_MAX;
+
+        mHead = offset + size;
+        mUsed += consumed;
+        mPendingSize += consumed;
+
+        return offset;
+    }
+
+    void RingAllocator::Submit(UINT64 fenceValue)
+    {
+        if (mPendingSize == 0)
+            return;
+
+        mSubmissions.push_back({fenceValue, mPendingSize});
+        mPendingSize = 0;
+    }
+
+    void RingAllocator::Retire(UINT64 completedFenceValue)
+    {
+        while (!mSubmissions.empty() && mSubmissions.front().FenceValue <= completedFenceValue)
+        {
+            mUsed -= mSubmissions.front().Size;
+            mSubmissions.pop_front();
+        }
+
+        // Nothing in flight, start at the beginning again so the next chunks don't need to skip the end
+        if (mUsed == 0)
+            mHead = 0;
+    }
+
+    UploadRing::UploadRing(Device& device, UINT64 size, D3D12_HEAP_TYPE heapType) : mRing(size)
+    {
+        DXR_ASSERT(heapType != D3D12_HEAP_TYPE_DEFAULT, "Upload ring must be in heap that is CPU accessible");
+
+        D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(size, D3D12_RESOURCE_FLAG_NONE);
+
+        mBuffer = device.AllocateResource(MemoryCategory::Upload, resDesc, D3D12_RESOURCE_STATE_GENERIC_READ, heapType);
+        mData = reinterpret_cast<CHAR*>(device.MapAllocationForWrite(mBuffer));
+        mGPUAddress = mBuffer->GetResource()->GetGPUVirtualAddress();
+    }
+
+    UploadAllocation UploadRing::Allocate(UINT64 size, UINT64 alignment)
+    {
+        UploadAllocation alloc = {};
+
+        UINT64 offset = mRing.Allocate(size, alignment);
+
+        DXR_ASSERT(offset != UINT64_MAX, "Upload ring is full, make it larger or retire more often");
+        if (offset == UINT64_MAX)
+            return alloc;
+
+        alloc.pData = mData + offset;
+        alloc.GPUAddress = mGPUAddress + offset;
+        alloc.pResource = mBuffer->GetResource();
+        alloc.Offset = offset;
+        alloc.Size = size;
+
+        return alloc;
+    }
+
+} // namespace DXR
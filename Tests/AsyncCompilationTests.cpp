@@ -0,0 +1,178 @@
+#include "Test.h"
+
+#include <chrono>
+
+using namespace DXR;
+
+namespace
+{
+    /// @brief A state object that only counts its references.
+    class FakeStateObject : public ID3D12StateObject
+    {
+    public:
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppObject) override
+        {
+            *ppObject = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override { return ++mRefCount; }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            ULONG count = --mRefCount;
+            if (count == 0)
+                delete this;
+            return count;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE GetDevice(REFIID, void** ppDevice) override
+        {
+            *ppDevice = nullptr;
+            return E_NOTIMPL;
+        }
+
+    private:
+        std::atomic<ULONG> mRefCount = 1;
+    };
+
+    /// @brief A device whose compilations take a fixed time. It sleeps instead of working, so the compilations of
+    /// many workers overlap even on few cores. Real compilations are bound by the CPU and stop scaling at the number
+    /// of cores.
+    class FakeDevice
+    {
+    public:
+        explicit FakeDevice(std::chrono::microseconds latency) : mLatency(latency) {}
+
+        ComPtr<ID3D12StateObject> CreateStateObject()
+        {
+            mCalls++;
+            std::this_thread::sleep_for(mLatency);
+
+            ComPtr<ID3D12StateObject> stateObject = nullptr;
+            stateObject.Attach(new FakeStateObject());
+            return stateObject;
+        }
+
+        UINT32 GetCalls() const { return mCalls.load(); }
+
+    private:
+        std::chrono::microseconds mLatency;
+        std::atomic<UINT32> mCalls = 0;
+    };
+
+    // An unsigned DXIL container, hashed by its bytes
+    constexpr BYTE Library[32] = {'D', 'X', 'B', 'C', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                  0,   0,   0,   0,   1, 0, 0, 0, 32, 0, 0, 0, 0, 0, 0, 0};
+
+    /// @brief The collection of one material, a library with the closest hit shader of the material.
+    class MaterialCollection
+    {
+    public:
+        explicit MaterialCollection(UINT32 material) : mName(L"ClosestHit" + std::to_wstring(material))
+        {
+            mExport = {mName.c_str(), nullptr, D3D12_EXPORT_FLAG_NONE};
+            mLibrary = {{Library, sizeof(Library)}, 1, &mExport};
+            mSubobject = {D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY, &mLibrary};
+        }
+
+        // The subobjects point into the object
+        MaterialCollection(MaterialCollection const&) = delete;
+        MaterialCollection& operator=(MaterialCollection const&) = delete;
+
+        D3D12_STATE_OBJECT_DESC GetDesc() const { return {D3D12_STATE_OBJECT_TYPE_COLLECTION, 1, &mSubobject}; }
+
+    private:
+        std::wstring mName = {};
+        D3D12_EXPORT_DESC mExport = {};
+        D3D12_DXIL_LIBRARY_DESC mLibrary = {};
+        D3D12_STATE_SUBOBJECT mSubobject = {};
+    };
+
+    constexpr UINT32 MaterialCount = 200;
+
+    /// @brief Compile one collection per material on a pool and link them, the way Device::CreateCollectionAsync(...)
+    /// and Device::LinkCollections(...) do, with the device replaced by a fake.
+    /// @return The number of seconds it took.
+    double CompileMaterials(TaskPool& pool, StateObjectCache& cache, FakeDevice& device,
+                            const std::vector<std::unique_ptr<MaterialCollection>>& materials)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<std::future<ComPtr<ID3D12StateObject>>> collections = {};
+        for (auto& material : materials)
+        {
+            collections.push_back(pool.Submit([&]() {
+                return cache.GetOrCreate(material->GetDesc(), nullptr, [&]() { return device.CreateStateObject(); });
+            }));
+        }
+
+        bool compiled = true;
+        for (auto& collection : collections) { compiled = pool.Wait(collection) != nullptr && compiled; }
+        DXR_CHECK(compiled);
+
+        // The link is one more compilation, after all collections are done
+        device.CreateStateObject();
+
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    std::vector<std::unique_ptr<MaterialCollection>> MakeMaterials()
+    {
+        std::vector<std::unique_ptr<MaterialCollection>> materials = {};
+        for (UINT32 i = 0; i < MaterialCount; i++) { materials.push_back(std::make_unique<MaterialCollection>(i)); }
+        return materials;
+    }
+
+    void TestCompilesEachCollectionOnce()
+    {
+        auto materials = MakeMaterials();
+
+        TaskPool pool(4);
+        StateObjectCache cache;
+        cache.SetCapacity(MaterialCount);
+        FakeDevice device(std::chrono::microseconds(100));
+
+        CompileMaterials(pool, cache, device, materials);
+        DXR_CHECK(device.GetCalls() == MaterialCount + 1);
+        DXR_CHECK(cache.GetSize() == MaterialCount);
+
+        // Starting again finds all of them in the cache, only the link is compiled
+        CompileMaterials(pool, cache, device, materials);
+        DXR_CHECK(device.GetCalls() == MaterialCount + 2);
+        DXR_CHECK(cache.GetStats().Hits == MaterialCount);
+    }
+
+    /// @brief Not a check, the time depends on the machine. The calling thread helps while it waits, so a pool of n
+    /// workers compiles on n + 1 threads.
+    void BenchmarkStartup()
+    {
+        auto materials = MakeMaterials();
+
+        for (UINT32 workers : {1, 4, 16})
+        {
+            TaskPool pool(workers);
+            StateObjectCache cache;
+            cache.SetCapacity(MaterialCount);
+            FakeDevice device(std::chrono::milliseconds(1));
+
+            double seconds = CompileMaterials(pool, cache, device, materials);
+            std::printf("%2u workers %8.2f ms startup for %u collections of 1 ms\n", workers, seconds * 1e3,
+                        MaterialCount);
+        }
+    }
+} // namespace
+
+int main()
+{
+    TestCompilesEachCollectionOnce();
+
+    BenchmarkStartup();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,144 @@
+#include "Test.h"
+
+#include <chrono>
+#include <random>
+
+using namespace DXR;
+
+namespace
+{
+    /// @brief A mesh that owns its vertices, non-indexed.
+    struct Mesh
+    {
+        std::vector<XMFLOAT3> Positions = {};
+
+        MeshInput GetInput() const
+        {
+            MeshInput input = {};
+            input.pPositions = Positions.data();
+            input.VertexCount = static_cast<UINT32>(Positions.size());
+            return input;
+        }
+    };
+
+    /// @brief Small triangles scattered over a cube, the worst case for the binning since nothing lines up.
+    Mesh MakeTriangleSoup(UINT32 triangleCount, XMFLOAT3 offset, UINT32 seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(0.0f, 100.0f);
+        std::uniform_real_distribution<float> edge(-0.5f, 0.5f);
+
+        Mesh mesh = {};
+        for (UINT32 t = 0; t < triangleCount; t++)
+        {
+            XMFLOAT3 center = {offset.x + position(random), offset.y + position(random), offset.z + position(random)};
+            for (UINT32 v = 0; v < 3; v++)
+            {
+                mesh.Positions.push_back({center.x + edge(random), center.y + edge(random), center.z + edge(random)});
+            }
+        }
+        return mesh;
+    }
+
+    void TestAnalyzeMesh()
+    {
+        TaskPool pool(2);
+        Mesh mesh = MakeTriangleSoup(10000, {0.0f, 0.0f, 0.0f}, 1);
+
+        BVHAnalysisOptions options = {};
+        options.ParallelThreshold = 1000;
+        BVHMetrics metrics = AnalyzeMesh(pool, mesh.GetInput(), options);
+
+        DXR_CHECK(metrics.PrimitiveCount == 10000);
+        DXR_CHECK(metrics.NodeCount == 2 * metrics.LeafCount - 1);
+        DXR_CHECK(metrics.LeafCount >= 10000 / options.MaxLeafSize);
+        DXR_CHECK(metrics.MaxDepth < 64);
+        DXR_CHECK(metrics.SAHCost > 0.0f && metrics.OverlapRatio >= 0.0f);
+
+        // Leaves of one triangle are as good as it gets for the intersections, not for the nodes
+        options.MaxLeafSize = 1;
+        BVHMetrics fine = AnalyzeMesh(pool, mesh.GetInput(), options);
+        DXR_CHECK(fine.LeafCount == 10000);
+    }
+
+    void TestAnalyzeGeometries()
+    {
+        TaskPool pool(2);
+        std::vector<Mesh> meshes = {};
+        std::vector<MeshInput> inputs = {};
+        for (UINT32 i = 0; i < 4; i++)
+        {
+            meshes.push_back(MakeTriangleSoup(2000, {i * 1000.0f, 0.0f, 0.0f}, i));
+        }
+        for (const Mesh& mesh : meshes) { inputs.push_back(mesh.GetInput()); }
+
+        BVHAnalysis analysis = AnalyzeGeometries(pool, inputs);
+
+        DXR_CHECK(analysis.Geometries.size() == 4);
+        DXR_CHECK(analysis.Merged.PrimitiveCount == 8000);
+        DXR_CHECK(analysis.Instances.PrimitiveCount == 4);
+        DXR_CHECK(analysis.MergedCost > 0.0f && analysis.SeparateCost > 0.0f);
+        DXR_CHECK(analysis.TrianglesPerSecond > 0.0);
+
+        // Built once, always traced fast
+        DXR_CHECK(analysis.RecommendedFlags ==
+                  (D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE |
+                   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION));
+
+        // Rebuilt every frame for few rays, the build dominates
+        BVHAnalysisOptions options = {};
+        options.Rebuilt = true;
+        options.RaysPerBuild = 1.0f;
+        analysis = AnalyzeGeometries(pool, inputs, options);
+        DXR_CHECK(analysis.RecommendedFlags == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD);
+    }
+
+    /// @brief Print the throughput of the builder, best of a few runs so a preempted run doesn't count.
+    template <typename Analyze>
+    void Benchmark(const char* name, UINT64 triangleCount, Analyze analyze)
+    {
+        double best = DBL_MAX;
+        for (UINT32 run = 0; run < 5; run++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            analyze();
+            auto end = std::chrono::high_resolution_clock::now();
+
+            best = std::min(best, std::chrono::duration<double>(end - start).count());
+        }
+
+        std::printf("%-26s %8.2f Mtriangles/s %8.2f ms\n", name, triangleCount / best * 1e-6, best * 1e3);
+    }
+
+    /// @brief Not a check, the time depends on the machine and its number of cores. Includes gathering the triangle
+    /// bounds, like a caller of the analyzer would see it.
+    void BenchmarkThroughput()
+    {
+        TaskPool pool;
+
+        constexpr UINT32 TriangleCount = 1 << 18;
+        Mesh soup = MakeTriangleSoup(TriangleCount, {0.0f, 0.0f, 0.0f}, 7);
+        Benchmark("AnalyzeMesh", TriangleCount, [&]() { AnalyzeMesh(pool, soup.GetInput()); });
+
+        // Every triangle is built twice, alone and merged
+        std::vector<Mesh> meshes = {};
+        std::vector<MeshInput> inputs = {};
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            meshes.push_back(MakeTriangleSoup(TriangleCount / 16, {i * 50.0f, 0.0f, 0.0f}, i));
+        }
+        for (const Mesh& mesh : meshes) { inputs.push_back(mesh.GetInput()); }
+
+        Benchmark("AnalyzeGeometries (16)", 2 * UINT64(TriangleCount), [&]() { AnalyzeGeometries(pool, inputs); });
+    }
+} // namespace
+
+int main()
+{
+    TestAnalyzeMesh();
+    TestAnalyzeGeometries();
+
+    BenchmarkThroughput();
+
+    return DXR::Test::Report();
+}
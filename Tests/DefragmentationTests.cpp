@@ -0,0 +1,190 @@
+#include "Test.h"
+
+using namespace DXR;
+
+namespace
+{
+    constexpr UINT64 BlockSize = 1024;
+
+    /// @brief Blocks and their allocations, like an AccelStructArena without the buffers.
+    class Arena
+    {
+    public:
+        explicit Arena(UINT32 blockCount)
+        {
+            for (UINT32 i = 0; i < blockCount; i++) { mBlocks.push_back(std::make_unique<OffsetAllocator>(BlockSize)); }
+        }
+
+        /// @brief Allocate in a block.
+        /// @return The index of the allocation.
+        UINT32 Allocate(UINT32 block, UINT64 size)
+        {
+            OffsetAllocation allocation = mBlocks[block]->Allocate(size);
+            DXR_CHECK(allocation.IsValid());
+
+            mAllocations.push_back({block, allocation, size});
+            return static_cast<UINT32>(mAllocations.size() - 1);
+        }
+
+        /// @brief Free an allocation, it is still in the list but no longer planned.
+        void Free(UINT32 index)
+        {
+            mBlocks[mAllocations[index].Block]->Free(mAllocations[index].Allocation);
+            mFreed.push_back(index);
+        }
+
+        /// @brief Remove a block, like a trimmed block of an arena.
+        void RemoveBlock(UINT32 block) { mBlocks[block] = nullptr; }
+
+        DefragmentationPlan Plan(UINT64 maxBytes = UINT64_MAX, UINT32 maxMoves = UINT32_MAX)
+        {
+            std::vector<OffsetAllocator*> blocks = {};
+            for (auto& block : mBlocks) { blocks.push_back(block.get()); }
+
+            std::vector<DefragmentationAllocation> live = {};
+            mLiveIndices.clear();
+            for (UINT32 i = 0; i < mAllocations.size(); i++)
+            {
+                if (std::find(mFreed.begin(), mFreed.end(), i) != mFreed.end())
+                    continue;
+
+                live.push_back(mAllocations[i]);
+                mLiveIndices.push_back(i);
+            }
+
+            return PlanDefragmentation(blocks, live, maxBytes, maxMoves);
+        }
+
+        /// @brief Get the index of the allocation of a move of the last plan.
+        UINT32 GetMoved(const DefragmentationMove& move) const { return mLiveIndices[move.Allocation]; }
+
+        OffsetAllocator& GetBlock(UINT32 block) { return *mBlocks[block]; }
+
+    private:
+        std::vector<std::unique_ptr<OffsetAllocator>> mBlocks = {};
+        std::vector<DefragmentationAllocation> mAllocations = {};
+        std::vector<UINT32> mFreed = {};
+        std::vector<UINT32> mLiveIndices = {};
+    };
+
+    void TestSparsestIntoDensest()
+    {
+        Arena arena(3);
+        arena.Allocate(0, 768);
+        UINT32 small = arena.Allocate(1, 64);
+        UINT32 large = arena.Allocate(1, 128);
+        arena.Allocate(2, 512);
+
+        DefragmentationPlan plan = arena.Plan();
+
+        // Block 1 is the sparsest, its allocations go to block 0, largest first. Block 2 doesn't fit anywhere.
+        DXR_CHECK(plan.Moves.size() == 2);
+        DXR_CHECK(arena.GetMoved(plan.Moves[0]) == large && arena.GetMoved(plan.Moves[1]) == small);
+        DXR_CHECK(plan.Moves[0].DestBlock == 0 && plan.Moves[1].DestBlock == 0);
+        DXR_CHECK(plan.EvacuatedBlocks == (std::vector<UINT32> {1}));
+        DXR_CHECK(plan.MovedBytes == 192);
+        DXR_CHECK(plan.IsComplete);
+
+        // The destinations are allocated, the sources are left to the caller
+        DXR_CHECK(arena.GetBlock(0).GetFreeSize() == BlockSize - 768 - 192);
+        DXR_CHECK(arena.GetBlock(1).GetAllocationCount() == 2);
+        DXR_CHECK(plan.Moves[0].Destination.Offset == 768);
+    }
+
+    void TestFragmentedDestination()
+    {
+        // Block 0 has 256 bytes free in two ranges of 128, which add up to enough but neither fits
+        Arena arena(2);
+        UINT32 blocks[8] = {};
+        for (UINT32& block : blocks) { block = arena.Allocate(0, 128); }
+        arena.Free(blocks[1]);
+        arena.Free(blocks[5]);
+
+        arena.Allocate(1, 200);
+
+        DefragmentationPlan plan = arena.Plan();
+        DXR_CHECK(plan.Moves.empty() && plan.EvacuatedBlocks.empty());
+        DXR_CHECK(plan.MovedBytes == 0);
+
+        // The failed attempt leaves nothing allocated
+        DXR_CHECK(arena.GetBlock(0).GetFreeSize() == 256);
+    }
+
+    void TestPartialBlockIsUndone()
+    {
+        // Block 0 has a free range of 256 and one of 128, block 1 needs 350 in total which would fit
+        Arena arena(2);
+        UINT32 blocks[8] = {};
+        for (UINT32& block : blocks) { block = arena.Allocate(0, 128); }
+        arena.Free(blocks[1]);
+        arena.Free(blocks[2]);
+        arena.Free(blocks[5]);
+
+        arena.Allocate(1, 200);
+        arena.Allocate(1, 150);
+
+        // The 200 byte one fits in the larger range, then the 150 byte one fits nowhere, and block 1 can't be
+        // evacuated. The move of the first one would free nothing, so it is undone.
+        DefragmentationPlan plan = arena.Plan();
+        DXR_CHECK(plan.Moves.empty() && plan.EvacuatedBlocks.empty());
+        DXR_CHECK(plan.MovedBytes == 0);
+        DXR_CHECK(arena.GetBlock(0).GetFreeSize() == 384);
+        DXR_CHECK(arena.GetBlock(0).GetLargestFreeRange() == 256);
+    }
+
+    void TestBudget()
+    {
+        Arena arena(2);
+        arena.Allocate(0, 512);
+        for (UINT32 i = 0; i < 4; i++) { arena.Allocate(1, 64); }
+
+        // Two of the four fit in the budget, the next step continues with the same block
+        DefragmentationPlan plan = arena.Plan(128);
+        DXR_CHECK(plan.Moves.size() == 2);
+        DXR_CHECK(plan.MovedBytes == 128);
+        DXR_CHECK(plan.EvacuatedBlocks.empty());
+        DXR_CHECK(!plan.IsComplete);
+
+        Arena moves(2);
+        moves.Allocate(0, 512);
+        for (UINT32 i = 0; i < 4; i++) { moves.Allocate(1, 64); }
+
+        plan = moves.Plan(UINT64_MAX, 3);
+        DXR_CHECK(plan.Moves.size() == 3 && !plan.IsComplete);
+
+        // A budget smaller than any allocation still moves one
+        Arena tiny(2);
+        tiny.Allocate(0, 512);
+        tiny.Allocate(1, 64);
+        tiny.Allocate(1, 64);
+
+        plan = tiny.Plan(1);
+        DXR_CHECK(plan.Moves.size() == 1 && !plan.IsComplete);
+    }
+
+    void TestRemovedAndEmptyBlocks()
+    {
+        // Block 0 was trimmed and block 2 is empty, neither is a source or a destination
+        Arena arena(4);
+        arena.RemoveBlock(0);
+        arena.Allocate(1, 64);
+        arena.Allocate(3, 512);
+
+        DefragmentationPlan plan = arena.Plan();
+        DXR_CHECK(plan.Moves.size() == 1);
+        DXR_CHECK(plan.Moves[0].DestBlock == 3);
+        DXR_CHECK(plan.EvacuatedBlocks == (std::vector<UINT32> {1}));
+        DXR_CHECK(arena.GetBlock(2).GetFreeSize() == BlockSize);
+    }
+} // namespace
+
+int main()
+{
+    TestSparsestIntoDensest();
+    TestFragmentedDestination();
+    TestPartialBlockIsUndone();
+    TestBudget();
+    TestRemovedAndEmptyBlocks();
+
+    return DXR::Test::Report();
+}
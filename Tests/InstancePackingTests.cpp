@@ -0,0 +1,240 @@
+#include "Test.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+
+using namespace DXR;
+
+namespace
+{
+    /// @brief One instance description worth of bytes, aligned like a mapped instance buffer.
+    struct alignas(64) CacheLine
+    {
+        BYTE Bytes[64];
+    };
+
+    static_assert(sizeof(CacheLine) == sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
+
+    /// @brief Instance data with every optional array, values that need masking and floats that are easy to mangle.
+    class Instances
+    {
+    public:
+        explicit Instances(UINT64 count) : mTransforms(count), mAccelStructs(count), mInstanceIDs(count),
+                                           mMasks(count), mHitGroupOffsets(count), mFlags(count)
+        {
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> value(-1000.0f, 1000.0f);
+
+            for (UINT64 i = 0; i < count; i++)
+            {
+                for (auto& row : mTransforms[i].m)
+                {
+                    for (float& v : row) { v = value(rng); }
+                }
+
+                mAccelStructs[i] = 0x100000000ull * (i % 7) + 256 * i;
+                mInstanceIDs[i] = rng();
+                mMasks[i] = static_cast<UINT8>(rng());
+                mHitGroupOffsets[i] = rng();
+                mFlags[i] = static_cast<UINT8>(rng());
+            }
+
+            // Negative zero and denormals have to come out with the same bits
+            mTransforms[0].m[0][0] = -0.0f;
+            mTransforms[0].m[1][2] = FLT_TRUE_MIN;
+            mTransforms[0].m[2][3] = -FLT_MIN * 0.5f;
+        }
+
+        InstancePackDesc GetDesc(MatrixLayout layout, bool optional) const
+        {
+            InstancePackDesc desc = {};
+            desc.pTransforms = mTransforms.data();
+            desc.Layout = layout;
+            desc.pAccelStructs = mAccelStructs.data();
+
+            if (optional)
+            {
+                desc.pInstanceIDs = mInstanceIDs.data();
+                desc.pMasks = mMasks.data();
+                desc.pHitGroupOffsets = mHitGroupOffsets.data();
+                desc.pFlags = mFlags.data();
+            }
+            return desc;
+        }
+
+    private:
+        std::vector<XMFLOAT4X4> mTransforms = {};
+        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> mAccelStructs = {};
+        std::vector<UINT32> mInstanceIDs = {};
+        std::vector<UINT8> mMasks = {};
+        std::vector<UINT32> mHitGroupOffsets = {};
+        std::vector<UINT8> mFlags = {};
+    };
+
+    D3D12_RAYTRACING_INSTANCE_DESC* AsInstanceDescs(std::vector<CacheLine>& buffer)
+    {
+        return reinterpret_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(buffer.data());
+    }
+
+    void TestMatchesScalar()
+    {
+        constexpr UINT64 Count = 1000;
+        Instances instances(Count);
+
+        for (MatrixLayout layout : {MatrixLayout::RowMajor, MatrixLayout::ColumnMajor})
+        {
+            for (bool optional : {false, true})
+            {
+                InstancePackDesc desc = instances.GetDesc(layout, optional);
+
+                // Poisoned differently, so a byte that isn't written by both shows up
+                std::vector<CacheLine> expected(Count), packed(Count);
+                std::memset(expected.data(), 0xAB, Count * sizeof(CacheLine));
+                std::memset(packed.data(), 0xCD, Count * sizeof(CacheLine));
+
+                PackInstanceDescsScalar(desc, 0, Count, AsInstanceDescs(expected));
+
+                // In two ranges, the second one starts in the middle
+                PackInstanceDescs(desc, 0, 100, AsInstanceDescs(packed));
+                PackInstanceDescs(desc, 100, Count - 100, AsInstanceDescs(packed));
+
+                DXR_CHECK(std::memcmp(expected.data(), packed.data(), Count * sizeof(CacheLine)) == 0);
+            }
+        }
+    }
+
+    void TestMatchesScalarUnaligned()
+    {
+        constexpr UINT64 Count = 64;
+        Instances instances(Count);
+        InstancePackDesc desc = instances.GetDesc(MatrixLayout::ColumnMajor, true);
+
+        // Shifted by 8 bytes, aligned for the struct but not for the streaming stores, which takes the scalar fallback
+        std::vector<CacheLine> expected(Count + 1), packed(Count + 1);
+        auto* pExpected = reinterpret_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(expected.data()->Bytes + 8);
+        auto* pPacked = reinterpret_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(packed.data()->Bytes + 8);
+
+        PackInstanceDescsScalar(desc, 0, Count, pExpected);
+        PackInstanceDescs(desc, 0, Count, pPacked);
+
+        DXR_CHECK(std::memcmp(expected.data(), packed.data(), (Count + 1) * sizeof(CacheLine)) == 0);
+    }
+
+    void TestFields()
+    {
+        Instances instances(2);
+        InstancePackDesc desc = instances.GetDesc(MatrixLayout::RowMajor, false);
+
+        std::vector<CacheLine> packed(2);
+        D3D12_RAYTRACING_INSTANCE_DESC* pDescs = AsInstanceDescs(packed);
+        PackInstanceDescs(desc, 0, 2, pDescs);
+
+        // The defaults of the optional arrays
+        DXR_CHECK(pDescs[1].InstanceID == 1);
+        DXR_CHECK(pDescs[1].InstanceMask == 0xFF);
+        DXR_CHECK(pDescs[1].InstanceContributionToHitGroupIndex == 0);
+        DXR_CHECK(pDescs[1].Flags == 0);
+        DXR_CHECK(pDescs[1].AccelerationStructure == 0x100000000ull + 256);
+
+        // Column-major transforms are transposed
+        desc.Layout = MatrixLayout::ColumnMajor;
+        PackInstanceDescs(desc, 1, 1, pDescs);
+        DXR_CHECK(std::memcmp(&pDescs[1].Transform[0][3], &desc.pTransforms[1].m[3][0], sizeof(float)) == 0);
+    }
+
+    void TestMatchesScalarParallel()
+    {
+        constexpr UINT64 Count = 10000;
+        Instances instances(Count);
+        InstancePackDesc desc = instances.GetDesc(MatrixLayout::ColumnMajor, true);
+
+        std::vector<CacheLine> expected(Count), packed(Count);
+        PackInstanceDescsScalar(desc, 0, Count, AsInstanceDescs(expected));
+
+        TaskPool pool(4);
+        PackInstanceDescsParallel(pool, desc, Count, AsInstanceDescs(packed), 1000);
+
+        DXR_CHECK(std::memcmp(expected.data(), packed.data(), Count * sizeof(CacheLine)) == 0);
+    }
+
+    /// @brief Print the packing throughput of a function, best of a few runs so a preempted run doesn't count.
+    template <typename Pack>
+    void Benchmark(const char* name, const InstancePackDesc& desc, UINT64 count, std::vector<CacheLine>& buffer,
+                   Pack pack)
+    {
+        double best = DBL_MAX;
+        for (UINT32 run = 0; run < 10; run++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            pack(desc, count, AsInstanceDescs(buffer));
+            auto end = std::chrono::high_resolution_clock::now();
+
+            best = std::min(best, std::chrono::duration<double>(end - start).count());
+        }
+
+        std::printf("%-26s %8.2f ns/instance %8.2f GB/s\n", name, best * 1e9 / count,
+                    count * sizeof(CacheLine) / best / 1e9);
+    }
+
+    /// @brief Not a check, the throughput depends on the machine. Written to cached memory, an upload heap is
+    /// write-combined and favors the streaming stores even more.
+    void BenchmarkPacking()
+    {
+        constexpr UINT64 Count = 1 << 18;
+        Instances instances(Count);
+        InstancePackDesc desc = instances.GetDesc(MatrixLayout::ColumnMajor, true);
+        std::vector<CacheLine> buffer(Count);
+
+        TaskPool pool;
+
+        Benchmark("PackInstanceDescsScalar", desc, Count, buffer, [](auto& src, UINT64 count, auto* pDest) {
+            PackInstanceDescsScalar(src, 0, count, pDest);
+        });
+        Benchmark("PackInstanceDescs", desc, Count, buffer, [](auto& src, UINT64 count, auto* pDest) {
+            PackInstanceDescs(src, 0, count, pDest);
+        });
+        Benchmark("PackInstanceDescsParallel", desc, Count, buffer, [&](auto& src, UINT64 count, auto* pDest) {
+            PackInstanceDescsParallel(pool, src, count, pDest);
+        });
+    }
+
+    /// @brief Not a check, the scaling depends on the number of cores and the memory bandwidth. The calling thread
+    /// packs too, so a pool of n workers packs on n + 1 threads. Packing is bound by the memory bandwidth, the curve
+    /// flattens once a few threads saturate it.
+    void BenchmarkScaling()
+    {
+        constexpr UINT64 Count = 1 << 18;
+        Instances instances(Count);
+        InstancePackDesc desc = instances.GetDesc(MatrixLayout::ColumnMajor, true);
+        std::vector<CacheLine> buffer(Count);
+
+        Benchmark("1 thread", desc, Count, buffer, [](auto& src, UINT64 count, auto* pDest) {
+            PackInstanceDescs(src, 0, count, pDest);
+        });
+
+        for (UINT32 workers : {1, 2, 4, 8, 16})
+        {
+            TaskPool pool(workers);
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "%u workers", workers);
+            Benchmark(name, desc, Count, buffer, [&](auto& src, UINT64 count, auto* pDest) {
+                PackInstanceDescsParallel(pool, src, count, pDest);
+            });
+        }
+    }
+} // namespace
+
+int main()
+{
+    TestMatchesScalar();
+    TestMatchesScalarUnaligned();
+    TestFields();
+    TestMatchesScalarParallel();
+
+    BenchmarkPacking();
+    BenchmarkScaling();
+
+    return DXR::Test::Report();
+}
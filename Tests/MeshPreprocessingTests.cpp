@@ -0,0 +1,95 @@
+#include "Test.h"
+
+#include <random>
+
+using namespace DXR;
+
+namespace
+{
+    /// @brief A random triangle soup, every 3 vertices are a triangle, with some degenerate triangles in it.
+    std::vector<XMFLOAT3> MakeSoup(UINT32 triangleCount)
+    {
+        std::mt19937 rng(triangleCount);
+        std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+
+        std::vector<XMFLOAT3> positions(UINT64(triangleCount) * 3);
+        for (XMFLOAT3& p : positions) { p = {value(rng), value(rng), value(rng)}; }
+
+        // Collapsed to a point, and a line
+        for (UINT32 t = 0; t < triangleCount; t += 7)
+        {
+            positions[t * 3 + 1] = positions[t * 3];
+            positions[t * 3 + 2] = positions[t * 3];
+        }
+        for (UINT32 t = 3; t < triangleCount; t += 11)
+        {
+            const XMFLOAT3& a = positions[t * 3];
+            const XMFLOAT3& b = positions[t * 3 + 1];
+            positions[t * 3 + 2] = {(a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f, (a.z + b.z) * 0.5f};
+        }
+        return positions;
+    }
+
+    bool Equal(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+
+    /// @brief Check that each output triangle has the corners of the input triangle it maps to, in the same order.
+    bool TrianglesMatch(const PreprocessedMesh& result, const std::vector<XMFLOAT3>& positions)
+    {
+        if (result.SourceTriangles.size() * 3 != result.Indices.size())
+            return false;
+
+        for (UINT64 t = 0; t < result.SourceTriangles.size(); t++)
+        {
+            for (UINT32 i = 0; i < 3; i++)
+            {
+                const XMFLOAT3& output = result.Vertices[result.Indices[t * 3 + i]];
+                if (!Equal(output, positions[UINT64(result.SourceTriangles[t]) * 3 + i]))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    void TestSourceTriangles()
+    {
+        constexpr UINT32 TriangleCount = 1000;
+        std::vector<XMFLOAT3> positions = MakeSoup(TriangleCount);
+
+        MeshInput input = {};
+        input.pPositions = positions.data();
+        input.VertexCount = static_cast<UINT32>(positions.size());
+
+        for (bool reorder : {false, true})
+        {
+            MeshPreprocessOptions options = {};
+            options.ReorderTriangles = reorder;
+            PreprocessedMesh result = PreprocessMesh(input, options);
+
+            DXR_CHECK(result.Stats.DegenerateTriangles > 0);
+            DXR_CHECK(result.Stats.ZeroAreaTriangles > 0);
+            DXR_CHECK(result.SourceTriangles.size() == result.Stats.OutputTriangles);
+            DXR_CHECK(TrianglesMatch(result, positions));
+
+            // Each input triangle is kept at most once, without reordering in the input order
+            std::vector<UINT32> sorted = result.SourceTriangles;
+            std::sort(sorted.begin(), sorted.end());
+            DXR_CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+            DXR_CHECK(reorder || sorted == result.SourceTriangles);
+        }
+
+        // Without removing degenerates every triangle is kept
+        MeshPreprocessOptions options = {};
+        options.RemoveDegenerates = false;
+        PreprocessedMesh result = PreprocessMesh(input, options);
+
+        DXR_CHECK(result.SourceTriangles.size() == TriangleCount);
+        DXR_CHECK(TrianglesMatch(result, positions));
+    }
+} // namespace
+
+int main()
+{
+    TestSourceTriangles();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,162 @@
+#include "Test.h"
+
+#include <map>
+#include <random>
+
+using namespace DXR;
+
+namespace
+{
+    void TestAllocateAndFree()
+    {
+        OffsetAllocator allocator(1024);
+
+        OffsetAllocation a = allocator.Allocate(100);
+        OffsetAllocation b = allocator.Allocate(200);
+        OffsetAllocation c = allocator.Allocate(300);
+
+        DXR_CHECK(a.Offset == 0 && b.Offset == 100 && c.Offset == 300);
+        DXR_CHECK(allocator.GetAllocationSize(b) == 200);
+        DXR_CHECK(allocator.GetAllocationCount() == 3);
+        DXR_CHECK(allocator.GetFreeSize() == 424);
+
+        allocator.Free(b);
+        DXR_CHECK(allocator.GetAllocationCount() == 2);
+        DXR_CHECK(allocator.GetFreeSize() == 624);
+
+        // The freed range is reused by an allocation that fits in its bin
+        OffsetAllocation d = allocator.Allocate(150);
+        DXR_CHECK(d.Offset == 100);
+
+        // Freeing an invalid allocation does nothing
+        allocator.Free({});
+        DXR_CHECK(allocator.GetAllocationCount() == 3);
+    }
+
+    void TestGranularity()
+    {
+        OffsetAllocator allocator(4096, 256);
+
+        OffsetAllocation a = allocator.Allocate(1);
+        OffsetAllocation b = allocator.Allocate(300);
+        OffsetAllocation c = allocator.Allocate(0);
+
+        DXR_CHECK(a.Offset == 0 && allocator.GetAllocationSize(a) == 256);
+        DXR_CHECK(b.Offset == 256 && allocator.GetAllocationSize(b) == 512);
+        DXR_CHECK(c.Offset == 768 && allocator.GetAllocationSize(c) == 256);
+        DXR_CHECK(allocator.GetFreeSize() == 4096 - 1024);
+    }
+
+    void TestMerge()
+    {
+        OffsetAllocator allocator(1024);
+
+        OffsetAllocation blocks[4] = {};
+        for (OffsetAllocation& block : blocks) { block = allocator.Allocate(256); }
+        DXR_CHECK(allocator.GetFreeSize() == 0);
+
+        // Two free ranges that aren't neighbours don't merge
+        allocator.Free(blocks[0]);
+        allocator.Free(blocks[2]);
+        DXR_CHECK(allocator.GetFreeSize() == 512);
+        DXR_CHECK(allocator.GetLargestFreeRange() == 256);
+        DXR_CHECK(!allocator.Allocate(512).IsValid());
+
+        // Freeing the range between them merges all three
+        allocator.Free(blocks[1]);
+        DXR_CHECK(allocator.GetLargestFreeRange() == 768);
+
+        OffsetAllocation merged = allocator.Allocate(768);
+        DXR_CHECK(merged.Offset == 0);
+        allocator.Free(merged);
+
+        // And with the last one, the whole range is one free range again
+        allocator.Free(blocks[3]);
+        DXR_CHECK(allocator.GetAllocationCount() == 0);
+        DXR_CHECK(allocator.GetLargestFreeRange() == 1024);
+        DXR_CHECK(allocator.Allocate(1024).Offset == 0);
+    }
+
+    void TestOutOfSpace()
+    {
+        OffsetAllocator allocator(1024);
+        DXR_CHECK(!allocator.Allocate(1025).IsValid());
+
+        OffsetAllocation all = allocator.Allocate(1024);
+        DXR_CHECK(all.IsValid());
+        DXR_CHECK(!allocator.Allocate(1).IsValid());
+
+        allocator.Free(all);
+        DXR_CHECK(allocator.Allocate(1).IsValid());
+
+        // Every allocation and free range takes a node, there is room left but no node for the rest of the range
+        OffsetAllocator fewNodes(1024, 1, 4);
+        for (UINT32 i = 0; i < 3; i++) { DXR_CHECK(fewNodes.Allocate(16).IsValid()); }
+        DXR_CHECK(!fewNodes.Allocate(16).IsValid());
+
+        fewNodes.Reset();
+        DXR_CHECK(fewNodes.GetFreeSize() == 1024 && fewNodes.GetAllocationCount() == 0);
+        DXR_CHECK(fewNodes.Allocate(16).IsValid());
+    }
+
+    void TestRandom()
+    {
+        constexpr UINT64 Size = 1 << 20;
+        OffsetAllocator allocator(Size, 16);
+        std::mt19937 rng(1234);
+
+        // The live allocations by offset, to check that none overlap
+        std::map<UINT64, OffsetAllocation> live = {};
+        UINT64 used = 0;
+
+        for (UINT32 i = 0; i < 20000; i++)
+        {
+            if (live.empty() || rng() % 3 != 0)
+            {
+                OffsetAllocation allocation = allocator.Allocate(1 + rng() % 8192);
+                if (!allocation.IsValid())
+                    continue;
+
+                UINT64 size = allocator.GetAllocationSize(allocation);
+                DXR_CHECK(allocation.Offset % 16 == 0 && allocation.Offset + size <= Size);
+
+                auto next = live.lower_bound(allocation.Offset);
+                if (next != live.end())
+                    DXR_CHECK(allocation.Offset + size <= next->first);
+                if (next != live.begin())
+                {
+                    auto prev = std::prev(next);
+                    DXR_CHECK(prev->first + allocator.GetAllocationSize(prev->second) <= allocation.Offset);
+                }
+
+                live[allocation.Offset] = allocation;
+                used += size;
+            }
+            else
+            {
+                auto victim = std::next(live.begin(), rng() % live.size());
+                used -= allocator.GetAllocationSize(victim->second);
+                allocator.Free(victim->second);
+                live.erase(victim);
+            }
+
+            DXR_CHECK(allocator.GetFreeSize() == Size - used);
+        }
+
+        // Everything merges back into one range
+        for (auto& [offset, allocation] : live) { allocator.Free(allocation); }
+        DXR_CHECK(allocator.GetAllocationCount() == 0);
+        DXR_CHECK(allocator.Allocate(Size).Offset == 0);
+    }
+} // namespace
+
+int main()
+{
+    TestAllocateAndFree();
+    TestGranularity();
+    TestMerge();
+    TestOutOfSpace();
+    TestRandom();
+
+    return DXR::Test::Report();
+}
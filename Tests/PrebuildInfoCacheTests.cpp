@@ -0,0 +1,170 @@
+#include "Test.h"
+
+using namespace DXR;
+
+namespace
+{
+    /// @brief Stands in for the device in the query callback, like Device::QueryPrebuildInfo(...) passes the real one.
+    /// Counts the driver calls and derives the sizes from the inputs, so a wrong cache hit gets the wrong sizes.
+    class FakeDevice
+    {
+    public:
+        void GetRaytracingAccelerationStructurePrebuildInfo(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS* pInputs,
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO* pInfo)
+        {
+            mCalls++;
+
+            UINT64 primitives = pInputs->NumDescs;
+            if (pInputs->Type == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL)
+            {
+                for (UINT i = 0; i < pInputs->NumDescs; i++)
+                {
+                    auto& geometry = pInputs->pGeometryDescs[i];
+                    primitives += geometry.Type == D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES
+                                      ? geometry.Triangles.IndexCount / 3 + geometry.Triangles.VertexCount
+                                      : geometry.AABBs.AABBCount;
+                }
+            }
+
+            UINT64 flags = pInputs->Flags;
+            pInfo->ResultDataMaxSizeInBytes = DXR_ALIGN(primitives * 64 + flags * 256, 256);
+            pInfo->ScratchDataSizeInBytes = DXR_ALIGN(primitives * 32, 256);
+            pInfo->UpdateScratchDataSizeInBytes = DXR_ALIGN(primitives * 8, 256);
+        }
+
+        UINT32 GetCalls() const { return mCalls; }
+
+    private:
+        UINT32 mCalls = 0;
+    };
+
+    D3D12_RAYTRACING_GEOMETRY_DESC MakeTriangles(UINT vertexCount, UINT indexCount, D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        D3D12_RAYTRACING_GEOMETRY_DESC geometry = {};
+        geometry.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+        geometry.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+        geometry.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+        geometry.Triangles.VertexCount = vertexCount;
+        geometry.Triangles.VertexBuffer.StartAddress = address;
+        geometry.Triangles.VertexBuffer.StrideInBytes = 12;
+        geometry.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
+        geometry.Triangles.IndexCount = indexCount;
+        geometry.Triangles.IndexBuffer = address + vertexCount * 12;
+        return geometry;
+    }
+
+    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS MakeInputs(
+        const D3D12_RAYTRACING_GEOMETRY_DESC& geometry,
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags =
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE)
+    {
+        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
+        inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+        inputs.Flags = flags;
+        inputs.NumDescs = 1;
+        inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+        inputs.pGeometryDescs = &geometry;
+        return inputs;
+    }
+
+    /// @brief Query through the cache like Device::QueryPrebuildInfo(...) does.
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO Query(
+        PrebuildInfoCache& cache, FakeDevice& device,
+        const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs)
+    {
+        return cache.GetOrQuery(inputs, [&](auto& info) {
+            device.GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &info);
+        });
+    }
+
+    bool operator==(const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO& a,
+                    const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO& b)
+    {
+        return a.ResultDataMaxSizeInBytes == b.ResultDataMaxSizeInBytes &&
+               a.ScratchDataSizeInBytes == b.ScratchDataSizeInBytes &&
+               a.UpdateScratchDataSizeInBytes == b.UpdateScratchDataSizeInBytes;
+    }
+
+    void TestSameSignatureQueriesOnce()
+    {
+        PrebuildInfoCache cache;
+        FakeDevice device;
+
+        // Many meshes at different addresses with the same counts and formats
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO first = {};
+        for (UINT32 i = 0; i < 1000; i++)
+        {
+            auto geometry = MakeTriangles(300, 900, 0x10000ull * (i + 1));
+            auto info = Query(cache, device, MakeInputs(geometry));
+
+            if (i == 0)
+                first = info;
+            DXR_CHECK(info == first);
+        }
+
+        DXR_CHECK(device.GetCalls() == 1);
+        DXR_CHECK(cache.GetSize() == 1);
+        DXR_CHECK(cache.GetStats().Hits == 999);
+        DXR_CHECK(cache.GetStats().Misses == 1);
+        DXR_CHECK(cache.GetStats().GetHitRate() > 0.99f);
+    }
+
+    void TestDifferentSignaturesQueryEach()
+    {
+        PrebuildInfoCache cache;
+        FakeDevice reference;
+        FakeDevice device;
+
+        auto base = MakeTriangles(300, 900, 0x10000);
+        auto moreVertices = MakeTriangles(301, 900, 0x10000);
+        auto moreIndices = MakeTriangles(300, 903, 0x10000);
+        auto halfFormat = base;
+        halfFormat.Triangles.VertexFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
+        auto transformed = base;
+        transformed.Triangles.Transform3x4 = 0x20000;
+
+        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS signatures[] = {
+            MakeInputs(base),
+            MakeInputs(moreVertices),
+            MakeInputs(moreIndices),
+            MakeInputs(halfFormat),
+            MakeInputs(transformed),
+            MakeInputs(base, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE),
+        };
+
+        // Twice, the second round is served from the cache
+        for (UINT32 round = 0; round < 2; round++)
+        {
+            for (auto& inputs : signatures)
+            {
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO expected = {};
+                reference.GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &expected);
+
+                DXR_CHECK(Query(cache, device, inputs) == expected);
+            }
+        }
+
+        DXR_CHECK(device.GetCalls() == _countof(signatures));
+        DXR_CHECK(cache.GetSize() == _countof(signatures));
+    }
+
+    void TestHashIgnoresAddresses()
+    {
+        auto a = MakeTriangles(300, 900, 0x10000);
+        auto b = MakeTriangles(300, 900, 0x90000);
+        b.Triangles.Transform3x4 = 0;
+
+        DXR_CHECK(HashPrebuildInputs(MakeInputs(a)) == HashPrebuildInputs(MakeInputs(b)));
+        DXR_CHECK(HashPrebuildInputs(MakeInputs(a)) != 0);
+    }
+} // namespace
+
+int main()
+{
+    TestSameSignatureQueriesOnce();
+    TestDifferentSignaturesQueryEach();
+    TestHashIgnoresAddresses();
+
+    return DXR::Test::Report();
+}
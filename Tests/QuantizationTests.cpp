@@ -0,0 +1,215 @@
+#include "Test.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace DXR;
+
+namespace
+{
+    std::vector<XMFLOAT3> MakeVertices(UINT32 count, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+    {
+        std::mt19937 rng(count);
+        std::uniform_real_distribution<float> t(0.0f, 1.0f);
+
+        std::vector<XMFLOAT3> vertices(count);
+        for (XMFLOAT3& v : vertices)
+        {
+            v = {boundsMin.x + (boundsMax.x - boundsMin.x) * t(rng), boundsMin.y + (boundsMax.y - boundsMin.y) * t(rng),
+                 boundsMin.z + (boundsMax.z - boundsMin.z) * t(rng)};
+        }
+
+        // The corners of the box are the extremes of the quantization range
+        vertices[0] = boundsMin;
+        vertices[1] = boundsMax;
+        return vertices;
+    }
+
+    /// @brief Triangles that reference every vertex, the last one included.
+    std::vector<UINT32> MakeIndices(UINT32 vertexCount)
+    {
+        std::vector<UINT32> indices = {};
+        for (UINT32 i = 0; i + 2 < vertexCount; i++)
+        {
+            indices.insert(indices.end(), {i, i + 1, i + 2});
+        }
+        return indices;
+    }
+
+    float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    /// @brief Get the largest distance between the input and the dequantized vertices, measured independent of the
+    /// statistics of the mesh.
+    float GetMaxError(const QuantizedMesh& mesh, std::span<const XMFLOAT3> vertices)
+    {
+        float maxError = 0.0f;
+        for (UINT32 i = 0; i < mesh.VertexCount; i++)
+        {
+            maxError = std::max(maxError, Distance(vertices[i], mesh.GetPosition(i)));
+        }
+        return maxError;
+    }
+
+    UINT32 GetIndex(const QuantizedMesh& mesh, UINT32 i)
+    {
+        if (mesh.IndexFormat == DXGI_FORMAT_R16_UINT)
+        {
+            UINT16 index;
+            std::memcpy(&index, mesh.IndexData.data() + i * sizeof(UINT16), sizeof(UINT16));
+            return index;
+        }
+
+        UINT32 index;
+        std::memcpy(&index, mesh.IndexData.data() + i * sizeof(UINT32), sizeof(UINT32));
+        return index;
+    }
+
+    bool IndicesMatch(const QuantizedMesh& mesh, std::span<const UINT32> indices)
+    {
+        if (mesh.IndexCount != indices.size())
+            return false;
+
+        for (UINT32 i = 0; i < mesh.IndexCount; i++)
+        {
+            if (GetIndex(mesh, i) != indices[i])
+                return false;
+        }
+        return true;
+    }
+
+    void TestWithinMaxPositionError()
+    {
+        auto vertices = MakeVertices(1000, {-1.0f, -2.0f, 3.0f}, {1.0f, 2.0f, 4.0f});
+        auto indices = MakeIndices(1000);
+
+        QuantizationOptions options = {};
+        QuantizedMesh mesh = QuantizeMesh(vertices, indices, options);
+
+        DXR_CHECK(mesh.VertexFormat == DXGI_FORMAT_R16G16B16A16_SNORM);
+        DXR_CHECK(mesh.HasTransform());
+        DXR_CHECK(mesh.Stats.Vertex16Meshes == 1);
+        DXR_CHECK(mesh.VertexData.size() == vertices.size() * 8);
+
+        float error = GetMaxError(mesh, vertices);
+        DXR_CHECK(error <= options.MaxPositionError);
+        DXR_CHECK(error <= mesh.Stats.MaxPositionError);
+        DXR_CHECK(mesh.Stats.MaxPositionError <= options.MaxPositionError);
+
+        // Half a step of the largest axis, the bound of rounding to the nearest step
+        DXR_CHECK(error <= 2.0f * std::sqrt(3.0f) * 0.5f / 32767.0f);
+
+        DXR_CHECK(mesh.Stats.QuantizedSize < mesh.Stats.OriginalSize);
+    }
+
+    void TestExceedingErrorKeepsFloats()
+    {
+        // A 16-bit step of a 1000 unit box is far above the bound
+        auto vertices = MakeVertices(1000, {0.0f, 0.0f, 0.0f}, {1000.0f, 1000.0f, 1000.0f});
+        auto indices = MakeIndices(1000);
+
+        QuantizationOptions options = {};
+        options.MaxPositionError = 1e-4f;
+        QuantizedMesh mesh = QuantizeMesh(vertices, indices, options);
+
+        DXR_CHECK(mesh.VertexFormat == DXGI_FORMAT_R32G32B32_FLOAT);
+        DXR_CHECK(!mesh.HasTransform());
+        DXR_CHECK(mesh.Stats.Vertex16Meshes == 0);
+        DXR_CHECK(mesh.Stats.MaxPositionError == 0.0f);
+        DXR_CHECK(GetMaxError(mesh, vertices) == 0.0f);
+
+        // Same with the error allowed
+        options.MaxPositionError = 1.0f;
+        mesh = QuantizeMesh(vertices, indices, options);
+        DXR_CHECK(mesh.HasTransform());
+        DXR_CHECK(GetMaxError(mesh, vertices) <= options.MaxPositionError);
+    }
+
+    void TestFlatAxes()
+    {
+        // A plane at z = 5, its flat axis keeps a scale of 1 and is exact
+        auto vertices = MakeVertices(1000, {-10.0f, -10.0f, 5.0f}, {10.0f, 10.0f, 5.0f});
+        auto indices = MakeIndices(1000);
+
+        QuantizationOptions options = {};
+        options.MaxPositionError = 0.01f;
+        QuantizedMesh mesh = QuantizeMesh(vertices, indices, options);
+
+        DXR_CHECK(mesh.HasTransform());
+        DXR_CHECK(mesh.Transform.m[2][2] == 1.0f);
+        DXR_CHECK(GetMaxError(mesh, vertices) <= options.MaxPositionError);
+
+        bool flat = true;
+        for (UINT32 i = 0; i < mesh.VertexCount; i++) { flat = flat && mesh.GetPosition(i).z == 5.0f; }
+        DXR_CHECK(flat);
+
+        // All vertices in one point, every axis is flat
+        std::vector<XMFLOAT3> point(100, XMFLOAT3 {1.5f, -2.5f, 3.5f});
+        mesh = QuantizeMesh(point, MakeIndices(100), options);
+
+        DXR_CHECK(mesh.HasTransform());
+        DXR_CHECK(GetMaxError(mesh, point) == 0.0f);
+    }
+
+    void TestTinyMeshKeepsFloats()
+    {
+        // The transform would cost more than 16-bit vertices save
+        auto vertices = MakeVertices(3, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f});
+        QuantizedMesh mesh = QuantizeMesh(vertices, MakeIndices(3));
+
+        DXR_CHECK(!mesh.HasTransform());
+        DXR_CHECK(GetMaxError(mesh, vertices) == 0.0f);
+    }
+
+    void TestIndex16Boundary()
+    {
+        // 0x10000 vertices are addressable with 16 bits, the last index is 0xFFFF
+        auto vertices = MakeVertices(0x10000, {-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f});
+        auto indices = MakeIndices(0x10000);
+
+        QuantizedMesh mesh = QuantizeMesh(vertices, indices);
+        DXR_CHECK(mesh.IndexFormat == DXGI_FORMAT_R16_UINT);
+        DXR_CHECK(mesh.IndexData.size() == indices.size() * sizeof(UINT16));
+        DXR_CHECK(mesh.Stats.Index16Meshes == 1);
+        DXR_CHECK(GetIndex(mesh, mesh.IndexCount - 1) == 0xFFFF);
+        DXR_CHECK(IndicesMatch(mesh, indices));
+        DXR_CHECK(GetMaxError(mesh, vertices) <= QuantizationOptions {}.MaxPositionError);
+
+        // One more vertex needs 32 bits
+        vertices = MakeVertices(0x10001, {-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f});
+        indices = MakeIndices(0x10001);
+
+        mesh = QuantizeMesh(vertices, indices);
+        DXR_CHECK(mesh.IndexFormat == DXGI_FORMAT_R32_UINT);
+        DXR_CHECK(mesh.IndexData.size() == indices.size() * sizeof(UINT32));
+        DXR_CHECK(mesh.Stats.Index16Meshes == 0);
+        DXR_CHECK(GetIndex(mesh, mesh.IndexCount - 1) == 0x10000);
+        DXR_CHECK(IndicesMatch(mesh, indices));
+        DXR_CHECK(GetMaxError(mesh, vertices) <= QuantizationOptions {}.MaxPositionError);
+
+        // And for any vertex count if 16-bit indices are not allowed
+        QuantizationOptions options = {};
+        options.AllowIndex16 = false;
+        vertices.resize(0x10000);
+        indices = MakeIndices(0x10000);
+
+        mesh = QuantizeMesh(vertices, indices, options);
+        DXR_CHECK(mesh.IndexFormat == DXGI_FORMAT_R32_UINT);
+        DXR_CHECK(IndicesMatch(mesh, indices));
+    }
+} // namespace
+
+int main()
+{
+    TestWithinMaxPositionError();
+    TestExceedingErrorKeepsFloats();
+    TestFlatAxes();
+    TestTinyMeshKeepsFloats();
+    TestIndex16Boundary();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,69 @@
+#include "Test.h"
+
+using namespace DXR;
+
+namespace
+{
+    void TestFirstBuildAndMaxRefits()
+    {
+        RefitPolicy policy = {};
+        policy.MaxRefits = 3;
+
+        // Nothing to refit yet
+        DXR_CHECK(policy.Next() == BuildMode::Build);
+
+        for (UINT32 i = 1; i <= 3; i++)
+        {
+            DXR_CHECK(policy.Next() == BuildMode::Update);
+            DXR_CHECK(policy.GetRefitsSinceBuild() == i);
+        }
+
+        // The fourth refit in a row is a build, and the count starts over
+        DXR_CHECK(policy.Next() == BuildMode::Build);
+        DXR_CHECK(policy.GetRefitsSinceBuild() == 0);
+        DXR_CHECK(policy.Next() == BuildMode::Update);
+
+        // No refits at all
+        RefitPolicy never = {};
+        never.MaxRefits = 0;
+        for (UINT32 i = 0; i < 4; i++) { DXR_CHECK(never.Next() == BuildMode::Build); }
+    }
+
+    void TestMaxDeformation()
+    {
+        RefitPolicy policy = {};
+        policy.MaxDeformation = 0.5f;
+
+        DXR_CHECK(policy.Next(0.0f) == BuildMode::Build);
+        DXR_CHECK(policy.Next(0.25f) == BuildMode::Update);
+
+        // At the limit is still refit, above it is built
+        DXR_CHECK(policy.Next(0.5f) == BuildMode::Update);
+        DXR_CHECK(policy.Next(0.75f) == BuildMode::Build);
+        DXR_CHECK(policy.GetRefitsSinceBuild() == 0);
+        DXR_CHECK(policy.Next(0.0f) == BuildMode::Update);
+    }
+
+    void TestReset()
+    {
+        RefitPolicy policy = {};
+        policy.Next();
+        policy.Next();
+        DXR_CHECK(policy.GetRefitsSinceBuild() == 1);
+
+        // E.g. the topology changed, the next one is a build even though refits are left
+        policy.Reset();
+        DXR_CHECK(policy.GetRefitsSinceBuild() == 0);
+        DXR_CHECK(policy.Next() == BuildMode::Build);
+        DXR_CHECK(policy.Next() == BuildMode::Update);
+    }
+} // namespace
+
+int main()
+{
+    TestFirstBuildAndMaxRefits();
+    TestMaxDeformation();
+    TestReset();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,255 @@
+#include "Test.h"
+
+using namespace DXR;
+
+namespace
+{
+    /// @brief A pageable that is never touched in simulation mode, only referenced.
+    class FakePageable : public ID3D12Pageable
+    {
+    public:
+        FakePageable() { sLiveCount++; }
+        virtual ~FakePageable() { sLiveCount--; }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppObject) override
+        {
+            *ppObject = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override { return ++mRefCount; }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            ULONG count = --mRefCount;
+            if (count == 0)
+                delete this;
+            return count;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE GetDevice(REFIID, void** ppDevice) override
+        {
+            *ppDevice = nullptr;
+            return E_NOTIMPL;
+        }
+
+        static inline INT32 sLiveCount = 0;
+
+    private:
+        ULONG mRefCount = 1;
+    };
+
+    ComPtr<ID3D12Pageable> CreateFakePageable()
+    {
+        ComPtr<ID3D12Pageable> pageable = nullptr;
+        pageable.Attach(new FakePageable());
+        return pageable;
+    }
+
+    using Addresses = std::vector<D3D12_GPU_VIRTUAL_ADDRESS>;
+
+    constexpr D3D12_GPU_VIRTUAL_ADDRESS A = 0x10000, B = 0x20000, C = 0x30000, D = 0x40000;
+    constexpr UINT64 Size = 200;
+
+    /// @brief A budget of 1000 bytes, eviction starts above 875 and stops at 500 by default. The watermarks are exact
+    /// in binary, so the thresholds are too.
+    void Setup(ResidencyManager& manager, UINT64 minIdleFrames = 2, float lowWatermark = 0.5f)
+    {
+        ResidencyPolicy policy = {};
+        policy.HighWatermark = 0.875f;
+        policy.LowWatermark = lowWatermark;
+        policy.MinIdleFrames = minIdleFrames;
+
+        manager.SetPolicy(policy);
+        manager.SetSimulatedBudget(1000);
+    }
+
+    void TestLeastRecentlyUsedFirst()
+    {
+        ResidencyManager manager;
+        Setup(manager);
+
+        std::vector<ComPtr<ID3D12Pageable>> pageables = {};
+        for (D3D12_GPU_VIRTUAL_ADDRESS address : {A, B, C, D})
+        {
+            pageables.push_back(CreateFakePageable());
+            manager.TrackAccelerationStructure(address, pageables.back().Get(), Size);
+        }
+
+        // B is never referenced again, then C, A and D in that order
+        manager.MarkReferenced(Addresses {C}, 1);
+        manager.MarkReferenced(Addresses {A, A, A}, 2);
+        manager.MarkReferenced(Addresses {D}, 3);
+
+        Addresses evicted = {};
+        manager.SetEvictionCallback([&](D3D12_GPU_VIRTUAL_ADDRESS address) { evicted.push_back(address); });
+
+        // 800 of 1000 is below the high watermark
+        ResidencyUpdate update = manager.Update(10);
+        DXR_CHECK(update.Usage == 800 && update.Budget == 1000);
+        DXR_CHECK(update.Evicted.empty());
+
+        // 1000 is above it, evicted until at most 500 are used
+        manager.SetSimulatedBudget(1000, 200);
+        update = manager.Update(10);
+
+        DXR_CHECK(update.Usage == 1000);
+        DXR_CHECK(update.Evicted == (Addresses {B, C, A}));
+        DXR_CHECK(update.EvictedPageables == 3);
+        DXR_CHECK(evicted == update.Evicted);
+        DXR_CHECK(manager.GetResidentSize() == Size);
+        DXR_CHECK(manager.IsResident(D) && !manager.IsResident(B));
+
+        // Referencing brings them back in one batch, evicted ones only
+        manager.MarkReferenced(Addresses {C, D, C}, 11);
+        update = manager.Update(11);
+
+        DXR_CHECK(update.MadeResident == (Addresses {C}));
+        DXR_CHECK(update.MadeResidentPageables == 1);
+        DXR_CHECK(update.Evicted.empty());
+        DXR_CHECK(manager.IsResident(C));
+        DXR_CHECK(manager.GetResidentSize() == 2 * Size);
+
+        for (D3D12_GPU_VIRTUAL_ADDRESS address : {A, B, C, D}) { manager.UntrackAccelerationStructure(address); }
+        DXR_CHECK(manager.GetResidentSize() == 0);
+    }
+
+    void TestMinIdleFrames()
+    {
+        ResidencyManager manager;
+        Setup(manager, 3);
+
+        ComPtr<ID3D12Pageable> pageable = CreateFakePageable();
+        manager.TrackAccelerationStructure(A, pageable.Get(), Size);
+        manager.TrackAccelerationStructure(B, pageable.Get(), Size);
+        manager.MarkReferenced(Addresses {A}, 5);
+        manager.MarkReferenced(Addresses {B}, 6);
+
+        // Far over the budget, but both may still be in use by frames in flight
+        manager.SetSimulatedBudget(1000, 2000);
+        DXR_CHECK(manager.Update(7).Evicted.empty());
+        DXR_CHECK(manager.Update(7).Evicted.empty());
+
+        // A has been idle for 3 frames, B not yet
+        ResidencyUpdate update = manager.Update(8);
+        DXR_CHECK(update.Evicted == (Addresses {A}));
+        DXR_CHECK(manager.IsResident(B));
+
+        update = manager.Update(9);
+        DXR_CHECK(update.Evicted == (Addresses {B}));
+
+        manager.UntrackAccelerationStructure(A);
+        manager.UntrackAccelerationStructure(B);
+    }
+
+    void TestWatermarkGap()
+    {
+        ResidencyManager manager;
+        Setup(manager);
+
+        std::vector<ComPtr<ID3D12Pageable>> pageables = {};
+        for (D3D12_GPU_VIRTUAL_ADDRESS address : {A, B, C, D})
+        {
+            pageables.push_back(CreateFakePageable());
+            manager.TrackAccelerationStructure(address, pageables.back().Get(), Size);
+        }
+
+        // 950 is above the high watermark, evicted down to the low one and not just below the high one
+        manager.SetSimulatedBudget(1000, 150);
+        ResidencyUpdate update = manager.Update(10);
+        DXR_CHECK(update.Evicted.size() == 3);
+        DXR_CHECK(150 + manager.GetResidentSize() <= 500);
+
+        // Restoring them, with usage growing up to the high watermark, doesn't evict again
+        manager.SetSimulatedBudget(1000, 75);
+        manager.MarkReferenced(update.Evicted, 11);
+        DXR_CHECK(manager.Update(11).Evicted.empty());
+        DXR_CHECK(manager.GetResidentSize() == 4 * Size);
+
+        for (UINT64 frame = 20; frame < 30; frame++) { DXR_CHECK(manager.Update(frame).Evicted.empty()); }
+
+        // One byte more does
+        manager.SetSimulatedBudget(1000, 76);
+        DXR_CHECK(manager.Update(30).Evicted.size() == 2);
+        DXR_CHECK(76 + manager.GetResidentSize() <= 500);
+
+        for (D3D12_GPU_VIRTUAL_ADDRESS address : {A, B, C, D}) { manager.UntrackAccelerationStructure(address); }
+    }
+
+    void TestSharedPageable()
+    {
+        // Evicts down to 750, one acceleration structure at a time
+        ResidencyManager manager;
+        Setup(manager, 2, 0.75f);
+
+        // A and B in one arena block, C in another
+        ComPtr<ID3D12Pageable> shared = CreateFakePageable();
+        ComPtr<ID3D12Pageable> other = CreateFakePageable();
+        manager.TrackAccelerationStructure(A, shared.Get(), Size);
+        manager.TrackAccelerationStructure(B, shared.Get(), Size);
+        manager.TrackAccelerationStructure(C, other.Get(), Size);
+        manager.MarkReferenced(Addresses {B}, 1);
+        manager.MarkReferenced(Addresses {C}, 2);
+
+        // Evicting A keeps the block resident for B
+        manager.SetSimulatedBudget(1000, 300);
+        ResidencyUpdate update = manager.Update(10);
+        DXR_CHECK(update.Evicted == (Addresses {A}));
+        DXR_CHECK(update.EvictedPageables == 0);
+
+        // Evicting B evicts the block
+        manager.SetSimulatedBudget(1000, 500);
+        update = manager.Update(10);
+        DXR_CHECK(update.Evicted == (Addresses {B}));
+        DXR_CHECK(update.EvictedPageables == 1);
+
+        // Referencing both makes the block resident once
+        manager.SetSimulatedBudget(1000, 0);
+        manager.MarkReferenced(Addresses {A, B}, 11);
+        update = manager.Update(11);
+        DXR_CHECK(update.MadeResident.size() == 2);
+        DXR_CHECK(update.MadeResidentPageables == 1);
+
+        // Untracking B after A was evicted leaves nothing resident in the block
+        manager.SetSimulatedBudget(1000, 300);
+        update = manager.Update(20);
+        DXR_CHECK(update.Evicted == (Addresses {C}));
+        DXR_CHECK(update.EvictedPageables == 1);
+
+        manager.SetSimulatedBudget(1000, 500);
+        update = manager.Update(20);
+        DXR_CHECK(update.Evicted == (Addresses {A}));
+        DXR_CHECK(update.EvictedPageables == 0);
+
+        manager.UntrackAccelerationStructure(B);
+        manager.SetSimulatedBudget(1000, 0);
+        update = manager.Update(21);
+        DXR_CHECK(update.Evicted.empty());
+        DXR_CHECK(update.EvictedPageables == 1);
+
+        // The manager keeps its pageables alive until they are untracked
+        shared = nullptr;
+        other = nullptr;
+        DXR_CHECK(FakePageable::sLiveCount == 2);
+
+        manager.UntrackAccelerationStructure(A);
+        manager.UntrackAccelerationStructure(C);
+        DXR_CHECK(FakePageable::sLiveCount == 0);
+    }
+} // namespace
+
+int main()
+{
+    TestLeastRecentlyUsedFirst();
+    TestMinIdleFrames();
+    TestWatermarkGap();
+    TestSharedPageable();
+
+    DXR_CHECK(FakePageable::sLiveCount == 0);
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,170 @@
+#include "Test.h"
+
+#include <random>
+
+using namespace DXR;
+
+namespace
+{
+    constexpr UINT64 RingSize = 1024;
+
+    /// @brief A fence that the GPU never signals, it is only advanced by hand.
+    class FakeFence
+    {
+    public:
+        UINT64 Signal() { return ++mLastSignaled; }
+        void Complete(UINT64 value) { mCompleted = value; }
+        void CompleteAll() { mCompleted = mLastSignaled; }
+        UINT64 GetCompletedValue() const { return mCompleted; }
+
+    private:
+        UINT64 mLastSignaled = 0;
+        UINT64 mCompleted = 0;
+    };
+
+    void TestAlignment()
+    {
+        RingAllocator ring(RingSize);
+
+        DXR_CHECK(ring.Allocate(100, 1) == 0);
+        DXR_CHECK(ring.Allocate(10, 64) == 128);
+        DXR_CHECK(ring.Allocate(16, 16) == 144);
+
+        // The padding counts as used until it is retired
+        DXR_CHECK(ring.GetUsedSize() == 160);
+    }
+
+    void TestWraparound()
+    {
+        RingAllocator ring(RingSize);
+        FakeFence fence;
+
+        DXR_CHECK(ring.Allocate(400, 1) == 0);
+        ring.Submit(fence.Signal());
+        DXR_CHECK(ring.Allocate(400, 1) == 400);
+        ring.Submit(fence.Signal());
+
+        // Only 224 bytes left at the end, and the start is still in flight
+        DXR_CHECK(ring.Allocate(400, 1) == UINT64_MAX);
+        DXR_CHECK(ring.GetUsedSize() == 800);
+
+        // Once the first frame is done, the chunk skips the end of the ring and goes to the start
+        fence.Complete(1);
+        ring.Retire(fence.GetCompletedValue());
+        DXR_CHECK(ring.GetUsedSize() == 400);
+        DXR_CHECK(ring.Allocate(400, 1) == 0);
+        DXR_CHECK(ring.GetUsedSize() == RingSize);
+
+        // The second frame is still in flight right after the head, nothing fits
+        DXR_CHECK(ring.Allocate(1, 1) == UINT64_MAX);
+        ring.Submit(fence.Signal());
+
+        // The skipped end belongs to the chunk that skipped it, retiring the second frame only frees its own chunk
+        fence.Complete(2);
+        ring.Retire(fence.GetCompletedValue());
+        DXR_CHECK(ring.GetUsedSize() == 624);
+        DXR_CHECK(ring.Allocate(401, 1) == UINT64_MAX);
+        DXR_CHECK(ring.Allocate(400, 1) == 400);
+        ring.Submit(fence.Signal());
+
+        // Empty again, the next chunk starts at the beginning rather than skipping the end
+        fence.CompleteAll();
+        ring.Retire(fence.GetCompletedValue());
+        DXR_CHECK(ring.GetUsedSize() == 0);
+        DXR_CHECK(ring.Allocate(RingSize, 1) == 0);
+    }
+
+    void TestRetirement()
+    {
+        RingAllocator ring(RingSize);
+        FakeFence fence;
+
+        // Submitting without allocations doesn't add a submission
+        ring.Submit(fence.Signal());
+        DXR_CHECK(ring.GetUsedSize() == 0);
+
+        ring.Allocate(256, 1);
+        ring.Submit(fence.Signal());
+        ring.Allocate(256, 1);
+        UINT64 second = fence.Signal();
+        ring.Submit(second);
+
+        // Retiring an older value than either submission frees nothing
+        ring.Retire(1);
+        DXR_CHECK(ring.GetUsedSize() == 512);
+
+        // Retiring a later value frees every submission up to it
+        ring.Retire(second);
+        DXR_CHECK(ring.GetUsedSize() == 0);
+    }
+
+    /// @brief A chunk that the GPU may still be reading.
+    struct LiveChunk
+    {
+        UINT64 FenceValue;
+        UINT64 Offset;
+        UINT64 Size;
+    };
+
+    void TestFramesInFlight()
+    {
+        RingAllocator ring(RingSize);
+        FakeFence fence;
+        std::mt19937 rng(1234);
+
+        constexpr UINT64 FramesInFlight = 2;
+        std::vector<LiveChunk> live = {};
+        UINT64 failed = 0;
+
+        for (UINT64 frame = 0; frame < 1000; frame++)
+        {
+            // Wait for the frame that used the same slot before
+            if (frame >= FramesInFlight)
+                fence.Complete(frame + 1 - FramesInFlight);
+
+            ring.Retire(fence.GetCompletedValue());
+            std::erase_if(live, [&](const LiveChunk& chunk) { return chunk.FenceValue <= fence.GetCompletedValue(); });
+
+            UINT64 fenceValue = frame + 1;
+            for (UINT32 i = 0; i < 4; i++)
+            {
+                UINT64 size = 1 + rng() % 100;
+                UINT64 alignment = UINT64(1) << (rng() % 7);
+
+                UINT64 offset = ring.Allocate(size, alignment);
+                if (offset == UINT64_MAX)
+                {
+                    failed++;
+                    continue;
+                }
+
+                DXR_CHECK(offset % alignment == 0);
+                DXR_CHECK(offset + size <= RingSize);
+
+                // Never handed out while the GPU may still read it
+                for (const LiveChunk& chunk : live)
+                {
+                    DXR_CHECK(offset + size <= chunk.Offset || chunk.Offset + chunk.Size <= offset);
+                }
+
+                live.push_back({fenceValue, offset, size});
+            }
+
+            ring.Submit(fence.Signal());
+            DXR_CHECK(fenceValue == frame + 1);
+        }
+
+        // 2 frames of at most 4 * 163 bytes each can exceed the ring, but rarely
+        DXR_CHECK(failed < 100);
+    }
+} // namespace
+
+int main()
+{
+    TestAlignment();
+    TestWraparound();
+    TestRetirement();
+    TestFramesInFlight();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,176 @@
+#include "Test.h"
+
+#include <algorithm>
+
+using namespace DXR;
+
+namespace
+{
+    constexpr UINT64 Alignment = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+
+    /// @brief Check that the plan records every build once and that the builds of a batch don't overlap.
+    void CheckPlan(const ScratchPlan& plan, const std::vector<UINT64>& scratchSizes)
+    {
+        std::vector<UINT32> sorted = plan.Order;
+        std::sort(sorted.begin(), sorted.end());
+        for (UINT32 i = 0; i < sorted.size(); i++) { DXR_CHECK(sorted[i] == i); }
+
+        UINT32 recorded = 0;
+        for (const ScratchBatch& batch : plan.Batches)
+        {
+            DXR_CHECK(batch.First == recorded);
+            recorded += batch.Count;
+
+            UINT64 end = 0;
+            for (UINT32 i = batch.First; i < batch.First + batch.Count; i++)
+            {
+                UINT32 build = plan.Order[i];
+                DXR_CHECK(plan.Offsets[build] % Alignment == 0);
+                DXR_CHECK(plan.Offsets[build] >= end);
+
+                end = plan.Offsets[build] + scratchSizes[build];
+                DXR_CHECK(end <= batch.Size && batch.Size <= plan.PeakSize);
+            }
+        }
+        DXR_CHECK(recorded == scratchSizes.size());
+    }
+
+    void TestUnlimitedBatchIsTheSum()
+    {
+        // Sizes that aren't aligned are rounded up
+        std::vector<UINT64> sizes = {1000, 256, 1, 4096, 300};
+        ScratchPlan plan = PlanScratchMemory(sizes, 0);
+
+        UINT64 sum = 0;
+        for (UINT64 size : sizes) { sum += DXR_ALIGN(size, Alignment); }
+
+        DXR_CHECK(plan.Batches.size() == 1);
+        DXR_CHECK(plan.PeakSize == sum);
+        DXR_CHECK(plan.UnplannedSize == sum);
+        DXR_CHECK(plan.GetSavedSize() == 0);
+        DXR_CHECK(plan.Offsets == (std::vector<UINT64> {0, 1024, 1280, 1536, 5632}));
+        CheckPlan(plan, sizes);
+    }
+
+    void TestBatchesShareMemory()
+    {
+        std::vector<UINT64> sizes = {1024, 512, 2048, 256, 256};
+        ScratchPlan plan = PlanScratchMemory(sizes, 2);
+
+        // Batches {0, 1}, {2, 3} and {4}, in recording order, each starting over at offset 0
+        DXR_CHECK(plan.Batches.size() == 3);
+        DXR_CHECK(plan.Offsets == (std::vector<UINT64> {0, 1024, 0, 2048, 0}));
+        DXR_CHECK(plan.PeakSize == 2304);
+        DXR_CHECK(plan.UnplannedSize == 4096);
+        DXR_CHECK(plan.GetSavedSize() == 4096 - 2304);
+        CheckPlan(plan, sizes);
+
+        DXR_CHECK(PlanScratchMemory({}, 2).Batches.empty());
+    }
+
+    void TestScheduleFitsBudget()
+    {
+        std::vector<UINT64> sizes = {256, 768, 512, 512, 256, 1024, 256};
+        ScratchPlan plan = ScheduleScratchBatches(sizes, 1024);
+
+        // First fit decreasing: {5}, {1, 0}, {2, 3}, {4, 6}
+        DXR_CHECK(plan.Batches.size() == 4);
+        DXR_CHECK(plan.Order == (std::vector<UINT32> {5, 1, 0, 2, 3, 4, 6}));
+        DXR_CHECK(plan.PeakSize == 1024);
+        DXR_CHECK(plan.UnplannedSize == 3584);
+        for (const ScratchBatch& batch : plan.Batches) { DXR_CHECK(batch.Size <= 1024); }
+        CheckPlan(plan, sizes);
+
+        // At most 2 builds per batch, even if more would fit
+        plan = ScheduleScratchBatches(sizes, 4096, 2);
+        for (const ScratchBatch& batch : plan.Batches) { DXR_CHECK(batch.Count <= 2); }
+        CheckPlan(plan, sizes);
+    }
+
+    void TestScheduleOversizedBuild()
+    {
+        // The second build doesn't fit in the budget on its own, it gets a batch of its own and exceeds the budget
+        std::vector<UINT64> sizes = {512, 4096, 512, 256};
+        ScratchPlan plan = ScheduleScratchBatches(sizes, 1024);
+
+        DXR_CHECK(plan.Batches.size() == 3);
+        DXR_CHECK(plan.Batches[0].Count == 1 && plan.Order[0] == 1);
+        DXR_CHECK(plan.Batches[0].Size == 4096);
+        DXR_CHECK(plan.PeakSize == 4096);
+        for (size_t b = 1; b < plan.Batches.size(); b++) { DXR_CHECK(plan.Batches[b].Size <= 1024); }
+        CheckPlan(plan, sizes);
+    }
+
+    /// @brief A command list that records what it is asked to do, in order.
+    class RecordingCommandList
+    {
+    public:
+        /// @brief A build by its index into the descriptions, or -1 for a UAV barrier on the scratch buffer.
+        using Command = INT32;
+
+        explicit RecordingCommandList(std::span<const AccelerationStructureDesc> descs) : mDescs(descs) {}
+
+        void BuildRaytracingAccelerationStructure(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC* pDesc, UINT,
+            const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC*)
+        {
+            for (size_t i = 0; i < mDescs.size(); i++)
+            {
+                if (&mDescs[i].GetBuildDesc() == pDesc)
+                    mCommands.push_back(static_cast<Command>(i));
+            }
+        }
+
+        void ResourceBarrier(UINT numBarriers, const D3D12_RESOURCE_BARRIER* pBarriers)
+        {
+            for (UINT i = 0; i < numBarriers; i++)
+            {
+                DXR_CHECK(pBarriers[i].Type == D3D12_RESOURCE_BARRIER_TYPE_UAV);
+                mCommands.push_back(-1);
+            }
+        }
+
+        const std::vector<Command>& GetCommands() const { return mCommands; }
+
+        size_t GetBarrierCount() const { return std::count(mCommands.begin(), mCommands.end(), -1); }
+
+    private:
+        std::span<const AccelerationStructureDesc> mDescs = {};
+        std::vector<Command> mCommands = {};
+    };
+
+    void TestOneBarrierBetweenBatches()
+    {
+        std::vector<UINT64> sizes = {256, 768, 512, 512, 256, 1024, 256};
+        std::vector<AccelerationStructureDesc> descs(sizes.size());
+
+        for (UINT32 maxBatchSize : {0, 1, 2, 3})
+        {
+            ScratchPlan plan = PlanScratchMemory(sizes, maxBatchSize);
+            RecordingCommandList cmdList(descs);
+            RecordScratchBatches(plan, std::span<const AccelerationStructureDesc>(descs), cmdList, nullptr);
+
+            DXR_CHECK(cmdList.GetBarrierCount() == plan.Batches.size() - 1);
+            DXR_CHECK(cmdList.GetCommands().size() == sizes.size() + plan.Batches.size() - 1);
+        }
+
+        // The builds in the order of the plan, with a barrier where one batch ends and the next begins
+        ScratchPlan plan = ScheduleScratchBatches(sizes, 1024);
+        RecordingCommandList cmdList(descs);
+        RecordScratchBatches(plan, std::span<const AccelerationStructureDesc>(descs), cmdList, nullptr);
+
+        using Commands = std::vector<RecordingCommandList::Command>;
+        DXR_CHECK(cmdList.GetCommands() == (Commands {5, -1, 1, 0, -1, 2, 3, -1, 4, 6}));
+    }
+} // namespace
+
+int main()
+{
+    TestUnlimitedBatchIsTheSum();
+    TestBatchesShareMemory();
+    TestScheduleFitsBudget();
+    TestScheduleOversizedBuild();
+    TestOneBarrierBetweenBatches();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,236 @@
+#include "Test.h"
+
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+using namespace DXR;
+
+namespace
+{
+    constexpr UINT32 RecordCount = 20000;
+    constexpr UINT32 RootArgumentsSize = 32;
+
+    /// @brief Memory for a shader table, aligned like a mapped buffer.
+    struct alignas(D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT) TableBlock
+    {
+        BYTE Bytes[D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT];
+    };
+
+    /// @brief Identifiers made up from the names, so every shader has a different one.
+    void GetFakeIdentifiers(std::span<const std::wstring> names, BYTE* pDest)
+    {
+        for (const std::wstring& name : names)
+        {
+            UINT64 hash = std::hash<std::wstring> {}(name);
+            for (UINT32 i = 0; i < D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES; i++)
+            {
+                *pDest++ = static_cast<BYTE>(hash >> (i % 8 * 8));
+            }
+        }
+    }
+
+    /// @brief A shader table with one ray generation shader and many hit groups, one per material, built in place.
+    class HitGroupTable
+    {
+    public:
+        HitGroupTable()
+        {
+            mTable.SetShaderRecordSize(D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + RootArgumentsSize, ShaderType::HitGroup);
+            mTable.AddShader(L"RayGen", ShaderType::RayGen);
+
+            mTable.ReserveHashmapSpace(RecordCount + 1);
+            for (UINT32 i = 0; i < RecordCount; i++)
+            {
+                mNames.push_back(L"Material" + std::to_wstring(i));
+                mHandles.push_back(mTable.AddShader(mNames.back(), ShaderType::HitGroup));
+            }
+
+            UINT64 size = mTable.GetRequiredSize();
+            mMemory.resize((size + sizeof(TableBlock) - 1) / sizeof(TableBlock));
+            mTable.BuildInPlace(GetData(), 0x100000, GetFakeIdentifiers);
+            mSize = size;
+        }
+
+        ShaderTable& GetTable() { return mTable; }
+        const std::vector<std::wstring>& GetNames() const { return mNames; }
+        const std::vector<ShaderRecordHandle>& GetHandles() const { return mHandles; }
+
+        CHAR* GetData() { return reinterpret_cast<CHAR*>(mMemory.data()); }
+        UINT64 GetSize() const { return mSize; }
+
+    private:
+        ShaderTable mTable = {};
+        std::vector<std::wstring> mNames = {};
+        std::vector<ShaderRecordHandle> mHandles = {};
+        std::vector<TableBlock> mMemory = {};
+        UINT64 mSize = 0;
+    };
+
+    /// @brief The local root arguments of a material, different for every material and frame.
+    struct RootArguments
+    {
+        UINT64 Values[RootArgumentsSize / sizeof(UINT64)];
+    };
+
+    std::vector<RootArguments> MakeRootArguments(UINT64 frame)
+    {
+        std::vector<RootArguments> arguments(RecordCount);
+        for (UINT32 i = 0; i < RecordCount; i++)
+        {
+            for (UINT64& value : arguments[i].Values) { value = (frame << 32) + i; }
+        }
+        return arguments;
+    }
+
+    void TestBuildInPlace()
+    {
+        HitGroupTable table;
+        ShaderTable& shaderTable = table.GetTable();
+
+        DXR_CHECK(!shaderTable.NeedsReallocation());
+        DXR_CHECK(shaderTable.GetShaderRecordHandle(L"Material5").Value == table.GetHandles()[5].Value);
+
+        // The hit groups follow the ray generation record, one 64-byte record each
+        D3D12_DISPATCH_RAYS_DESC desc = shaderTable.GetRaysDesc(0, 1, 1);
+        DXR_CHECK(desc.RayGenerationShaderRecord.StartAddress == 0x100000);
+        DXR_CHECK(desc.HitGroupTable.StartAddress == 0x100000 + D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+        DXR_CHECK(desc.HitGroupTable.StrideInBytes == 64);
+        DXR_CHECK(desc.HitGroupTable.SizeInBytes == UINT64(64) * RecordCount);
+
+        BYTE identifier[D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES];
+        std::wstring name = L"Material7";
+        GetFakeIdentifiers({&name, 1}, identifier);
+
+        const CHAR* pRecord = table.GetData() + D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT + 7 * 64;
+        DXR_CHECK(std::memcmp(pRecord, identifier, sizeof(identifier)) == 0);
+    }
+
+    void TestHandleMatchesName()
+    {
+        auto arguments = MakeRootArguments(1);
+
+        HitGroupTable byName, byHandle;
+        for (UINT32 i = 0; i < RecordCount; i++)
+        {
+            byName.GetTable().SetShaderRecordData(byName.GetNames()[i], &arguments[i], RootArgumentsSize);
+            byHandle.GetTable().SetShaderRecordData(byHandle.GetHandles()[i], &arguments[i], RootArgumentsSize);
+        }
+
+        DXR_CHECK(std::memcmp(byName.GetData(), byHandle.GetData(), byName.GetSize()) == 0);
+
+        const CHAR* pArguments = byHandle.GetData() + D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT + 9 * 64 +
+                                 D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+        DXR_CHECK(std::memcmp(pArguments, &arguments[9], RootArgumentsSize) == 0);
+    }
+
+    void TestStreamedMatchesScattered()
+    {
+        auto arguments = MakeRootArguments(2);
+
+        HitGroupTable scattered, streamed;
+        for (UINT32 i = 0; i < RecordCount; i++)
+        {
+            scattered.GetTable().SetShaderRecordData(scattered.GetHandles()[i], &arguments[i], RootArgumentsSize);
+        }
+
+        // In two ranges, the second one starts in the middle
+        streamed.GetTable().WriteShaderRecords(streamed.GetHandles()[0], 100, arguments.data(), RootArgumentsSize);
+        streamed.GetTable().WriteShaderRecords(streamed.GetHandles()[100], RecordCount - 100, &arguments[100],
+                                               RootArgumentsSize);
+
+        DXR_CHECK(std::memcmp(scattered.GetData(), streamed.GetData(), scattered.GetSize()) == 0);
+
+        // Strided arguments, only the first half of each block is written and the rest of the record is zeroed
+        HitGroupTable strided;
+        CHAR* pRecord = strided.GetData() + D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT + 9 * 64;
+        pRecord[63] = 1;
+
+        strided.GetTable().WriteShaderRecords(strided.GetHandles()[0], RecordCount, arguments.data(),
+                                              RootArgumentsSize / 2, sizeof(RootArguments));
+
+        DXR_CHECK(std::memcmp(pRecord + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES, &arguments[9], RootArgumentsSize / 2) ==
+                  0);
+        DXR_CHECK(pRecord[63] == 0);
+    }
+
+    /// @brief Print the time of writing every hit group record once, best of a few runs so a preempted run doesn't
+    /// count.
+    template <typename Write>
+    void Benchmark(const char* name, HitGroupTable& table, Write write)
+    {
+        double best = DBL_MAX;
+        for (UINT64 run = 0; run < 10; run++)
+        {
+            auto arguments = MakeRootArguments(run);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            write(table, arguments);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            best = std::min(best, std::chrono::duration<double>(end - start).count());
+        }
+
+        std::printf("%-28s %8.2f ns/record %8.2f ms/frame\n", name, best * 1e9 / RecordCount, best * 1e3);
+    }
+
+    /// @brief Not a check, the time depends on the machine. The table is in cached memory, so the writes themselves
+    /// are cheap and the lookups stand out.
+    void BenchmarkRecordWrites()
+    {
+        HitGroupTable table;
+
+        Benchmark("SetShaderRecordData(name)", table, [](HitGroupTable& t, auto& arguments) {
+            for (UINT32 i = 0; i < RecordCount; i++)
+            {
+                t.GetTable().SetShaderRecordData(t.GetNames()[i], &arguments[i], RootArgumentsSize);
+            }
+        });
+        Benchmark("SetShaderRecordData(handle)", table, [](HitGroupTable& t, auto& arguments) {
+            for (UINT32 i = 0; i < RecordCount; i++)
+            {
+                t.GetTable().SetShaderRecordData(t.GetHandles()[i], &arguments[i], RootArgumentsSize);
+            }
+        });
+    }
+
+    /// @brief Not a check, the time depends on the machine. The scattered writes are in random record order and 8
+    /// bytes at a time, like updating a few fields of many materials. Plain cached memory is kind to them, in the
+    /// write-combined memory of an UPLOAD or GPU_UPLOAD heap every partial line is a separate bus transaction and the
+    /// gap grows much larger.
+    void BenchmarkStreamedWrites()
+    {
+        HitGroupTable table;
+
+        std::vector<UINT32> order(RecordCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+
+        Benchmark("Scattered partial writes", table, [&](HitGroupTable& t, auto& arguments) {
+            for (UINT32 i : order)
+            {
+                for (UINT32 offset = 0; offset < RootArgumentsSize; offset += sizeof(UINT64))
+                {
+                    t.GetTable().SetShaderRecordData(t.GetHandles()[i], &arguments[i].Values[offset / sizeof(UINT64)],
+                                                     sizeof(UINT64), offset);
+                }
+            }
+        });
+        Benchmark("WriteShaderRecords", table, [](HitGroupTable& t, auto& arguments) {
+            t.GetTable().WriteShaderRecords(t.GetHandles()[0], RecordCount, arguments.data(), RootArgumentsSize);
+        });
+    }
+} // namespace
+
+int main()
+{
+    TestBuildInPlace();
+    TestHandleMatchesName();
+    TestStreamedMatchesScattered();
+
+    BenchmarkRecordWrites();
+    BenchmarkStreamedWrites();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,135 @@
+#include "Test.h"
+
+#include <cstring>
+
+using namespace DXR;
+
+namespace
+{
+    constexpr UINT64 VersionSize = 256;
+    constexpr UINT32 VersionCount = 3;
+
+    /// @brief A versioned buffer in CPU memory, with a fence that is only advanced by hand.
+    class VersionedBuffer
+    {
+    public:
+        VersionedBuffer() : mSource(VersionSize, 0), mStorage(VersionSize * VersionCount, 0)
+        {
+            mVersions.Reset(VersionCount);
+            mVersions.SetStorage(mStorage.data(), VersionSize);
+        }
+
+        void Write(UINT64 offset, CHAR value, UINT64 size = 8)
+        {
+            std::memset(mSource.data() + offset, value, size);
+            mDirtyRanges.push_back({offset, offset + size});
+        }
+
+        /// @brief Commit the version of a frame and submit it with the fence value of the frame, frame + 1.
+        bool CommitFrame(UINT64 frame)
+        {
+            if (!mVersions.Commit(frame, mCompletedFenceValue, mSource.data(), mDirtyRanges))
+                return false;
+
+            mVersions.Submit(frame + 1);
+            return true;
+        }
+
+        /// @brief Let the GPU finish a frame.
+        void CompleteFrame(UINT64 frame) { mCompletedFenceValue = frame + 1; }
+
+        bool VersionMatches(UINT32 version) const
+        {
+            return std::memcmp(mStorage.data() + version * VersionSize, mSource.data(), VersionSize) == 0;
+        }
+
+        CHAR GetVersionByte(UINT32 version, UINT64 offset) const { return mStorage[version * VersionSize + offset]; }
+
+        const ShaderTableVersions& GetVersions() const { return mVersions; }
+        bool HasDirtyRanges() const { return !mDirtyRanges.empty(); }
+
+    private:
+        ShaderTableVersions mVersions = {};
+        std::vector<CHAR> mSource = {};
+        std::vector<CHAR> mStorage = {};
+        std::vector<ShaderTableVersions::Range> mDirtyRanges = {};
+        UINT64 mCompletedFenceValue = 0;
+    };
+
+    void TestVersionPerFrame()
+    {
+        VersionedBuffer buffer;
+
+        // Nothing is in flight yet, the first frames each get their own version
+        for (UINT64 frame = 0; frame < VersionCount; frame++)
+        {
+            buffer.Write(frame * 16, static_cast<CHAR>(frame + 1));
+            DXR_CHECK(buffer.CommitFrame(frame));
+            DXR_CHECK(buffer.GetVersions().GetCurrent() == frame);
+            DXR_CHECK(buffer.GetVersions().GetCurrentOffset() == frame * VersionSize);
+            DXR_CHECK(buffer.VersionMatches(static_cast<UINT32>(frame)));
+        }
+
+        // The first version was filled before the later writes, it isn't touched until it's committed again
+        DXR_CHECK(buffer.GetVersionByte(0, 16) == 0);
+        DXR_CHECK(buffer.GetVersionByte(0, 32) == 0);
+    }
+
+    void TestInFlightVersionIsKept()
+    {
+        VersionedBuffer buffer;
+        for (UINT64 frame = 0; frame < VersionCount; frame++) { DXR_CHECK(buffer.CommitFrame(frame)); }
+
+        // Frame 3 wraps around to the version of frame 0, which the GPU may still read
+        buffer.Write(64, 'a');
+        DXR_CHECK(!buffer.CommitFrame(3));
+        DXR_CHECK(buffer.GetVersions().GetCurrent() == 2);
+        DXR_CHECK(buffer.GetVersionByte(0, 64) == 0);
+        DXR_CHECK(buffer.HasDirtyRanges());
+
+        // Once frame 0 is done it is reused, with the edits of all frames since
+        buffer.CompleteFrame(0);
+        DXR_CHECK(buffer.CommitFrame(3));
+        DXR_CHECK(buffer.GetVersions().GetCurrent() == 0);
+        DXR_CHECK(buffer.VersionMatches(0));
+        DXR_CHECK(!buffer.HasDirtyRanges());
+    }
+
+    void TestRetiredVersionsCatchUp()
+    {
+        VersionedBuffer buffer;
+        for (UINT64 frame = 0; frame < VersionCount; frame++) { DXR_CHECK(buffer.CommitFrame(frame)); }
+
+        // Each frame writes something else, the versions that are committed later receive every edit they missed
+        for (UINT64 frame = VersionCount; frame < 20; frame++)
+        {
+            buffer.CompleteFrame(frame - VersionCount);
+            buffer.Write((frame * 8) % VersionSize, static_cast<CHAR>(frame));
+
+            DXR_CHECK(buffer.CommitFrame(frame));
+            DXR_CHECK(buffer.GetVersions().GetCurrent() == frame % VersionCount);
+            DXR_CHECK(buffer.VersionMatches(static_cast<UINT32>(frame % VersionCount)));
+        }
+
+        // Larger edits than half the buffer are copied whole, the result is the same
+        buffer.CompleteFrame(19);
+        buffer.Write(0, 'x', VersionSize / 2);
+        DXR_CHECK(buffer.CommitFrame(20));
+        buffer.Write(VersionSize - 8, 'y');
+        DXR_CHECK(buffer.CommitFrame(21));
+        DXR_CHECK(buffer.CommitFrame(22));
+        buffer.CompleteFrame(22);
+        DXR_CHECK(buffer.CommitFrame(23));
+
+        for (UINT32 version = 0; version < VersionCount; version++) { DXR_CHECK(buffer.VersionMatches(version)); }
+    }
+} // namespace
+
+int main()
+{
+    TestVersionPerFrame();
+    TestInFlightVersionIsKept();
+    TestRetiredVersionsCatchUp();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,294 @@
+#include "Test.h"
+
+#include <array>
+
+using namespace DXR;
+
+namespace
+{
+    /// @brief A state object that only counts its references, the cache never calls into it.
+    class FakeStateObject : public ID3D12StateObject
+    {
+    public:
+        FakeStateObject() { sLiveCount++; }
+        virtual ~FakeStateObject() { sLiveCount--; }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppObject) override
+        {
+            *ppObject = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override { return ++mRefCount; }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            ULONG count = --mRefCount;
+            if (count == 0)
+                delete this;
+            return count;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE GetDevice(REFIID, void** ppDevice) override
+        {
+            *ppDevice = nullptr;
+            return E_NOTIMPL;
+        }
+
+        static inline INT32 sLiveCount = 0;
+
+    private:
+        ULONG mRefCount = 1;
+    };
+
+    ComPtr<ID3D12StateObject> CreateFakeStateObject()
+    {
+        ComPtr<ID3D12StateObject> stateObject = nullptr;
+        stateObject.Attach(new FakeStateObject());
+        return stateObject;
+    }
+
+    // An unsigned DXIL container, hashed by its bytes
+    constexpr BYTE Library[32] = {'D', 'X', 'B', 'C', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                  0,   0,   0,   0,   1, 0, 0, 0, 32, 0, 0, 0, 0, 0, 0, 0};
+
+    /// @brief The subobjects of a small pipeline, built in the given order with its export lists in the given order.
+    class PipelineDesc
+    {
+    public:
+        PipelineDesc(bool reversed, UINT32 payloadSize = 16, LPCWSTR missExport = L"Miss")
+        {
+            mExports = {D3D12_EXPORT_DESC {L"RayGen", nullptr, D3D12_EXPORT_FLAG_NONE},
+                        D3D12_EXPORT_DESC {missExport, nullptr, D3D12_EXPORT_FLAG_NONE},
+                        D3D12_EXPORT_DESC {L"ClosestHit", nullptr, D3D12_EXPORT_FLAG_NONE}};
+            mAssociated = {L"RayGen", missExport, L"HitGroup"};
+
+            if (reversed)
+            {
+                std::reverse(mExports.begin(), mExports.end());
+                std::reverse(mAssociated.begin(), mAssociated.end());
+            }
+
+            mLibrary = {{Library, sizeof(Library)}, static_cast<UINT>(mExports.size()), mExports.data()};
+            mHitGroup = {L"HitGroup", D3D12_HIT_GROUP_TYPE_TRIANGLES, nullptr, L"ClosestHit", nullptr};
+            mShaderConfig = {payloadSize, 8};
+            mPipelineConfig = {1};
+
+            std::array<D3D12_STATE_SUBOBJECT, 4> subobjects = {
+                D3D12_STATE_SUBOBJECT {D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY, &mLibrary},
+                D3D12_STATE_SUBOBJECT {D3D12_STATE_SUBOBJECT_TYPE_HIT_GROUP, &mHitGroup},
+                D3D12_STATE_SUBOBJECT {D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_SHADER_CONFIG, &mShaderConfig},
+                D3D12_STATE_SUBOBJECT {D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_PIPELINE_CONFIG, &mPipelineConfig}};
+
+            // The association comes last, or first and followed by the other subobjects in reverse
+            if (reversed)
+                std::reverse_copy(subobjects.begin(), subobjects.end(), mSubobjects.begin() + 1);
+            else
+                std::copy(subobjects.begin(), subobjects.end(), mSubobjects.begin());
+
+            // The association points at the shader config wherever it ended up
+            auto shaderConfig = std::find_if(mSubobjects.begin(), mSubobjects.end(), [](auto& subobject) {
+                return subobject.Type == D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_SHADER_CONFIG;
+            });
+            mAssociation = {&*shaderConfig, static_cast<UINT>(mAssociated.size()), mAssociated.data()};
+            mSubobjects[reversed ? 0 : 4] = {D3D12_STATE_SUBOBJECT_TYPE_SUBOBJECT_TO_EXPORTS_ASSOCIATION,
+                                             &mAssociation};
+        }
+
+        // The subobjects point into the object
+        PipelineDesc(PipelineDesc const&) = delete;
+        PipelineDesc& operator=(PipelineDesc const&) = delete;
+
+        D3D12_STATE_OBJECT_DESC GetDesc() const
+        {
+            return {D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE, static_cast<UINT>(mSubobjects.size()),
+                    mSubobjects.data()};
+        }
+
+    private:
+        std::array<D3D12_EXPORT_DESC, 3> mExports = {};
+        std::array<LPCWSTR, 3> mAssociated = {};
+        D3D12_DXIL_LIBRARY_DESC mLibrary = {};
+        D3D12_HIT_GROUP_DESC mHitGroup = {};
+        D3D12_RAYTRACING_SHADER_CONFIG mShaderConfig = {};
+        D3D12_RAYTRACING_PIPELINE_CONFIG mPipelineConfig = {};
+        D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION mAssociation = {};
+        std::array<D3D12_STATE_SUBOBJECT, 5> mSubobjects = {};
+    };
+
+    void TestHashOrderStability()
+    {
+        PipelineDesc forward(false);
+        PipelineDesc reversed(true);
+
+        UINT64 hash = HashStateObjectDesc(forward.GetDesc());
+        DXR_CHECK(hash != 0);
+        DXR_CHECK(hash == HashStateObjectDesc(reversed.GetDesc()));
+
+        // Hashing again gives the same hash
+        DXR_CHECK(hash == HashStateObjectDesc(forward.GetDesc()));
+    }
+
+    void TestHashContent()
+    {
+        PipelineDesc base(false);
+        PipelineDesc payload(false, 32);
+        PipelineDesc renamed(false, 16, L"Shadow");
+
+        UINT64 hash = HashStateObjectDesc(base.GetDesc());
+        DXR_CHECK(hash != HashStateObjectDesc(payload.GetDesc()));
+        DXR_CHECK(hash != HashStateObjectDesc(renamed.GetDesc()));
+
+        D3D12_STATE_OBJECT_DESC collection = base.GetDesc();
+        collection.Type = D3D12_STATE_OBJECT_TYPE_COLLECTION;
+        DXR_CHECK(hash != HashStateObjectDesc(collection));
+
+        // Dropping a subobject changes the hash
+        D3D12_STATE_OBJECT_DESC fewer = base.GetDesc();
+        fewer.NumSubobjects--;
+        DXR_CHECK(hash != HashStateObjectDesc(fewer));
+    }
+
+    void TestSignature()
+    {
+        PipelineDesc forward(false);
+        PipelineDesc reversed(true);
+        PipelineDesc payload(false, 32);
+
+        std::vector<BYTE> signature = {}, other = {};
+        DXR_CHECK(GetStateObjectSignature(forward.GetDesc(), signature));
+        DXR_CHECK(!signature.empty());
+
+        // The same regardless of the order, different with different contents
+        DXR_CHECK(GetStateObjectSignature(reversed.GetDesc(), other));
+        DXR_CHECK(signature == other);
+        DXR_CHECK(GetStateObjectSignature(payload.GetDesc(), other));
+        DXR_CHECK(signature != other);
+    }
+
+    void TestCacheDisabledByDefault()
+    {
+        StateObjectCache cache;
+        PipelineDesc pipeline(false);
+
+        UINT32 creates = 0;
+        auto create = [&]() {
+            creates++;
+            return CreateFakeStateObject();
+        };
+
+        DXR_CHECK(cache.GetCapacity() == 0);
+
+        cache.GetOrCreate(pipeline.GetDesc(), nullptr, create);
+        cache.GetOrCreate(pipeline.GetDesc(), nullptr, create);
+
+        DXR_CHECK(creates == 2);
+        DXR_CHECK(cache.GetSize() == 0);
+        DXR_CHECK(FakeStateObject::sLiveCount == 0);
+    }
+
+    void TestCacheDeduplicates()
+    {
+        StateObjectCache cache;
+        cache.SetCapacity(8);
+
+        PipelineDesc forward(false);
+        PipelineDesc reversed(true);
+
+        UINT32 creates = 0;
+        auto create = [&]() {
+            creates++;
+            return CreateFakeStateObject();
+        };
+
+        auto first = cache.GetOrCreate(forward.GetDesc(), nullptr, create);
+        auto second = cache.GetOrCreate(reversed.GetDesc(), nullptr, create);
+
+        DXR_CHECK(creates == 1);
+        DXR_CHECK(first.Get() == second.Get());
+        DXR_CHECK(cache.GetStats().Hits == 1);
+        DXR_CHECK(cache.GetStats().Misses == 1);
+
+        // An expansion of a state object is not the state object itself
+        auto expanded = cache.GetOrCreate(forward.GetDesc(), first.Get(), create);
+        DXR_CHECK(creates == 2);
+        DXR_CHECK(expanded.Get() != first.Get());
+    }
+
+    void TestCacheEvicts()
+    {
+        StateObjectCache cache;
+        cache.SetCapacity(1);
+
+        PipelineDesc first(false);
+        PipelineDesc second(false, 32);
+
+        cache.GetOrCreate(first.GetDesc(), nullptr, CreateFakeStateObject);
+        DXR_CHECK(FakeStateObject::sLiveCount == 1);
+
+        // The least recently used state object makes room and is released
+        cache.GetOrCreate(second.GetDesc(), nullptr, CreateFakeStateObject);
+        DXR_CHECK(cache.GetSize() == 1);
+        DXR_CHECK(cache.GetStats().Evictions == 1);
+        DXR_CHECK(FakeStateObject::sLiveCount == 1);
+
+        // Disabling the cache releases the rest
+        cache.SetCapacity(0);
+        DXR_CHECK(cache.GetSize() == 0);
+        DXR_CHECK(FakeStateObject::sLiveCount == 0);
+    }
+
+    void TestFailedCompilationKeepsNewerEntry()
+    {
+        StateObjectCache cache;
+        cache.SetCapacity(8);
+
+        PipelineDesc pipeline(false);
+
+        // While the first compilation runs the cache is cleared and the same pipeline is compiled again, then the
+        // first one fails and must not erase the entry of the second one
+        bool threw = false;
+        try
+        {
+            cache.GetOrCreate(pipeline.GetDesc(), nullptr, [&]() -> ComPtr<ID3D12StateObject> {
+                cache.Clear();
+                cache.GetOrCreate(pipeline.GetDesc(), nullptr, CreateFakeStateObject);
+                throw std::runtime_error("Compilation failed");
+            });
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+
+        DXR_CHECK(threw);
+        DXR_CHECK(cache.GetSize() == 1);
+
+        UINT32 creates = 0;
+        cache.GetOrCreate(pipeline.GetDesc(), nullptr, [&]() {
+            creates++;
+            return CreateFakeStateObject();
+        });
+        DXR_CHECK(creates == 0);
+
+        cache.Clear();
+        DXR_CHECK(FakeStateObject::sLiveCount == 0);
+    }
+} // namespace
+
+int main()
+{
+    TestHashOrderStability();
+    TestHashContent();
+    TestSignature();
+    TestCacheDisabledByDefault();
+    TestCacheDeduplicates();
+    TestCacheEvicts();
+    TestFailedCompilationKeepsNewerEntry();
+
+    return DXR::Test::Report();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "DXRay/DXRay.h"
+
+#include <cstdio>
+
+namespace DXR::Test
+{
+    /// @brief Get the number of failed checks of the test executable.
+    inline UINT32& GetFailureCount()
+    {
+        static UINT32 failures = 0;
+        return failures;
+    }
+
+    /// @brief Print the result of the test executable.
+    /// @return The exit code, 0 if all checks passed.
+    inline int Report()
+    {
+        if (GetFailureCount() != 0)
+            std::printf("%u check(s) failed\n", GetFailureCount());
+        else
+            std::printf("All checks passed\n");
+
+        return GetFailureCount() == 0 ? 0 : 1;
+    }
+} // namespace DXR::Test
+
+/// @brief Check a condition, a failed check is reported and fails the test executable but doesn't stop it.
+#define DXR_CHECK(condition)                                                                                           \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(condition))                                                                                              \
+        {                                                                                                              \
+            std::printf("%s(%d): Check failed: %s\n", __FILE__, __LINE__, #condition);                                 \
+            DXR::Test::GetFailureCount()++;                                                                            \
+        }                                                                                                              \
+    } while (false)